@@ -22,6 +22,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 using System;
+using System.Collections.Generic;
 using System.Diagnostics;
 using System.Linq;
 
@@ -69,6 +70,15 @@ namespace Lomont.Compression.Codec
 
         public OptionFlags Options { get; set; } = OptionFlags.None;
 
+        /// <summary>
+        /// Symbols are split round robin into this many streams, each with its own 
+        /// coder and sharing one table, so decoders can work on several at once. 
+        /// 1 is the usual format, 2 to MaxInterleavedStreams give a format read with 
+        /// DecompressArithmeticInterleaved. Decompress with the same setting.
+        /// </summary>
+        [CodecParameter("Streams", "streams", "Interleaved streams 1-4, above 1 needs DecompressArithmeticInterleaved")]
+        public uint Streams { get; set; } = 1;
+
         #endregion
 
         #region Compression Functions
@@ -96,8 +106,13 @@ namespace Lomont.Compression.Codec
 
             // arithmetic gets total probability from the header, so ensure it gets saved
             headerFlags |= Header.HeaderFlags.SymbolCount;
+            streamCount = Math.Max(1, Math.Min(Streams, MaxInterleavedStreams));
+            if (streamCount > 1)
+                WriteInterleavedMark(bitstream);
             Header.WriteUniversalHeader(bitstream, data, headerFlags);
-            
+            if (streamCount > 1)
+                UniversalCodec.Lomont.EncodeLomont1(bitstream, streamCount - 1, 2, 0);
+
             // we'll insert the bitlength of what follows at this spot during the footer
             whereToInsertBitlength = bitstream.Position;
 
@@ -105,6 +120,18 @@ namespace Lomont.Compression.Codec
             var tables = MakeFrequencyTable();
             bitstream.WriteStream(tables);
 
+            // each interleaved stream starts with a fresh coder
+            symbolIndex = 0;
+            interleavedStreams.Clear();
+            coders = new CoderState[streamCount];
+            for (var i = 0; i < streamCount; ++i)
+            {
+                coders[i] = new CoderState();
+                SaveCoder(coders[i], null);
+                if (streamCount > 1)
+                    interleavedStreams.Add(new Bitstream());
+            }
+
             if (Options.HasFlag(OptionFlags.DumpState))
                 Write("Enc: ");
         }
@@ -115,6 +142,20 @@ namespace Lomont.Compression.Codec
         /// <param name="bitstream"></param>
         /// <param name="symbol"></param>
         public override void CompressSymbol(Bitstream bitstream, uint symbol)
+        {
+            if (streamCount > 1)
+            {
+                // encode with the coder of the next stream in turn
+                var stream = (int)(symbolIndex++ % streamCount);
+                LoadCoder(coders[stream], null);
+                EncodeSymbol(interleavedStreams[stream], symbol);
+                SaveCoder(coders[stream], null);
+                return;
+            }
+            EncodeSymbol(bitstream, symbol);
+        }
+
+        void EncodeSymbol(Bitstream bitstream, uint symbol)
         {
             if (Options.HasFlag(OptionFlags.DumpState))
                 Write($"[{symbol:X2},{lowValue:X8},{highValue:X8}] ");
@@ -169,6 +210,16 @@ namespace Lomont.Compression.Codec
         {
             if (Options.HasFlag(OptionFlags.DumpState))
                 WriteLine();
+            if (streamCount > 1)
+            {
+                for (var i = 0; i < streamCount; ++i)
+                {
+                    LoadCoder(coders[i], null);
+                    Finish(interleavedStreams[i]);
+                }
+                WriteInterleavedStreams(bitstream, interleavedStreams);
+                return;
+            }
             Finish(bitstream);
 
             // insert the bitlength of the compressed portion
@@ -196,9 +247,42 @@ namespace Lomont.Compression.Codec
 
             // arithmetic gets total probability from the header, so...
             headerFlags |= Header.HeaderFlags.SymbolCount;
+            if (Streams > 1)
+                ReadInterleavedMark(bitstream);
             var header = Header.ReadUniversalHeader(bitstream, headerFlags);
             total = header.Item1;
 
+            symbolIndex = 0;
+            streamCount = 1;
+            if (total == 0)
+            {
+                if (Streams <= 1)
+                    CheckNotInterleaved(bitstream);
+                return 0;
+            }
+            if (Streams > 1)
+            {
+                streamCount = UniversalCodec.Lomont.DecodeLomont1(bitstream, 2, 0) + 1;
+                DecodeTable(bitstream);
+
+                // each stream has its own coder, bits counted from its start
+                streamPositions = ReadInterleavedStreams(bitstream, streamCount);
+                coders = new CoderState[streamCount];
+                for (var i = 0; i < streamCount; ++i)
+                {
+                    ResetCoder();
+                    bitstream.Position = streamPositions[i];
+                    bitLength = streamPositions[i + 1] - streamPositions[i];
+                    bitsRead = 0;
+                    buffer = 0;
+                    for (var j = 0; j < 31; ++j)
+                        buffer = (buffer << 1) | ReadBit(bitstream);
+                    coders[i] = new CoderState();
+                    SaveCoder(coders[i], bitstream);
+                }
+                return total;
+            }
+
             bitLength = UniversalCodec.Lomont.DecodeLomont1(bitstream, 8, -1);
             bitsRead = 0;
             //Console.WriteLine($"Arith decode bitsize {bitLength}");
@@ -225,6 +309,20 @@ namespace Lomont.Compression.Codec
         /// </summary>
         /// <param name="bitstream"></param>
         public override uint DecompressSymbol(Bitstream bitstream)
+        {
+            if (streamCount > 1)
+            {
+                // decode with the coder of the next stream in turn
+                var stream = (int)(symbolIndex++ % streamCount);
+                LoadCoder(coders[stream], bitstream);
+                var symbol = DecodeSymbol(bitstream);
+                SaveCoder(coders[stream], bitstream);
+                return symbol;
+            }
+            return DecodeSymbol(bitstream);
+        }
+
+        uint DecodeSymbol(Bitstream bitstream)
         {
             if (Options.HasFlag(OptionFlags.DumpState))
                 Write($"[{lowValue:X8},{highValue:X8}] ");
@@ -282,6 +380,8 @@ namespace Lomont.Compression.Codec
         /// <param name="bitstream"></param>
         public override void ReadFooter(Bitstream bitstream)
         {
+            if (streamCount > 1)
+                bitstream.Position = streamPositions[streamCount]; // past the last stream
         }
 
         #endregion
@@ -307,6 +407,45 @@ namespace Lomont.Compression.Codec
         // decoder only state
         uint buffer;
 
+        // interleaved stream state, streamCount is 1 for the usual single stream
+        uint streamCount = 1;
+        uint symbolIndex;
+        readonly List<Bitstream> interleavedStreams = new List<Bitstream>();
+        uint[] streamPositions;
+        // coder state of each stream, loaded into the fields above while it codes a symbol
+        CoderState[] coders;
+
+        class CoderState
+        {
+            public uint LowValue, HighValue, Scaling, Buffer, BitLength, BitsRead, Position;
+        }
+
+        // copy the coder fields, and the decode position if bitstream is not null
+        void SaveCoder(CoderState coder, Bitstream bitstream)
+        {
+            coder.LowValue = lowValue;
+            coder.HighValue = highValue;
+            coder.Scaling = scaling;
+            coder.Buffer = buffer;
+            coder.BitLength = bitLength;
+            coder.BitsRead = bitsRead;
+            if (bitstream != null)
+                coder.Position = bitstream.Position;
+        }
+
+        // restore coder fields saved with SaveCoder
+        void LoadCoder(CoderState coder, Bitstream bitstream)
+        {
+            lowValue = coder.LowValue;
+            highValue = coder.HighValue;
+            scaling = coder.Scaling;
+            buffer = coder.Buffer;
+            bitLength = coder.BitLength;
+            bitsRead = coder.BitsRead;
+            if (bitstream != null)
+                bitstream.Position = coder.Position;
+        }
+
         // low memory decoding state
         private uint symbolMin;
         private uint symbolMax;
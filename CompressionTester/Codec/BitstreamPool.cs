@@ -0,0 +1,64 @@
+﻿/*
+MIT License
+
+Copyright (c) 2016 Chris Lomont
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System.Collections.Concurrent;
+
+namespace Lomont.Compression.Codec
+{
+    /// <summary>
+    /// Reusable bitstreams, so trial compressions do not regrow a new bitstream 
+    /// each time. Safe to use from several threads.
+    /// </summary>
+    public static class BitstreamPool
+    {
+        /// <summary>
+        /// Most bitstreams kept for reuse
+        /// </summary>
+        public const int MaximumPooled = 64;
+
+        static readonly ConcurrentBag<Bitstream> Pool = new ConcurrentBag<Bitstream>();
+
+        /// <summary>
+        /// Get an empty bitstream, reused if possible
+        /// </summary>
+        /// <returns></returns>
+        public static Bitstream Rent()
+        {
+            Bitstream bitstream;
+            if (!Pool.TryTake(out bitstream))
+                return new Bitstream();
+            bitstream.Clear();
+            return bitstream;
+        }
+
+        /// <summary>
+        /// Give back a bitstream no longer in use
+        /// </summary>
+        /// <param name="bitstream"></param>
+        public static void Return(Bitstream bitstream)
+        {
+            if (bitstream != null && Pool.Count < MaximumPooled)
+                Pool.Add(bitstream);
+        }
+    }
+}
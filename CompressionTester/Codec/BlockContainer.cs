@@ -0,0 +1,153 @@
+﻿/*
+MIT License
+
+Copyright (c) 2016 Chris Lomont
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Linq;
+
+namespace Lomont.Compression.Codec
+{
+    /// <summary>
+    /// Seekable container. Data is split into fixed size blocks, each compressed 
+    /// independently with the same codec, followed by an index of block offsets, 
+    /// so a decoder only decodes the blocks it needs.
+    /// Format, MSB first:
+    ///   - Total byte length, Lomont1 universal coded (same as other formats, so 
+    ///     GetDecompressedSize works)
+    ///   - Block byte size, Lomont1 universal coded
+    ///   - Codec type, 2 bits: 0 = Huffman, 1 = Arithmetic, 2 = LZ77, 3 = LZCL
+    ///   - B = bits per index entry, Lomont1 universal coded
+    ///   - Index of block count entries, B bits each, entry i is the byte offset 
+    ///     of the end of block i, measured from the start of block data
+    ///   - 0 padding to a byte boundary, then the compressed blocks
+    /// </summary>
+    public static class BlockContainer
+    {
+        /// <summary>
+        /// Codec type stored in container, or -1 if the codec cannot be stored.
+        /// Interleaved streams cannot be, since the C block decoder reads the usual format.
+        /// </summary>
+        /// <param name="codec"></param>
+        /// <returns></returns>
+        public static int CodecType(CodecBase codec)
+        {
+            if (codec is HuffmanCodec)
+                return ((HuffmanCodec)codec).Streams > 1 ? -1 : 0;
+            if (codec is ArithmeticCodec)
+                return ((ArithmeticCodec)codec).Streams > 1 ? -1 : 1;
+            if (codec is Lz77Codec)
+                return 2;
+            if (codec is LzclCodec)
+                return 3;
+            return -1;
+        }
+
+        /// <summary>
+        /// Compress data into a container of blocks of blockSize bytes
+        /// </summary>
+        /// <param name="codec"></param>
+        /// <param name="data"></param>
+        /// <param name="blockSize"></param>
+        /// <returns></returns>
+        public static byte[] Compress(CodecBase codec, byte[] data, uint blockSize)
+        {
+            var codecType = CodecType(codec);
+            if (codecType < 0)
+                throw new ArgumentException($"Codec {codec.GetType().Name} cannot be stored in a block container");
+            if (blockSize == 0)
+                throw new ArgumentException("Block size must be positive");
+
+            // compress each block
+            var blockCount = (data.Length + blockSize - 1) / blockSize;
+            var blocks = new byte[blockCount][];
+            for (var i = 0; i < blockCount; ++i)
+            {
+                var start = (int)(i * blockSize);
+                var length = Math.Min((int)blockSize, data.Length - start);
+                var block = new byte[length];
+                Array.Copy(data, start, block, 0, length);
+                blocks[i] = codec.Compress(block);
+            }
+
+            // block end offsets
+            var offsets = new uint[blockCount];
+            uint offset = 0;
+            for (var i = 0; i < blockCount; ++i)
+            {
+                offset += (uint)blocks[i].Length;
+                offsets[i] = offset;
+            }
+            var bitsPerOffset = CodecBase.BitsRequired(offset);
+
+            var bs = new Bitstream();
+            UniversalCodec.Lomont.EncodeLomont1(bs, (uint)data.Length, 6, 0);
+            UniversalCodec.Lomont.EncodeLomont1(bs, blockSize, 6, 0);
+            bs.Write((uint)codecType, 2);
+            UniversalCodec.Lomont.EncodeLomont1(bs, bitsPerOffset, 3, 0);
+            foreach (var o in offsets)
+                bs.Write(o, bitsPerOffset);
+
+            if (codec.OutputWriter != null)
+                codec.WriteLine($"Block container: {blockCount} blocks of {blockSize} bytes, index {bs.Length} bits");
+
+            // GetBytes pads to a byte boundary
+            var header = bs.GetBytes();
+            return header.Concat(blocks.SelectMany(b => b)).ToArray();
+        }
+
+        /// <summary>
+        /// Decompress a container made by Compress, using the given codec
+        /// </summary>
+        /// <param name="codec"></param>
+        /// <param name="data"></param>
+        /// <returns></returns>
+        public static byte[] Decompress(CodecBase codec, byte[] data)
+        {
+            var bs = new Bitstream(data);
+            bs.Position = 0;
+            var byteLength = UniversalCodec.Lomont.DecodeLomont1(bs, 6, 0);
+            var blockSize = UniversalCodec.Lomont.DecodeLomont1(bs, 6, 0);
+            var codecType = (int)bs.Read(2);
+            var bitsPerOffset = UniversalCodec.Lomont.DecodeLomont1(bs, 3, 0);
+            if (codecType != CodecType(codec))
+                throw new ArgumentException($"Block container codec type {codecType} does not match codec {codec.GetType().Name}");
+
+            var blockCount = (byteLength + blockSize - 1) / blockSize;
+            var offsets = new uint[blockCount];
+            for (var i = 0; i < blockCount; ++i)
+                offsets[i] = bs.Read(bitsPerOffset);
+            var dataStart = (int)((bs.Position + 7) / 8);
+
+            var output = new byte[byteLength];
+            uint start = 0;
+            for (var i = 0; i < blockCount; ++i)
+            {
+                var block = new byte[offsets[i] - start];
+                Array.Copy(data, dataStart + start, block, 0, block.Length);
+                var decoded = codec.Decompress(block);
+                Array.Copy(decoded, 0, output, i * blockSize, decoded.Length);
+                start = offsets[i];
+            }
+            return output;
+        }
+    }
+}
@@ -29,6 +29,12 @@ namespace Lomont.Compression.Codec
     {
         public string Name { get; set; }
 
+        /// <summary>
+        /// Increment when the compressed output changes, so cached 
+        /// test results for the codec are recomputed
+        /// </summary>
+        public int Version { get; set; } = 1;
+
         public CodecAttribute(string name)
         {
             Name = name;
@@ -51,7 +51,18 @@ namespace Lomont.Compression.Codec
         /// <returns></returns>
         public Bitstream CompressToStream(Datastream data,  Header.HeaderFlags headerFlags)
         {
-            var bitstream = new Bitstream();
+            return CompressToStream(data, headerFlags, new Bitstream());
+        }
+
+        /// <summary>
+        /// Stream version writing to a given empty bitstream, such as one from BitstreamPool
+        /// </summary>
+        /// <param name="data"></param>
+        /// <param name="headerFlags">Flags telling what to put in the header. Useful when embedding in other streams.</param>
+        /// <param name="bitstream"></param>
+        /// <returns>bitstream</returns>
+        public Bitstream CompressToStream(Datastream data, Header.HeaderFlags headerFlags, Bitstream bitstream)
+        {
             WriteHeader(bitstream,data, headerFlags);
             foreach (var symbol in data)
                 CompressSymbol(bitstream, symbol);
@@ -148,9 +159,96 @@ namespace Lomont.Compression.Codec
         {
         }
 
+        /// <summary>
+        /// C #defines fixing the header values of the compressed data, so Decompressor.c 
+        /// can build a decoder specialized for it, see DECOMPRESSOR_SPECIALIZE in 
+        /// Decompressor.h. Empty if the codec has none.
+        /// </summary>
+        /// <param name="compressed">Output of Compress</param>
+        /// <returns></returns>
+        public virtual List<Tuple<string, uint>> GetDecoderDefines(byte[] compressed)
+        {
+            return new List<Tuple<string, uint>>();
+        }
+
 
         #endregion
 
+        #region Interleaved streams
+
+        /// <summary>
+        /// Most interleaved streams a Huffman or Arithmetic codec may split its symbols into, 
+        /// matching DECOMPRESSOR_MAX_STREAMS in Decompressor.c
+        /// </summary>
+        public const uint MaxInterleavedStreams = 4;
+
+        /// <summary>
+        /// Write the mark starting an interleaved Huffman or Arithmetic stream, a symbol
+        /// count of 0 coded as the universal header does. Single stream decoders then
+        /// decode nothing, and interleaved decoders refuse streams without it.
+        /// The real header follows.
+        /// </summary>
+        /// <param name="bitstream"></param>
+        public static void WriteInterleavedMark(Bitstream bitstream)
+        {
+            UniversalCodec.Lomont.EncodeLomont1(bitstream, 0, 6, 0);
+        }
+
+        /// <summary>
+        /// Read the mark written by WriteInterleavedMark, throwing if it is not there
+        /// </summary>
+        /// <param name="bitstream"></param>
+        public static void ReadInterleavedMark(Bitstream bitstream)
+        {
+            if (UniversalCodec.Lomont.DecodeLomont1(bitstream, 6, 0) != 0)
+                throw new ArgumentException("Not an interleaved stream, decompress with streams=1");
+        }
+
+        /// <summary>
+        /// Throw if a symbol count of 0 just read is the mark of an interleaved stream
+        /// rather than an empty stream, which ends within the byte
+        /// </summary>
+        /// <param name="bitstream"></param>
+        public static void CheckNotInterleaved(Bitstream bitstream)
+        {
+            if (bitstream.Position + 8 <= bitstream.Length)
+                throw new ArgumentException("Interleaved stream, decompress with streams=2 to 4");
+        }
+
+        /// <summary>
+        /// Write interleaved streams: the bit length of each, Lomont1(8,-1) coded, 
+        /// then the streams one after another
+        /// </summary>
+        /// <param name="bitstream"></param>
+        /// <param name="streams"></param>
+        public static void WriteInterleavedStreams(Bitstream bitstream, List<Bitstream> streams)
+        {
+            foreach (var stream in streams)
+                UniversalCodec.Lomont.EncodeLomont1(bitstream, stream.Length, 8, -1);
+            foreach (var stream in streams)
+                bitstream.WriteStream(stream);
+        }
+
+        /// <summary>
+        /// Read the lengths written by WriteInterleavedStreams.
+        /// Returns the bit position of each stream, then the position after the last one
+        /// </summary>
+        /// <param name="bitstream"></param>
+        /// <param name="streamCount"></param>
+        /// <returns></returns>
+        public static uint[] ReadInterleavedStreams(Bitstream bitstream, uint streamCount)
+        {
+            var lengths = new uint[streamCount];
+            for (var i = 0; i < streamCount; ++i)
+                lengths[i] = UniversalCodec.Lomont.DecodeLomont1(bitstream, 8, -1);
+            var positions = new uint[streamCount + 1];
+            positions[0] = bitstream.Position;
+            for (var i = 0; i < streamCount; ++i)
+                positions[i + 1] = positions[i] + lengths[i];
+            return positions;
+        }
+
+        #endregion
 
         #region Utility
         // count each value and how often it occurs
@@ -219,6 +317,18 @@ namespace Lomont.Compression.Codec
             return 1+FloorLog2(value);
         }
 
+        /// <summary>
+        /// Smallest 2^k-1 that is at least value, so value+1 rounds up to a power of two
+        /// </summary>
+        /// <param name="value"></param>
+        /// <returns></returns>
+        public static uint RoundUpToPowerOfTwoMinusOne(uint value)
+        {
+            if ((value & (value + 1)) == 0)
+                return value;
+            return (1U << (int)BitsRequired(value)) - 1;
+        }
+
         public static bool CompareBytes(byte[] a, byte[] b)
         {
             if (a.Length != b.Length)
@@ -24,6 +24,7 @@ SOFTWARE.
 using System;
 using System.Collections.Generic;
 using System.Linq;
+using System.Threading.Tasks;
 
 namespace Lomont.Compression.Codec
 {
@@ -47,6 +48,7 @@ namespace Lomont.Compression.Codec
             UseEliasOmega  = 0x00000040,
             UseBasc        = 0x00000080,
             UseStout       = 0x00000100,
+            UseRans        = 0x00000200,
 
             StoreStats = 0x01000000,
 
@@ -66,12 +68,23 @@ namespace Lomont.Compression.Codec
             public uint CompressedBitLength { get; set; }
             public Type CompressorType { get; set; }
             public List<uint> Parameters { get; set; } = new List<uint>();
+            /// <summary>
+            /// Compressed stream from BitstreamPool when KeepBitstreams is set and 
+            /// the result is from a codec, else null
+            /// </summary>
+            public Bitstream Bitstream { get; set; }
         }
 
         public OptionFlags Options { get; set; } = OptionFlags.UseAll;
 
         /// <summary>
-        /// try various compression on the data, 
+        /// Keep the compressed stream of each codec in its result, so the best 
+        /// need not be compressed again. The caller returns them to BitstreamPool.
+        /// </summary>
+        public bool KeepBitstreams { get; set; }
+
+        /// <summary>
+        /// try various compression on the data, all at once on a task pool
         /// return list of compression results (bitLength, type, optional parameters)
         /// </summary>
         /// <param name="statPrefix"></param>
@@ -80,12 +93,14 @@ namespace Lomont.Compression.Codec
         /// <returns></returns>
         public List<Result> TestAll(string statPrefix, Datastream data, Header.HeaderFlags headerFlags)
         {
-            var results = new List<Result>();
+            // trials, each independent, run in parallel then listed in this order
+            var trials = new List<Func<Result>>();
 
             // perform compression algorithm
-            Action<string, CodecBase, Type> tryCodec = (label, codec, codecType) =>
+            Action<string, Func<CodecBase>, Type> tryCodec = (label, makeCodec, codecType) => trials.Add(() =>
             {
-                var bitstream = codec.CompressToStream(data, headerFlags);
+                var codec = makeCodec();
+                var bitstream = codec.CompressToStream(data, headerFlags, BitstreamPool.Rent());
                 var result = new Result(label, bitstream.Length, codecType);
                 if (codec.GetType() == typeof(GolombCodec))
                 {
@@ -96,18 +111,24 @@ namespace Lomont.Compression.Codec
                         result.CompressorName += $"({g.Parameter})";
                     }
                 }
-                results.Add(result);
-            };
+                if (KeepBitstreams)
+                    result.Bitstream = bitstream;
+                else
+                    BitstreamPool.Return(bitstream);
+                return result;
+            });
 
             // try compression algorithms
             if (Options.HasFlag(OptionFlags.UseFixed))
-                tryCodec("Fixed size", new FixedSizeCodec(), typeof(FixedSizeCodec));
+                tryCodec("Fixed size", () => new FixedSizeCodec(), typeof(FixedSizeCodec));
             if (Options.HasFlag(OptionFlags.UseArithmetic))
-                tryCodec("Arithmetic", new ArithmeticCodec(), typeof(ArithmeticCodec));
+                tryCodec("Arithmetic", () => new ArithmeticCodec(), typeof(ArithmeticCodec));
             if (Options.HasFlag(OptionFlags.UseHuffman))
-                tryCodec("Huffman", new HuffmanCodec(),typeof(HuffmanCodec));
+                tryCodec("Huffman", () => new HuffmanCodec(),typeof(HuffmanCodec));
             if (Options.HasFlag(OptionFlags.UseGolomb) && data.Max() < GolombCodec.GolombThreshold)
-                tryCodec("Golomb", new GolombCodec(), typeof(GolombCodec));
+                tryCodec("Golomb", () => new GolombCodec(), typeof(GolombCodec));
+            if (Options.HasFlag(OptionFlags.UseRans) && data.Distinct().Count() <= RansCodec.MaxSymbols)
+                tryCodec("Rans", () => new RansCodec(), typeof(RansCodec));
 
 /*            // try Golomb encoding
             if (Options.HasFlag(OptionFlags.UseGolomb))
@@ -119,11 +140,11 @@ namespace Lomont.Compression.Codec
                 //results.Add(new Result(gname,bitstream.Length, typeof(UniversalCodec.Golomb), bestg.Item2));
             } */
 
-            Action<string, UniversalCodec.UniversalCodeDelegate, Type> tryEncoder = (label, codec, codecType) =>
+            Action<string, UniversalCodec.UniversalCodeDelegate, Type> tryEncoder = (label, codec, codecType) => trials.Add(() =>
             {
                 var bitstream = UniversalCodec.CompressStream(codec, data.Select(v => v + 1).ToList());
-                results.Add(new Result(label,bitstream.Length, codecType));
-            };
+                return new Result(label,bitstream.Length, codecType);
+            });
 
             // try Elias codes - all perform poorly - todo - need way to pass this back as type?
             if (Options.HasFlag(OptionFlags.UseEliasDelta))
@@ -140,13 +161,19 @@ namespace Lomont.Compression.Codec
             // BinaryAdaptiveSequentialEncode
             if (Options.HasFlag(OptionFlags.UseBasc))
             {
-
-                var bitstream = new Bitstream();
-                UniversalCodec.BinaryAdaptiveSequentialEncode(bitstream, data, UniversalCodec.Elias.EncodeDelta);
-                var label = "BASC";
-                results.Add(new Result(label,bitstream.Length, typeof(UniversalCodec)));
+                trials.Add(() =>
+                {
+                    var bitstream = new Bitstream();
+                    UniversalCodec.BinaryAdaptiveSequentialEncode(bitstream, data, UniversalCodec.Elias.EncodeDelta);
+                    var label = "BASC";
+                    return new Result(label, bitstream.Length, typeof(UniversalCodec));
+                });
             }
 
+            var trialResults = new Result[trials.Count];
+            Parallel.For(0, trials.Count, i => trialResults[i] = trials[i]());
+            var results = trialResults.ToList();
+
             // save stats
             foreach (var result in results)
                 StatRecorder.AddStat(statPrefix + "_" + result.CompressorName, result.CompressedBitLength);
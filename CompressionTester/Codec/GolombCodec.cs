@@ -63,10 +63,12 @@ namespace Lomont.Compression.Codec
             g.Options &= ~OptionFlags.Optimize; // disable auto optimizer
 
             // function to compute length given the parameter
+            var bs = BitstreamPool.Rent();
             Func<uint, uint> f = m1 =>
              {
                  g.Parameter = m1;
-                 var bs = g.CompressToStream(data, headerFlags);
+                 bs.Clear();
+                 g.CompressToStream(data, headerFlags, bs);
                  var len1 = bs.Length;
                  return len1;
             };
@@ -115,6 +117,7 @@ namespace Lomont.Compression.Codec
             }
             if (Options.HasFlag(OptionFlags.DumpDebug))
                 WriteLine($"Golomb opt {mid} {f(mid-2)} {f(mid-1)} {f(mid)} {f(mid+1)} {f(mid+2)} {f(mid+3)}");
+            BitstreamPool.Return(bs);
             return best;
         }
 
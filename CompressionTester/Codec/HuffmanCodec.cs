@@ -74,6 +74,24 @@ namespace Lomont.Compression.Codec
         /// Codec options
         /// </summary>
         public OptionFlags Options { get; set; } = OptionFlags.UseLowMemoryDecoding;
+
+        /// <summary>
+        /// Symbols are split round robin into this many streams, sharing one table, so 
+        /// decoders can work on several at once. 1 is the usual format, 2 to 
+        /// MaxInterleavedStreams give a format read with DecompressHuffmanInterleaved.
+        /// Decompress with the same setting.
+        /// </summary>
+        [CodecParameter("Streams", "streams", "Interleaved streams 1-4, above 1 needs DecompressHuffmanInterleaved")]
+        public uint Streams { get; set; } = 1;
+
+        /// <summary>
+        /// Longest codeword allowed, or 0 for no limit. Limited codes are built by 
+        /// package-merge, costing a little size, so a one level decode table of 
+        /// 2^MaxCodewordLength entries holds every codeword. Raised if needed to
+        /// give every symbol a codeword. Any decoder reads the output.
+        /// </summary>
+        [CodecParameter("Max codeword length", "maxCode", "Longest codeword, 0 for no limit. 11 or 12 bound decode tables")]
+        public uint MaxCodewordLength { get; set; } = 0;
         #endregion
 
         #region Compression functions
@@ -81,7 +99,20 @@ namespace Lomont.Compression.Codec
         public override void WriteHeader(Bitstream bitstream, Datastream data, Header.HeaderFlags headerFlags)
         {
 
+            streamCount = Math.Max(1, Math.Min(Streams, MaxInterleavedStreams));
+            if (streamCount > 1)
+            {
+                // interleaved decoders need the symbol count
+                WriteInterleavedMark(bitstream);
+                headerFlags |= Header.HeaderFlags.SymbolCount;
+            }
             Header.WriteUniversalHeader(bitstream, data, headerFlags);
+            if (streamCount > 1)
+                UniversalCodec.Lomont.EncodeLomont1(bitstream, streamCount - 1, 2, 0);
+            symbolIndex = 0;
+            interleavedStreams.Clear();
+            for (var i = 0; i < streamCount && streamCount > 1; ++i)
+                interleavedStreams.Add(new Bitstream());
             if (data.Count == 0)
                 return;
 
@@ -95,6 +126,8 @@ namespace Lomont.Compression.Codec
             // after this the rest of the tree is not needed
             leaves.Clear();
             GetLeaves(tree);
+            if (MaxCodewordLength != 0)
+                LimitCodewordLengths(leaves, MaxCodewordLength);
             MakeCanonical(leaves); // relabel codewords into canonical ordering
 
 
@@ -109,6 +142,8 @@ namespace Lomont.Compression.Codec
 
         public override void CompressSymbol(Bitstream bitstream, uint symbol)
         {
+            if (streamCount > 1)
+                bitstream = interleavedStreams[(int)(symbolIndex++ % streamCount)];
             var node = leaves.Find(n => n.Symbol == symbol);
             // write MSB first
             for (var i = (int)node.Codeword.BitLength - 1; i >= 0; --i)
@@ -121,6 +156,8 @@ namespace Lomont.Compression.Codec
 
         public override void WriteFooter(Bitstream bitstream)
         {
+            if (streamCount > 1)
+                WriteInterleavedStreams(bitstream, interleavedStreams);
             if (Options.HasFlag(OptionFlags.DumpEncoding))
                 WriteLine("]");
         }
@@ -182,11 +219,31 @@ namespace Lomont.Compression.Codec
             // save stream for internal use
             state.Bitstream = bitstream;
 
+            if (Streams > 1)
+            {
+                ReadInterleavedMark(bitstream);
+                headerFlags |= Header.HeaderFlags.SymbolCount;
+            }
             var header = Header.ReadUniversalHeader(bitstream, headerFlags);
             state.SymbolLength = header.Item1;
 
+            streamCount = 1;
+            symbolIndex = 0;
+            if (headerFlags.HasFlag(Header.HeaderFlags.SymbolCount) && state.SymbolLength == 0)
+            {
+                // no table is stored
+                if (Streams <= 1)
+                    CheckNotInterleaved(bitstream);
+                return 0;
+            }
+            if (Streams > 1)
+                streamCount = UniversalCodec.Lomont.DecodeLomont1(bitstream, 2, 0) + 1;
+
             ParseTable(state, useLowMemoryDecoding);
 
+            if (streamCount > 1)
+                streamPositions = ReadInterleavedStreams(bitstream, streamCount);
+
             if (!useLowMemoryDecoding)
             {
                 // dump table for debugging
@@ -268,6 +325,20 @@ namespace Lomont.Compression.Codec
         }
 
         public override uint DecompressSymbol(Bitstream bitstream)
+        {
+            if (streamCount > 1)
+            {
+                // decode from the next stream in turn
+                var stream = (int)(symbolIndex++ % streamCount);
+                state.Bitstream.Position = streamPositions[stream];
+                var symbol = DecompressStreamSymbol();
+                streamPositions[stream] = state.Bitstream.Position;
+                return symbol;
+            }
+            return DecompressStreamSymbol();
+        }
+
+        uint DecompressStreamSymbol()
         {
             // items for walking the table
             uint accumulator = 0; // store bits read in until matches a codeword
@@ -346,6 +417,8 @@ namespace Lomont.Compression.Codec
 
         public override void ReadFooter(Bitstream bitstream)
         {
+            if (streamCount > 1)
+                bitstream.Position = streamPositions[streamCount]; // past the last stream
             if (Options.HasFlag(OptionFlags.DumpDecoding))
                 WriteLine();
         }
@@ -358,6 +431,12 @@ namespace Lomont.Compression.Codec
 
         readonly List<Node> leaves = new List<Node>();
 
+        // interleaved stream state, streamCount is 1 for the usual single stream
+        uint streamCount = 1;
+        uint symbolIndex;
+        readonly List<Bitstream> interleavedStreams = new List<Bitstream>();
+        uint[] streamPositions;
+
         /// <summary>
         /// Make probability tree
         /// </summary>
@@ -395,6 +474,76 @@ namespace Lomont.Compression.Codec
             return nodes[0];
         }
 
+        // Shorten codewords to at most maxLength bits, keeping them the best code with that 
+        // limit, found by package-merge. Only lengths are set, MakeCanonical assigns values.
+        void LimitCodewordLengths(List<Node> leaves1, uint maxLength)
+        {
+            var n = leaves1.Count;
+            maxLength = Math.Max(maxLength, BitsRequired((uint)n - 1)); // n codewords need this many bits
+            if (n < 2 || leaves1.Max(l => l.Codeword.BitLength) <= maxLength)
+                return;
+
+            // each level packages adjacent pairs of the previous list, merged with the leaves
+            var sortedLeaves = leaves1
+                .Select((l, i) => new MergeItem {Weight = l.FrequencyCount, Leaf = i})
+                .OrderBy(m => m.Weight)
+                .ToList();
+            var list = sortedLeaves;
+            for (var level = 1; level < maxLength; ++level)
+            {
+                var packages = new List<MergeItem>();
+                for (var i = 0; i + 1 < list.Count; i += 2)
+                    packages.Add(new MergeItem {Weight = list[i].Weight + list[i + 1].Weight, Leaf = -1, First = list[i], Second = list[i + 1]});
+                list = MergeItems(sortedLeaves, packages);
+            }
+
+            // the codeword length of a leaf is the times it is in the cheapest 2n-2 items
+            var lengths = new uint[n];
+            var pending = new Stack<MergeItem>(list.Take(2 * n - 2));
+            while (pending.Count > 0)
+            {
+                var item = pending.Pop();
+                if (item.Leaf >= 0)
+                    lengths[item.Leaf]++;
+                else
+                {
+                    pending.Push(item.First);
+                    pending.Push(item.Second);
+                }
+            }
+
+            for (var i = 0; i < n; ++i)
+            {
+                var codeword = new Codeword();
+                for (var j = 0; j < lengths[i]; ++j)
+                    codeword.AppendBit(0);
+                leaves1[i].Codeword = codeword;
+            }
+        }
+
+        // package-merge item, a leaf or a package of two items
+        class MergeItem
+        {
+            public long Weight;
+            public int Leaf; // index in leaves, -1 for packages
+            public MergeItem First, Second;
+        }
+
+        // merge two lists sorted by weight, leaves first on ties
+        static List<MergeItem> MergeItems(List<MergeItem> leaves1, List<MergeItem> packages)
+        {
+            var merged = new List<MergeItem>(leaves1.Count + packages.Count);
+            int i = 0, j = 0;
+            while (i < leaves1.Count || j < packages.Count)
+            {
+                if (j == packages.Count || (i < leaves1.Count && leaves1[i].Weight <= packages[j].Weight))
+                    merged.Add(leaves1[i++]);
+                else
+                    merged.Add(packages[j++]);
+            }
+            return merged;
+        }
+
         // turn the codewords into canonical ordered ones
         // needed for make table later
         void MakeCanonical(List<Node> leaves1)
@@ -80,6 +80,43 @@ namespace Lomont.Compression.Codec
         [CodecParameter("Maximum length", "maxLen", "Maximum length of a run to be worthwhile")]
         public uint MaximumLength { get; set; } = (1 << 9);
 
+        /// <summary>
+        /// Most match candidates checked per position, 0 for all. Nonzero is
+        /// faster on large inputs, but may find shorter matches.
+        /// </summary>
+        [CodecParameter("Match depth", "depth", "Most match candidates checked per position, 0 for all")]
+        public uint MatchDepth { get; set; } = 0;
+
+        /// <summary>
+        /// Nonzero to round the distance field of tokens up to a power of two, so 
+        /// decoders split a token with a shift and mask instead of a divide. 
+        /// Costs some size, see PowerOfTwoTokenCost. Streams stay readable by any decoder.
+        /// </summary>
+        [CodecParameter("Power of two tokens", "pow2", "1 to split tokens with a shift instead of a divide, at some size cost")]
+        public uint PowerOfTwoTokens { get; set; } = 0;
+
+        /// <summary>
+        /// Bits added to the last compressed stream by PowerOfTwoTokens
+        /// </summary>
+        public long PowerOfTwoTokenCost { get; private set; }
+
+        /// <summary>
+        /// How matches are found. All finders give the same streams when MatchDepth is 0.
+        /// </summary>
+        public MatchFinder.FinderType MatchFinderType { get; set; } = MatchFinder.FinderType.HashChain;
+
+        /// <summary>
+        /// Match index of the data to compress, shared between compressions of the
+        /// same data such as a parameter sweep. Built for each compression if null.
+        /// </summary>
+        public MatchIndex SharedMatchIndex { get; set; }
+
+        /// <summary>
+        /// Preset dictionary logically before the data, or null for none. 
+        /// Decompression needs the same dictionary, see PresetDictionary.
+        /// </summary>
+        public byte[] Dictionary { get; set; }
+
         #endregion
 
         #region Compression functions
@@ -236,10 +273,39 @@ namespace Lomont.Compression.Codec
                 Write("LZ77 decode stream: ");
 
             decoderState.Reset();
+            if (Dictionary != null)
+            {
+                // runs may reach back into the dictionary
+                decoderState.DecoderStream.AddRange(Dictionary.Select(b => (uint)b));
+                decoderState.DatumIndex = Dictionary.Length;
+            }
 
             return decoderState.ByteLength;
         }
 
+        /// <summary>
+        /// C #defines fixing the header values of the compressed data
+        /// </summary>
+        /// <param name="compressed">Output of Compress</param>
+        /// <returns></returns>
+        public override List<Tuple<string, uint>> GetDecoderDefines(byte[] compressed)
+        {
+            var bitstream = new Bitstream(compressed) {Position = 0};
+            Header.ReadUniversalHeader(bitstream, Header.HeaderFlags.SymbolCount);
+            var bitsPerSymbol = UniversalCodec.Lomont.DecodeLomont1(bitstream, 3, 0) + 1;
+            var bitsPerToken = UniversalCodec.Lomont.DecodeLomont1(bitstream, 5, 0) + 1;
+            var minLength = UniversalCodec.Lomont.DecodeLomont1(bitstream, 2, 0);
+            UniversalCodec.Lomont.DecodeLomont1(bitstream, 25, -10); // max token
+            var maxDistance = UniversalCodec.Lomont.DecodeLomont1(bitstream, 14, -7);
+            return new List<Tuple<string, uint>>
+            {
+                Tuple.Create("DECOMPRESSOR_LZ77_BITS_PER_SYMBOL", bitsPerSymbol),
+                Tuple.Create("DECOMPRESSOR_LZ77_BITS_PER_TOKEN", bitsPerToken),
+                Tuple.Create("DECOMPRESSOR_LZ77_MIN_LENGTH", minLength),
+                Tuple.Create("DECOMPRESSOR_LZ77_MAX_DISTANCE", maxDistance)
+            };
+        }
+
         /// <summary>
         /// Decompress a symbol in the compression algorithm
         /// </summary>
@@ -360,37 +426,16 @@ namespace Lomont.Compression.Codec
         /// <param name="data"></param>
         private void ScanData(Datastream data)
         {
-            uint index = 0; // index of symbol to encode
-            while (index < data.Count)
+            // matches may start in the dictionary, but parsing starts after it
+            var symbols = PresetDictionary.Prepend(Dictionary, data);
+            var finder = MatchFinder.Create(MatchFinderType, symbols, MaximumDistance, MinimumLength, MaximumLength, MatchDepth, SharedMatchIndex);
+            var index = (uint)(symbols.Count - data.Count); // index of symbol to encode
+            while (index < symbols.Count)
             {
                 // find best run
-                uint bestDistance = 0;
-                uint bestLength = 0;
-                // walk backwards to end with smallest distance for a given run length
-                for (int distance = (int) MaximumDistance; distance >= 0; --distance)
-                {
-                    uint length = 0;
-                    while (
-                        // bound check the values
-                        0 <= index - 1 - distance + length &&
-                        index - 1 - distance + length < data.Count &&
-                        index + length < data.Count &&
-                        // check the bytes match
-                        data[(int)(index - 1 - distance + length)] == data[(int)(index + length)] &&
-                        // don't get longer than this
-                        length < MaximumLength
-                        )
-                    {
-                        length++;
-                    }
-                    // keep best
-                    if (length >= bestLength)
-                    {
-                        // break ties in this direction to have shorter distances
-                        bestLength = length;
-                        bestDistance = (uint) distance;
-                    }
-                }
+                var match = finder.FindMatch((int)index);
+                uint bestDistance = match.Distance;
+                uint bestLength = match.Length;
 
                 // now with best run, decide how to encode next part
                 if (bestLength >= MinimumLength)
@@ -405,7 +450,7 @@ namespace Lomont.Compression.Codec
                 {
                     // encode literal
                     decisions.Add(0); // select literal
-                    literals.Add(data[(int)index]); // save value
+                    literals.Add(symbols[(int)index]); // save value
                     index++;
                 }
             }
@@ -424,17 +469,32 @@ namespace Lomont.Compression.Codec
             // token (distance,length) is encoded as
             //   (length - actualMinLength) * (actualMaxDistance+1) + distance
             // compute largest occurring token value
-            uint actualMaxToken = 0;
-            for (var i = 0; i < distances.Count; ++i)
+            Func<uint, uint> maxToken = maxDistance =>
             {
-                uint length = lengths[i];
-                uint distance = distances[i];
-                uint token = (length - encoderState.ActualMinLength)*(encoderState.ActualMaxDistance + 1) + distance;
-                actualMaxToken = Math.Max(actualMaxToken, token);
+                uint max = 0;
+                for (var i = 0; i < distances.Count; ++i)
+                {
+                    uint length = lengths[i];
+                    uint distance = distances[i];
+                    uint token = (length - encoderState.ActualMinLength)*(maxDistance + 1) + distance;
+                    max = Math.Max(max, token);
+                }
+                return max;
+            };
+            uint actualMaxToken = maxToken(encoderState.ActualMaxDistance);
+
+            PowerOfTwoTokenCost = 0;
+            if (PowerOfTwoTokens != 0)
+            {
+                // distance field rounded to a power of two, tokens may need more bits
+                var exactBits = BitsRequired(actualMaxToken);
+                encoderState.ActualMaxDistance = RoundUpToPowerOfTwoMinusOne(encoderState.ActualMaxDistance);
+                actualMaxToken = maxToken(encoderState.ActualMaxDistance);
+                PowerOfTwoTokenCost = (long)(BitsRequired(actualMaxToken) - exactBits)*distances.Count;
             }
-            
+
             // bit sizes
-            encoderState.ActualBitsPerSymbol = BitsRequired(literals.Max());
+            encoderState.ActualBitsPerSymbol = BitsRequired(literals.Any() ? literals.Max() : 0);
             encoderState.ActualBitsPerToken = BitsRequired(actualMaxToken);
 
             //some info to help analyze
@@ -25,6 +25,7 @@ using System;
 using System.Collections.Generic;
 using System.Diagnostics;
 using System.Linq;
+using System.Threading.Tasks;
 
 namespace Lomont.Compression.Codec
 {
@@ -42,7 +43,7 @@ namespace Lomont.Compression.Codec
     /// Format:
     ///    TODO - document cleanly :)
     /// </summary>
-    [Codec("LZCL")]
+    [Codec("LZCL", Version = 2)]
     public class LzclCodec : CodecBase
     {
         #region Settings
@@ -64,7 +65,8 @@ namespace Lomont.Compression.Codec
             CompressionChecker.OptionFlags.UseFixed |
             CompressionChecker.OptionFlags.UseArithmetic |
             CompressionChecker.OptionFlags.UseHuffman |
-            CompressionChecker.OptionFlags.UseGolomb;
+            CompressionChecker.OptionFlags.UseGolomb |
+            CompressionChecker.OptionFlags.UseRans;
 
         public OptionFlags Options { get; set; } = OptionFlags.None;
 
@@ -89,6 +91,109 @@ namespace Lomont.Compression.Codec
         /// </summary>
         [CodecParameter("Maximum length", "maxLen", "Maximum length of a run to be worthwhile")]
         public uint MaximumLength { get; set; } = (1 << 9);
+
+        /// <summary>
+        /// Most match candidates checked per position, 0 for all. Nonzero is
+        /// faster on large inputs, but may find shorter matches.
+        /// </summary>
+        [CodecParameter("Match depth", "depth", "Most match candidates checked per position, 0 for all")]
+        public uint MatchDepth { get; set; } = 0;
+
+        /// <summary>
+        /// Nonzero to round the distance field of tokens up to a power of two, so 
+        /// decoders split a token with a shift and mask instead of a divide. 
+        /// Costs some size, see PowerOfTwoTokenCost. Streams stay readable by any decoder.
+        /// </summary>
+        [CodecParameter("Power of two tokens", "pow2", "1 to split tokens with a shift instead of a divide, at some size cost")]
+        public uint PowerOfTwoTokens { get; set; } = 0;
+
+        /// <summary>
+        /// Nonzero to replace the greedy longest match parse with this many passes of a
+        /// price based optimal parse. Each pass prices literals, decisions, distances, and
+        /// lengths from the symbol counts of the previous parse, starting from the greedy 
+        /// one, then finds the cheapest parse with all candidate matches. Slower to compress,
+        /// usually smaller with fewer tokens, and any decoder reads the output.
+        /// </summary>
+        [CodecParameter("Optimal parse", "optimal", "Price based parse passes, 0 for greedy longest matches, 2 is a good choice")]
+        public uint OptimalParsePasses { get; set; } = 0;
+
+        /// <summary>
+        /// Bits added to the token choice of the last compressed stream by PowerOfTwoTokens
+        /// </summary>
+        public long PowerOfTwoTokenCost { get; private set; }
+
+        /// <summary>
+        /// How matches are found. All finders give the same streams when MatchDepth is 0.
+        /// </summary>
+        public MatchFinder.FinderType MatchFinderType { get; set; } = MatchFinder.FinderType.HashChain;
+
+        /// <summary>
+        /// Match index of the data to compress, shared between compressions of the
+        /// same data such as a parameter sweep. Built for each compression if null.
+        /// </summary>
+        public MatchIndex SharedMatchIndex { get; set; }
+
+        /// <summary>
+        /// Preset dictionary logically before the data, or null for none. 
+        /// Decompression needs the same dictionary, see PresetDictionary.
+        /// </summary>
+        public byte[] Dictionary { get; set; }
+
+        /// <summary>
+        /// Most decode cycles per output byte the sub-codecs may take, 0 for no limit. Sub-codecs
+        /// are then chosen for the smallest output within the budget, from the cycles per symbol
+        /// of each codec below, or the fastest if nothing fits. Match copies are not counted.
+        /// </summary>
+        [CodecParameter("Decode budget", "budget", "Most sub-codec decode cycles per output byte, 0 for no limit")]
+        public uint DecodeBudget { get; set; } = 0;
+
+        /// <summary>
+        /// Bits of output worth 1000 decode cycles when choosing sub-codecs, 0 to choose by size.
+        /// For example, with the default cycles a weight of 1 takes Huffman over Arithmetic for
+        /// a stream unless Arithmetic saves about 3 bits per symbol.
+        /// </summary>
+        [CodecParameter("Decode weight", "speed", "Bits worth 1000 sub-codec decode cycles, 0 to choose by size")]
+        public uint DecodeWeight { get; set; } = 0;
+
+        /// <summary>
+        /// Decode cycles per symbol of each sub-codec, used by DecodeBudget and DecodeWeight.
+        /// The defaults are from the bit at a time decoders on a desktop host. For a target,
+        /// take the Huffman, Arithmetic, and Rans cycles/byte of HostBenchmark one-shot runs
+        /// built for it. Fixed and Golomb only decode inside LZCL, and cost about 1/6 and 1/3
+        /// of Huffman.
+        /// </summary>
+        [CodecParameter("Fixed cycles", "cyFixed", "Fixed decode cycles per symbol, for budget and speed")]
+        public uint FixedCycles { get; set; } = 20;
+
+        /// <summary>
+        /// Arithmetic decode cycles per symbol, see FixedCycles
+        /// </summary>
+        [CodecParameter("Arithmetic cycles", "cyArith", "Arithmetic decode cycles per symbol, for budget and speed")]
+        public uint ArithmeticCycles { get; set; } = 3000;
+
+        /// <summary>
+        /// Huffman decode cycles per symbol, see FixedCycles
+        /// </summary>
+        [CodecParameter("Huffman cycles", "cyHuff", "Huffman decode cycles per symbol, for budget and speed")]
+        public uint HuffmanCycles { get; set; } = 120;
+
+        /// <summary>
+        /// Golomb decode cycles per symbol, see FixedCycles
+        /// </summary>
+        [CodecParameter("Golomb cycles", "cyGolomb", "Golomb decode cycles per symbol, for budget and speed")]
+        public uint GolombCycles { get; set; } = 40;
+
+        /// <summary>
+        /// Rans decode cycles per symbol, see FixedCycles
+        /// </summary>
+        [CodecParameter("Rans cycles", "cyRans", "Rans decode cycles per symbol, for budget and speed")]
+        public uint RansCycles { get; set; } = 270;
+
+        /// <summary>
+        /// Estimated sub-codec decode cycles per output byte of the last compressed stream,
+        /// from the cycles per symbol settings
+        /// </summary>
+        public double DecodeCyclesPerByte { get; private set; }
         #endregion
 
         #region Compression functions
@@ -109,6 +214,7 @@ namespace Lomont.Compression.Codec
             distances.Clear();
             lengths.Clear();
             tokens.Clear();
+            exactTokens.Clear();
 
             // fill in all the data streams
             uint actualMinLength, actualMaxDistance;
@@ -137,12 +243,49 @@ namespace Lomont.Compression.Codec
             }
 
             // get compressed streams so we can decide what to output
-            var decisionChoice     = GetBestCompressor("decisions"    , decisions   );
-            var decisionRunsChoice = GetBestCompressor("decision runs", decisionRuns);
-            var literalsChoice     = GetBestCompressor("literals", literals);
-            var tokensChoice       = GetBestCompressor("tokens", tokens);
-            var distancesChoice    = GetBestCompressor("distances", distances);
-            var lengthsChoice      = GetBestCompressor("lengths", lengths);
+            // the six streams are independent, so try them all at once
+            // candidates of each stream are smallest first
+            var streams = new[] {decisions, decisionRuns, literals, tokens, distances, lengths};
+            var candidates = new List<Tuple<Type, Bitstream>>[streams.Length];
+            List<Tuple<Type, Bitstream>> exactTokensCandidates = null;
+            Parallel.Invoke(
+                () => candidates[DecisionStream]     = GetCompressors("decisions"    , decisions   ),
+                () => candidates[DecisionRunStream]  = GetCompressors("decision runs", decisionRuns),
+                () => candidates[LiteralStream]      = GetCompressors("literals", literals),
+                () => candidates[TokenStream]        = GetCompressors("tokens", tokens),
+                () => candidates[DistanceStream]     = GetCompressors("distances", distances),
+                () => candidates[LengthStream]       = GetCompressors("lengths", lengths),
+                () => exactTokensCandidates  = exactTokens.Any() ? GetCompressors("exact tokens", exactTokens) : null
+                );
+
+            PowerOfTwoTokenCost = 0;
+            if (exactTokensCandidates != null)
+            {
+                // size of the token choice with and without rounding
+                var pairsLength = candidates[DistanceStream][0].Item2.Length + candidates[LengthStream][0].Item2.Length;
+                PowerOfTwoTokenCost = Math.Min(candidates[TokenStream][0].Item2.Length, pairsLength) - Math.Min(exactTokensCandidates[0].Item2.Length, pairsLength);
+                foreach (var candidate in exactTokensCandidates)
+                    BitstreamPool.Return(candidate.Item2);
+            }
+
+            var choice = ChooseCodecs(candidates, streams, data.Count);
+            var choices = choice.Indices.Select((c, i) => c < 0 ? null : candidates[i][c]).ToArray();
+            var decisionChoice = choices[DecisionStream];
+            var decisionRunsChoice = choices[DecisionRunStream];
+            var literalsChoice = choices[LiteralStream];
+            var tokensChoice = choices[TokenStream];
+            var distancesChoice = choices[DistanceStream];
+            var lengthsChoice = choices[LengthStream];
+            DecodeCyclesPerByte = data.Count > 0 ? (double)choice.Cycles / data.Count : 0;
+
+            if (Options.HasFlag(OptionFlags.DumpCompressorSelections))
+            {
+                var labels = new[] {"decisions", "decision runs", "literals", "tokens", "distances", "lengths"};
+                for (var i = 0; i < choices.Length; ++i)
+                    if (choices[i] != null)
+                        WriteLine($"{labels[i]} using {choices[i].Item1.Name}");
+                WriteLine($"about {DecodeCyclesPerByte:F1} sub-codec decode cycles per byte");
+            }
 
             // write header values
             Header.WriteUniversalHeader(bitstream, data, headerFlags);
@@ -156,7 +299,7 @@ namespace Lomont.Compression.Codec
             if (Options.HasFlag(OptionFlags.DumpDebug))
                 WriteLine($"Max distance {actualMaxDistance}");
 
-            if (decisionChoice.Item2.Length < decisionRunsChoice.Item2.Length)
+            if (decisionChoice != null)
             {   
                 // denote choice
                 bitstream.Write(0); 
@@ -185,7 +328,7 @@ namespace Lomont.Compression.Codec
 
 
             // tokens or separate distance, length pairs
-            if (tokensChoice.Item2.Length < distancesChoice.Item2.Length + lengthsChoice.Item2.Length)
+            if (tokensChoice != null)
             {
                 // denote choice
                 bitstream.Write(0);
@@ -207,6 +350,10 @@ namespace Lomont.Compression.Codec
                 StatRecorder.AddStat($"codec used: distances {distancesChoice.Item1.Name}", 1);
                 StatRecorder.AddStat($"codec used: lengths {lengthsChoice.Item1.Name}", 1);
             }
+
+            // streams are copied into the output, so can be reused
+            foreach (var candidate in candidates.SelectMany(c => c))
+                BitstreamPool.Return(candidate.Item2);
         }
 
         class Decoder
@@ -228,6 +375,9 @@ namespace Lomont.Compression.Codec
             var decoder = new Decoder();
             // save type
             uint type = bitstream.Read(2);
+            decoder.BitLength = UniversalCodec.Lomont.DecodeLomont1(bitstream, 6, 0);
+            var itemPosition = bitstream.Position;
+            type = ReadExtendedType(bitstream, type);
             if (type == 0)
                 decoder.Codec = new FixedSizeCodec();
             else if (type == 1)
@@ -236,9 +386,10 @@ namespace Lomont.Compression.Codec
                 decoder.Codec = new HuffmanCodec();
             else if (type == 3)
                 decoder.Codec = new GolombCodec();
+            else if (type == 4)
+                decoder.Codec = new RansCodec();
             else
                 throw new NotImplementedException("Unknown compressor type");
-            decoder.BitLength = UniversalCodec.Lomont.DecodeLomont1(bitstream, 6, 0);
             if (Options.HasFlag(OptionFlags.DumpDebug))
                 WriteLine($"Compressor index {type}, length {decoder.BitLength}");
 
@@ -247,7 +398,7 @@ namespace Lomont.Compression.Codec
             decoder.Bitstream.WriteStream(bitstream);
             decoder.Bitstream.Position = bitstream.Position;
             decoder.Codec.ReadHeader(decoder.Bitstream, internalFlags);
-            bitstream.Position += decoder.BitLength;
+            bitstream.Position = itemPosition + decoder.BitLength;
             if (Options.HasFlag(OptionFlags.DumpDebug))
                 WriteLine($"Post read item position {bitstream.Position}");
             return decoder;
@@ -255,6 +406,24 @@ namespace Lomont.Compression.Codec
 
         Header.HeaderFlags internalFlags = Header.HeaderFlags.None; // todo - make None to save bits
 
+        // The 2 bit type field holds types 0-3. Type 3 with a Golomb parameter of 0,
+        // which Golomb never uses, is followed by a Lomont1(2,0) index of further types
+        // from 4 on, then their stream. Both are in the stored bit length.
+        const uint ExtendedTypeEscape = 3;
+        const uint FirstExtendedType = 4;
+
+        // Read the extended type following type if any, else leave the position alone
+        static uint ReadExtendedType(Bitstream bitstream, uint type)
+        {
+            if (type != ExtendedTypeEscape)
+                return type;
+            var position = bitstream.Position;
+            if (UniversalCodec.Lomont.DecodeLomont1(bitstream, 6, 0) == 0)
+                return FirstExtendedType + UniversalCodec.Lomont.DecodeLomont1(bitstream, 2, 0);
+            bitstream.Position = position;
+            return type;
+        }
+
         void WriteItem(Bitstream bitstream, Tuple<Type,Bitstream> item)
         {
             // save type
@@ -267,13 +436,24 @@ namespace Lomont.Compression.Codec
                 bitstream.Write(2, 2);
             else if (codecType == typeof(GolombCodec))
                 bitstream.Write(3, 2);
+            else if (codecType == typeof(RansCodec))
+                bitstream.Write(ExtendedTypeEscape, 2);
             else
                 throw new NotImplementedException("Unknown compressor type");
+
+            var extendedType = new Bitstream();
+            if (codecType == typeof(RansCodec))
+            {
+                UniversalCodec.Lomont.EncodeLomont1(extendedType, 0, 6, 0); // escape
+                UniversalCodec.Lomont.EncodeLomont1(extendedType, 4 - FirstExtendedType, 2, 0);
+            }
+
             // save bit size
-            UniversalCodec.Lomont.EncodeLomont1(bitstream, item.Item2.Length, 6, 0);
+            UniversalCodec.Lomont.EncodeLomont1(bitstream, extendedType.Length + item.Item2.Length, 6, 0);
             if (Options.HasFlag(OptionFlags.DumpDebug))
                 WriteLine($"Compressor type {codecType.Name}, length {item.Item2.Length}");
             // save stream
+            bitstream.WriteStream(extendedType);
             bitstream.WriteStream(item.Item2);
         }
 
@@ -317,6 +497,12 @@ namespace Lomont.Compression.Codec
             // read header values
             var header = Header.ReadUniversalHeader(bitstream, headerFlags);
             decoderState.SymbolCount = header.Item1;
+            if (Dictionary != null)
+            {
+                // runs may reach back into the dictionary
+                decoderState.DecoderStream.AddRange(Dictionary.Select(b => (uint)b));
+                decoderState.DatumIndex = Dictionary.Length;
+            }
 
             // get max distance occurring, used to encode tokens, very useful to users to know window needed size
             decoderState.ActualMaxDistance = UniversalCodec.Lomont.DecodeLomont1(bitstream, 10, 0);
@@ -351,6 +537,50 @@ namespace Lomont.Compression.Codec
             return decoderState.SymbolCount;
         }
 
+        /// <summary>
+        /// C #defines fixing the header values of the compressed data
+        /// </summary>
+        /// <param name="compressed">Output of Compress</param>
+        /// <returns></returns>
+        public override List<Tuple<string, uint>> GetDecoderDefines(byte[] compressed)
+        {
+            // get sub-codec type, skip its stream
+            Func<Bitstream, uint> skipItem = b =>
+            {
+                var type = b.Read(2);
+                var bitLength = UniversalCodec.Lomont.DecodeLomont1(b, 6, 0);
+                var itemPosition = b.Position;
+                type = ReadExtendedType(b, type);
+                b.Position = itemPosition + bitLength;
+                return type;
+            };
+
+            var defines = new List<Tuple<string, uint>>();
+            var bitstream = new Bitstream(compressed) {Position = 0};
+            Header.ReadUniversalHeader(bitstream, Header.HeaderFlags.SymbolCount);
+            defines.Add(Tuple.Create("DECOMPRESSOR_LZCL_MAX_DISTANCE", UniversalCodec.Lomont.DecodeLomont1(bitstream, 10, 0)));
+            defines.Add(Tuple.Create("DECOMPRESSOR_LZCL_MIN_LENGTH", UniversalCodec.Lomont.DecodeLomont1(bitstream, 2, 0)));
+
+            var decisionRuns = bitstream.Read(1);
+            defines.Add(Tuple.Create("DECOMPRESSOR_LZCL_DECISION_RUNS", decisionRuns));
+            if (decisionRuns != 0)
+                bitstream.Read(1); // initial value
+            defines.Add(Tuple.Create("DECOMPRESSOR_LZCL_DECISION_CODEC", skipItem(bitstream)));
+            defines.Add(Tuple.Create("DECOMPRESSOR_LZCL_LITERAL_CODEC", skipItem(bitstream)));
+
+            // stored bit is 0 for tokens
+            var useTokens = bitstream.Read(1) == 0 ? 1U : 0U;
+            defines.Add(Tuple.Create("DECOMPRESSOR_LZCL_USE_TOKENS", useTokens));
+            if (useTokens != 0)
+                defines.Add(Tuple.Create("DECOMPRESSOR_LZCL_TOKEN_CODEC", skipItem(bitstream)));
+            else
+            {
+                defines.Add(Tuple.Create("DECOMPRESSOR_LZCL_DISTANCE_CODEC", skipItem(bitstream)));
+                defines.Add(Tuple.Create("DECOMPRESSOR_LZCL_LENGTH_CODEC", skipItem(bitstream)));
+            }
+            return defines;
+        }
+
         /// <summary>
         /// Decompress a symbol in the compression algorithm
         /// </summary>
@@ -426,6 +656,10 @@ namespace Lomont.Compression.Codec
         /// (length - actualMinLength)*(actualMaxDistance+1)+distance
         /// </summary>
         private readonly List<uint> tokens = new List<uint>();
+        /// <summary>
+        /// tokens packed with the unrounded max distance, when PowerOfTwoTokens is set
+        /// </summary>
+        private readonly List<uint> exactTokens = new List<uint>();
 
         /// <summary>
         /// Process the data to compress, creating various list of values to be compressed later
@@ -435,54 +669,39 @@ namespace Lomont.Compression.Codec
         /// <param name="actualMaxDistance"></param>
         private void ComputeStreams(Datastream data, out uint actualMinLength, out uint actualMaxDistance)
         {
-            uint index = 0; // index of symbol to encode
-            while (index < data.Count)
+            // matches may start in the dictionary, but parsing starts after it
+            var symbols = PresetDictionary.Prepend(Dictionary, data);
+            var start = symbols.Count - data.Count;
+            var finder = MatchFinder.Create(MatchFinderType, symbols, MaximumDistance, MinimumLength, MaximumLength, MatchDepth, SharedMatchIndex);
+            if (OptimalParsePasses != 0)
+                ParseOptimal(symbols, start, finder);
+            else
             {
-                // find best run
-                uint bestDistance = 0;
-                uint bestLength = 0;
-                // walk backwards to end with smallest distance for a given run length
-                for (int distance = (int)MaximumDistance; distance >= 0; --distance)
+                var index = (uint)start; // index of symbol to encode
+                while (index < symbols.Count)
                 {
-                    uint length = 0;
-                    while (
-                        // bound check the values
-                        0 <= index - 1 - distance + length &&
-                        index - 1 - distance + length < data.Count &&
-                        index + length < data.Count &&
-                        // check the bytes match
-                        data[(int)(index - 1 - distance + length)] == data[(int)(index + length)] &&
-                        // don't get longer than this
-                        length < MaximumLength
-                        )
+                    // find best run
+                    var match = finder.FindMatch((int)index);
+                    uint bestDistance = match.Distance;
+                    uint bestLength = match.Length;
+
+                    // now with best run, decide how to encode next part
+                    if (bestLength >= MinimumLength)
                     {
-                        length++;
+                        // encode (distance,length) token
+                        decisions.Add(1); // select (distance,length)
+                        distances.Add(bestDistance);
+                        lengths.Add(bestLength);
+                        index += bestLength;
                     }
-                    // keep best
-                    if (length >= bestLength)
+                    else
                     {
-                        // break ties in this direction to have shorter distances
-                        bestLength = length;
-                        bestDistance = (uint)distance;
+                        // encode literal
+                        decisions.Add(0); // select literal
+                        literals.Add(symbols[(int)(index)]); // save value
+                        index++;
                     }
                 }
-
-                // now with best run, decide how to encode next part
-                if (bestLength >= MinimumLength)
-                {
-                    // encode (distance,length) token
-                    decisions.Add(1); // select (distance,length)
-                    distances.Add(bestDistance);
-                    lengths.Add(bestLength);
-                    index += bestLength;
-                }
-                else
-                {
-                    // encode literal
-                    decisions.Add(0); // select literal
-                    literals.Add(data[(int)(index)]); // save value
-                    index++;
-                }
             }
 
             Trace.Assert(decisions.Max() < 2);
@@ -496,6 +715,13 @@ namespace Lomont.Compression.Codec
                 lengths[i] -= actualMinLength;
 
             // create tokens in case we need them
+            if (PowerOfTwoTokens != 0)
+            {
+                // exact tokens only to find the size cost of rounding
+                for (var i = 0; i < lengths.Count; ++i)
+                    exactTokens.Add(lengths[i]*(actualMaxDistance+1)+distances[i]);
+                actualMaxDistance = RoundUpToPowerOfTwoMinusOne(actualMaxDistance);
+            }
             for (var i = 0; i < lengths.Count; ++i)
                 tokens.Add(lengths[i]*(actualMaxDistance+1)+distances[i]);
 
@@ -511,47 +737,265 @@ namespace Lomont.Compression.Codec
         }
 
 
+        /// <summary>
+        /// Fill decisions, literals, distances, and lengths with a price based parse
+        /// of symbols from start on, those before being the dictionary.
+        /// Candidates at each position are found once for all passes. The greedy parse
+        /// comes first, then each pass is a shortest path over positions, where a step is
+        /// a literal or a token of any length the candidates give, priced in bits from 
+        /// the previous parse.
+        /// </summary>
+        /// <param name="symbols"></param>
+        /// <param name="start"></param>
+        /// <param name="finder"></param>
+        private void ParseOptimal(Datastream symbols, int start, MatchFinder finder)
+        {
+            var count = symbols.Count;
+            var minLength = Math.Max(MinimumLength, 1);
+
+            // candidates at index i are matches[matchStarts[i]] up to matches[matchStarts[i+1]]
+            var matches = new List<MatchFinder.Match>();
+            var matchStarts = new int[count + 1];
+            for (var i = start; i < count; ++i)
+            {
+                matchStarts[i] = matches.Count;
+                finder.FindAllMatches(i, matches);
+            }
+            matchStarts[count] = matches.Count;
+
+            // steps of a parse, ending at each index, with length 0 for a literal
+            var stepLengths = new uint[count + 1];
+            var stepDistances = new uint[count + 1];
+            var prices = new double[count + 1];
+
+            // greedy parse, the last candidate is the longest
+            for (var i = start; i < count;)
+            {
+                var longest = matchStarts[i + 1] > matchStarts[i] ? matches[matchStarts[i + 1] - 1] : new MatchFinder.Match(0, 0);
+                if (longest.Length >= minLength)
+                {
+                    i += (int)longest.Length;
+                    stepLengths[i] = longest.Length;
+                    stepDistances[i] = longest.Distance;
+                }
+                else
+                    stepLengths[++i] = 0;
+            }
+            EmitParse(symbols, start, stepLengths, stepDistances);
+
+            var symbolCount = symbols.Any() ? symbols.Max() + 1 : 1;
+            var distanceCount = (uint)Math.Min(MaximumDistance + 1L, Math.Max(count, 1));
+            var lengthCount = (uint)Math.Min(MaximumLength + 1L, count - start + 1L);
+            for (var pass = 0; pass < OptimalParsePasses; ++pass)
+            {
+                var decisionPrices = GetPrices(decisions, 2);
+                var literalPrices = GetPrices(literals, symbolCount);
+                var distancePrices = GetPrices(distances, distanceCount);
+                var lengthPrices = GetPrices(lengths, lengthCount);
+
+                for (var i = start + 1; i <= count; ++i)
+                    prices[i] = Double.MaxValue;
+                prices[start] = 0;
+                for (var i = start; i < count; ++i)
+                {
+                    var price = prices[i] + decisionPrices[0] + literalPrices[symbols[i]];
+                    if (price < prices[i + 1])
+                    {
+                        prices[i + 1] = price;
+                        stepLengths[i + 1] = 0;
+                    }
+
+                    // each candidate has the smallest distance for lengths past the previous one
+                    var length = minLength;
+                    for (var j = matchStarts[i]; j < matchStarts[i + 1]; ++j)
+                    {
+                        var match = matches[j];
+                        var tokenPrice = prices[i] + decisionPrices[1] + distancePrices[match.Distance];
+                        for (; length <= match.Length; ++length)
+                        {
+                            price = tokenPrice + lengthPrices[length];
+                            if (price < prices[i + length])
+                            {
+                                prices[i + length] = price;
+                                stepLengths[i + length] = length;
+                                stepDistances[i + length] = match.Distance;
+                            }
+                        }
+                    }
+                }
+
+                decisions.Clear();
+                literals.Clear();
+                distances.Clear();
+                lengths.Clear();
+                EmitParse(symbols, start, stepLengths, stepDistances);
+            }
+        }
+
+        // Walk the parse back from the end to start, and fill the streams in order
+        private void EmitParse(Datastream symbols, int start, uint[] stepLengths, uint[] stepDistances)
+        {
+            var ends = new List<int>();
+            for (var i = symbols.Count; i > start; i -= Math.Max((int)stepLengths[i], 1))
+                ends.Add(i);
+            for (var k = ends.Count - 1; k >= 0; --k)
+            {
+                var end = ends[k];
+                if (stepLengths[end] == 0)
+                {
+                    decisions.Add(0);
+                    literals.Add(symbols[end - 1]);
+                }
+                else
+                {
+                    decisions.Add(1);
+                    distances.Add(stepDistances[end]);
+                    lengths.Add(stepLengths[end]);
+                }
+            }
+        }
+
+        // Bits to code each symbol below alphabetSize, from the counts in symbols. 
+        // Half a count is added to each so unseen symbols may still be chosen.
+        private static double[] GetPrices(List<uint> symbols, uint alphabetSize)
+        {
+            var counts = new double[alphabetSize];
+            foreach (var symbol in symbols)
+                counts[symbol]++;
+            var total = symbols.Count + 0.5 * alphabetSize;
+            var prices = new double[alphabetSize];
+            for (var i = 0; i < alphabetSize; ++i)
+                prices[i] = Math.Log(total / (counts[i] + 0.5), 2);
+            return prices;
+        }
+
         /// <summary>
         /// try various compression on the data, 
-        /// return the best codec and compute the bits saved by it
+        /// return the sub-codecs that can be stored, smallest first, and record the bits saved by the smallest
         /// </summary>
         /// <returns></returns>
-        private Tuple<Type, Bitstream> GetBestCompressor(
+        private List<Tuple<Type, Bitstream>> GetCompressors(
             string label,
             List<uint> data
             )
         {
+            // a stream no symbol is read from, such as tokens when nothing matched, still
+            // needs a codec header, so store one placeholder symbol
+            if (!data.Any())
+                data = new List<uint> {0};
+
             // use this to check each stream
-            var cc = new CompressionChecker {Options = CompressionOptions};
+            var cc = new CompressionChecker {Options = CompressionOptions, KeepBitstreams = true};
             var stream = new Datastream(data);
             var results = cc.TestAll(label, stream, internalFlags);
             results.Sort((a, b) => a.CompressedBitLength.CompareTo(b.CompressedBitLength));
 
-            var best = results[0];
-            CodecBase codec;
-            if (best.CompressorType == typeof(FixedSizeCodec))
-                codec = new FixedSizeCodec();
-            else if (best.CompressorType == typeof(ArithmeticCodec))
-                codec = new ArithmeticCodec();
-            else if (best.CompressorType == typeof(HuffmanCodec))
-                codec = new HuffmanCodec();
-            else if (best.CompressorType == typeof(GolombCodec))
-                codec = new GolombCodec {Parameter = best.Parameters[0]};
-            else
+            // each result has its own trial stream, kept as the output if chosen, so no recompress
+            var compressors = new List<Tuple<Type, Bitstream>>();
+            foreach (var result in results)
+            {
+                if (SubCodecCycles(result.CompressorType) == 0)
+                {
+                    if (result.Bitstream != null)
+                        BitstreamPool.Return(result.Bitstream);
+                }
+                else if (compressors.All(c => c.Item1 != result.CompressorType))
+                    compressors.Add(new Tuple<Type, Bitstream>(result.CompressorType, result.Bitstream));
+                else
+                    BitstreamPool.Return(result.Bitstream); // larger trial of a codec already listed
+            }
+            if (!compressors.Any())
                 throw new NotImplementedException("Unknown codec type");
 
-            var bitstream = codec.CompressToStream(stream, internalFlags);
-
-            var codecName = codec.GetType().Name;
+            var codecName = compressors[0].Item1.Name;
             StatRecorder.AddStat("codec win: " + label + " " + codecName,1);
-            StatRecorder.AddStat($"codec win {codecName} saved high ", results.Last().CompressedBitLength- best.CompressedBitLength);
+            StatRecorder.AddStat($"codec win {codecName} saved high ", results.Last().CompressedBitLength - compressors[0].Item2.Length);
             if (results.Count > 1)
-                StatRecorder.AddStat($"codec win {codecName} saved low  ", results[1].CompressedBitLength - best.CompressedBitLength);
+                StatRecorder.AddStat($"codec win {codecName} saved low  ", results[1].CompressedBitLength - compressors[0].Item2.Length);
 
-            if (Options.HasFlag(OptionFlags.DumpCompressorSelections))
-                WriteLine($"{label} using {codecName}");
+            return compressors;
+        }
+
+        // stream indices for choosing codecs
+        const int DecisionStream = 0, DecisionRunStream = 1, LiteralStream = 2;
+        const int TokenStream = 3, DistanceStream = 4, LengthStream = 5;
 
-            return new Tuple<Type,Bitstream>(codec.GetType(),bitstream);
+        // Decode cycles per symbol of a codec LZCL can store, 0 for others
+        uint SubCodecCycles(Type codecType)
+        {
+            if (codecType == typeof(FixedSizeCodec))
+                return Math.Max(FixedCycles, 1U);
+            if (codecType == typeof(ArithmeticCodec))
+                return Math.Max(ArithmeticCycles, 1U);
+            if (codecType == typeof(HuffmanCodec))
+                return Math.Max(HuffmanCycles, 1U);
+            if (codecType == typeof(GolombCodec))
+                return Math.Max(GolombCycles, 1U);
+            if (codecType == typeof(RansCodec))
+                return Math.Max(RansCycles, 1U);
+            return 0;
+        }
+
+        // Candidate index chosen for each stream, -1 if not stored, and the total
+        // bits and estimated decode cycles
+        class CodecChoice
+        {
+            public int[] Indices = {-1, -1, -1, -1, -1, -1};
+            public long Bits, Cycles;
+
+            public CodecChoice With(int stream, int index, long bits, long cycles)
+            {
+                var choice = new CodecChoice {Bits = Bits + bits, Cycles = Cycles + cycles};
+                Indices.CopyTo(choice.Indices, 0);
+                choice.Indices[stream] = index;
+                return choice;
+            }
+        }
+
+        /// <summary>
+        /// Choose decisions or decision runs, tokens or distance and length pairs, and the
+        /// codec of each stream stored. Without a budget or weight this is the smallest of
+        /// each. Otherwise all combinations are tried for the smallest size, plus DecodeWeight
+        /// bits per 1000 decode cycles, within DecodeBudget cycles per byte, else the fastest.
+        /// Ties keep the smaller codecs, decision runs, and pairs, as the size only choice does.
+        /// </summary>
+        CodecChoice ChooseCodecs(List<Tuple<Type, Bitstream>>[] candidates, List<uint>[] streams, int byteLength)
+        {
+            // all ways to code a stream
+            Func<IEnumerable<CodecChoice>, int, IEnumerable<CodecChoice>> extend = (choices, stream) =>
+                choices.SelectMany(c => candidates[stream].Select((candidate, index) =>
+                    c.With(stream, index, candidate.Item2.Length, (long)streams[stream].Count * SubCodecCycles(candidate.Item1))));
+            var start = new[] {new CodecChoice()};
+            var decisionChoices = extend(start, DecisionRunStream).Concat(extend(start, DecisionStream));
+            var tokenChoices = extend(extend(start, DistanceStream), LengthStream).Concat(extend(start, TokenStream)).ToList();
+
+            var budget = DecodeBudget == 0 ? long.MaxValue : (long)DecodeBudget * byteLength;
+            CodecChoice best = null;
+            foreach (var choice in extend(decisionChoices, LiteralStream))
+            foreach (var tokenChoice in tokenChoices)
+            {
+                var c = new CodecChoice
+                {
+                    Indices = choice.Indices.Zip(tokenChoice.Indices, (a, b) => Math.Max(a, b)).ToArray(),
+                    Bits = choice.Bits + tokenChoice.Bits,
+                    Cycles = choice.Cycles + tokenChoice.Cycles
+                };
+                if (best == null || Better(c, best, budget))
+                    best = c;
+            }
+            return best;
+        }
+
+        // true if a is a better choice than b, within the budget of decode cycles
+        bool Better(CodecChoice a, CodecChoice b, long budget)
+        {
+            var aFits = a.Cycles <= budget;
+            var bFits = b.Cycles <= budget;
+            if (aFits != bFits)
+                return aFits;
+            if (!aFits)
+                return a.Cycles < b.Cycles || (a.Cycles == b.Cycles && a.Bits < b.Bits);
+            return a.Bits * 1000 + DecodeWeight * a.Cycles < b.Bits * 1000 + DecodeWeight * b.Cycles;
         }
 
 
@@ -0,0 +1,299 @@
+﻿/*
+MIT License
+
+Copyright (c) 2016 Chris Lomont
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace Lomont.Compression.Codec
+{
+    /// <summary>
+    /// Finds back references for the LZ77 and LZCL encoders.
+    /// A match at index is a run of symbols equal to the ones starting distance+1
+    /// symbols back, so distance 0 is the previous symbol. Runs may overlap index.
+    /// The longest run is chosen, ties going to the smallest distance.
+    /// </summary>
+    public abstract class MatchFinder
+    {
+        /// <summary>
+        /// One candidate match
+        /// </summary>
+        public struct Match
+        {
+            public uint Distance;
+            public uint Length;
+
+            public Match(uint distance, uint length)
+            {
+                Distance = distance;
+                Length = length;
+            }
+        }
+
+        public enum FinderType
+        {
+            /// <summary>
+            /// Hash chains, checking at most Depth candidates per position, 
+            /// all of them when Depth is 0
+            /// </summary>
+            HashChain,
+
+            /// <summary>
+            /// Checks every distance at every position, slow, the reference for other finders
+            /// </summary>
+            BruteForce
+        }
+
+        /// <summary>
+        /// Make a match finder for data
+        /// </summary>
+        /// <param name="type"></param>
+        /// <param name="data"></param>
+        /// <param name="maximumDistance">Distances go from 0 to this inclusive</param>
+        /// <param name="minimumLength">Shortest run worth finding</param>
+        /// <param name="maximumLength">Longest run allowed</param>
+        /// <param name="depth">Hash chain candidates to check per position, 0 for all</param>
+        /// <param name="index">Index of data to share, or null to build one</param>
+        /// <returns></returns>
+        public static MatchFinder Create(FinderType type, IList<uint> data, uint maximumDistance, uint minimumLength, uint maximumLength, uint depth, MatchIndex index = null)
+        {
+            if (type == FinderType.BruteForce)
+                return new BruteForceMatchFinder(data, maximumDistance, maximumLength);
+            if (index == null || index.Data.Length != data.Count || index.HashLength > Math.Max(1, minimumLength))
+                index = new MatchIndex(data, minimumLength);
+            return new HashChainMatchFinder(index, maximumDistance, maximumLength, depth);
+        }
+
+        protected MatchFinder(uint[] data, uint maximumDistance, uint maximumLength)
+        {
+            Data = data;
+            MaximumDistance = maximumDistance;
+            MaximumLength = maximumLength;
+        }
+
+        protected readonly uint[] Data;
+        protected readonly uint MaximumDistance;
+        protected readonly uint MaximumLength;
+
+        /// <summary>
+        /// Find the longest match at index, ties going to the smallest distance.
+        /// Returns a length 0 match if none.
+        /// Indices must not decrease between calls.
+        /// </summary>
+        /// <param name="index"></param>
+        /// <returns></returns>
+        public abstract Match FindMatch(int index);
+
+        /// <summary>
+        /// Find all useful matches at index, for an optimal parser. Matches are added
+        /// in order of increasing length, each with the smallest distance giving
+        /// any length from the previous match length plus one up to its own.
+        /// Indices must not decrease between calls.
+        /// </summary>
+        /// <param name="index"></param>
+        /// <param name="matches"></param>
+        public abstract void FindAllMatches(int index, List<Match> matches);
+
+        /// <summary>
+        /// Length of the run at index matching the symbols at position, up to limit
+        /// </summary>
+        protected uint MatchLength(int position, int index, uint limit)
+        {
+            uint length = 0;
+            while (length < limit && Data[position + length] == Data[index + length])
+                ++length;
+            return length;
+        }
+
+        /// <summary>
+        /// Longest run allowed at index
+        /// </summary>
+        protected uint LengthLimit(int index)
+        {
+            return (uint)Math.Min(MaximumLength, Data.Length - index);
+        }
+    }
+
+    /// <summary>
+    /// Checks every distance at every position, O(n*maxDist*length)
+    /// </summary>
+    public class BruteForceMatchFinder : MatchFinder
+    {
+        public BruteForceMatchFinder(IList<uint> data, uint maximumDistance, uint maximumLength)
+            : base(data.ToArray(), maximumDistance, maximumLength)
+        {
+        }
+
+        public override Match FindMatch(int index)
+        {
+            var best = new Match(0, 0);
+            var limit = LengthLimit(index);
+            // walk backwards to end with smallest distance for a given run length
+            for (var distance = Math.Min((long)MaximumDistance, index - 1); distance >= 0; --distance)
+            {
+                var length = MatchLength((int)(index - 1 - distance), index, limit);
+                if (length >= best.Length)
+                    best = new Match((uint)distance, length);
+            }
+            return best;
+        }
+
+        public override void FindAllMatches(int index, List<Match> matches)
+        {
+            uint bestLength = 0;
+            var limit = LengthLimit(index);
+            for (var distance = 0; distance <= MaximumDistance && distance < index; ++distance)
+            {
+                var length = MatchLength(index - 1 - distance, index, limit);
+                if (length > bestLength)
+                {
+                    matches.Add(new Match((uint)distance, length));
+                    bestLength = length;
+                    if (length == limit)
+                        break;
+                }
+            }
+        }
+    }
+
+    /// <summary>
+    /// Hash chains over all of a data array. Every position is hashed on its first 
+    /// few symbols, and each position links to the previous one with the same hash,
+    /// so candidates for a position are visited in order of increasing distance.
+    /// Read only once built, so one index can be shared by finders with different
+    /// distances and lengths, even from several threads.
+    /// </summary>
+    public class MatchIndex
+    {
+        /// <summary>
+        /// Build the index
+        /// </summary>
+        /// <param name="data"></param>
+        /// <param name="minimumLength">Shortest match the index must be able to find</param>
+        public MatchIndex(IList<uint> data, uint minimumLength)
+        {
+            Data = new uint[data.Count];
+            data.CopyTo(Data, 0);
+            // hashing more symbols than the minimum length would miss short matches
+            HashLength = (int)Math.Max(1, Math.Min(minimumLength, 3));
+            var bits = 10;
+            while (bits < 20 && (1 << bits) < Data.Length)
+                ++bits;
+            var head = new int[1 << bits];
+            for (var i = 0; i < head.Length; ++i)
+                head[i] = -1;
+            previous = new int[Data.Length];
+            for (var i = 0; i + HashLength <= Data.Length; ++i)
+            {
+                uint hash = 0;
+                for (var j = 0; j < HashLength; ++j)
+                    hash = (hash ^ Data[i + j]) * 2654435761U;
+                hash >>= 32 - bits;
+                previous[i] = head[hash];
+                head[hash] = i;
+            }
+        }
+
+        /// <summary>
+        /// Symbols indexed
+        /// </summary>
+        public readonly uint[] Data;
+
+        /// <summary>
+        /// Symbols hashed per position, matches shorter than this are not found
+        /// </summary>
+        public readonly int HashLength;
+
+        // previous position with the same hash, -1 if none
+        readonly int[] previous;
+
+        /// <summary>
+        /// Most recent position before index with the same hash, or -1
+        /// </summary>
+        public int First(int index)
+        {
+            return index + HashLength <= Data.Length ? previous[index] : -1;
+        }
+
+        /// <summary>
+        /// Next older position with the same hash as position, or -1
+        /// </summary>
+        public int Next(int position)
+        {
+            return previous[position];
+        }
+    }
+
+    /// <summary>
+    /// Hash chain match finder. With no depth limit this finds the same matches as 
+    /// BruteForceMatchFinder for any run of at least the minimum length, in time 
+    /// proportional to the number of real candidates.
+    /// </summary>
+    public class HashChainMatchFinder : MatchFinder
+    {
+        public HashChainMatchFinder(MatchIndex index, uint maximumDistance, uint maximumLength, uint depth)
+            : base(index.Data, maximumDistance, maximumLength)
+        {
+            this.index = index;
+            this.depth = depth;
+        }
+
+        readonly MatchIndex index;
+        readonly uint depth;
+
+        public override Match FindMatch(int index)
+        {
+            return WalkChain(index, null);
+        }
+
+        public override void FindAllMatches(int index, List<Match> matches)
+        {
+            WalkChain(index, matches);
+        }
+
+        // visit candidates newest first, return the best, and add each longer match to matches if not null
+        Match WalkChain(int index, List<Match> matches)
+        {
+            var best = new Match(0, 0);
+            var limit = LengthLimit(index);
+            if (limit < this.index.HashLength)
+                return best; // too short to hash, and shorter than the minimum length
+            uint checkedCount = 0;
+            var oldest = index - 1 - (long)MaximumDistance;
+            for (var position = this.index.First(index); position >= oldest && position >= 0; position = this.index.Next(position))
+            {
+                var length = MatchLength(position, index, limit);
+                if (length > best.Length)
+                {
+                    best = new Match((uint)(index - 1 - position), length);
+                    matches?.Add(best);
+                    if (length == limit)
+                        break; // cannot do better
+                }
+                if (++checkedCount == depth)
+                    break;
+            }
+            return best;
+        }
+    }
+}
@@ -0,0 +1,159 @@
+﻿/*
+MIT License
+
+Copyright (c) 2016 Chris Lomont
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace Lomont.Compression.Codec
+{
+    /// <summary>
+    /// Preset dictionaries for LZ77 and LZCL. A dictionary is symbols that sit logically
+    /// before the data, so runs in the first bytes can copy from it instead of starting
+    /// with an empty window. Nothing about it is stored in the compressed stream, so the
+    /// decoder must be given the same dictionary. The end of the dictionary is the
+    /// cheapest to reach, so the most useful content goes last.
+    /// </summary>
+    public static class PresetDictionary
+    {
+        /// <summary>
+        /// The dictionary followed by the data, or the data if no dictionary
+        /// </summary>
+        /// <param name="dictionary">Dictionary or null</param>
+        /// <param name="data"></param>
+        /// <returns></returns>
+        public static Datastream Prepend(byte[] dictionary, Datastream data)
+        {
+            if (dictionary == null || dictionary.Length == 0)
+                return data;
+            var symbols = new Datastream(dictionary);
+            symbols.AddRange(data);
+            return symbols;
+        }
+
+        /// <summary>
+        /// Build a dictionary of at most size bytes from samples like the data to compress.
+        /// The samples are split into one stretch per segment of the dictionary, and from
+        /// each the segment covering the most frequent grams of gramLength bytes is
+        /// taken, each gram counting only once over all segments. Segments are ordered
+        /// by that score, the best last.
+        /// </summary>
+        /// <param name="samples">Training data</param>
+        /// <param name="size">Most dictionary bytes</param>
+        /// <param name="segmentLength">Bytes per segment</param>
+        /// <param name="gramLength">Bytes per gram, 1 to 8</param>
+        /// <returns></returns>
+        public static byte[] Build(IList<byte[]> samples, int size, int segmentLength = 64, int gramLength = 6)
+        {
+            segmentLength = Math.Min(segmentLength, size);
+            if (gramLength < 1 || gramLength > 8 || segmentLength < gramLength)
+                throw new ArgumentException("Gram length must be 1 to 8, and at most the segment length");
+            var all = samples.SelectMany(s => s).ToArray();
+            if (all.Length <= size)
+                return all;
+
+            // occurrences of each gram over all samples, those in only one place do not help
+            var frequencies = new Dictionary<ulong, int>();
+            foreach (var sample in samples)
+                for (var i = 0; i + gramLength <= sample.Length; ++i)
+                {
+                    var gram = Gram(sample, i, gramLength);
+                    int count;
+                    frequencies.TryGetValue(gram, out count);
+                    frequencies[gram] = count + 1;
+                }
+            foreach (var gram in frequencies.Where(p => p.Value < 2).Select(p => p.Key).ToList())
+                frequencies.Remove(gram);
+
+            var segmentCount = Math.Max(size / segmentLength, 1);
+            var stretch = all.Length / segmentCount;
+            var segments = new List<Tuple<long, int>>(); // score, start
+            for (var k = 0; k < segmentCount; ++k)
+            {
+                var first = k * stretch;
+                var last = Math.Min(first + Math.Max(stretch, segmentLength), all.Length) - segmentLength; // last segment start
+                var best = BestSegment(all, first, last, segmentLength, gramLength, frequencies);
+                if (best.Item1 == 0)
+                    continue;
+                segments.Add(best);
+
+                // covered grams are worth nothing to later segments
+                for (var i = best.Item2; i + gramLength <= best.Item2 + segmentLength; ++i)
+                    frequencies.Remove(Gram(all, i, gramLength));
+            }
+
+            var dictionary = new List<byte>();
+            foreach (var segment in segments.OrderBy(s => s.Item1))
+                dictionary.AddRange(all.Skip(segment.Item2).Take(segmentLength));
+            return dictionary.Skip(Math.Max(dictionary.Count - size, 0)).ToArray();
+        }
+
+        // Best scoring segment starting from first to last inclusive, as (score, start).
+        // The score sums the frequencies of the distinct grams inside the segment.
+        static Tuple<long, int> BestSegment(byte[] data, int first, int last, int segmentLength, int gramLength, Dictionary<ulong, int> frequencies)
+        {
+            var inside = new Dictionary<ulong, int>(); // gram counts in the window
+            long score = 0, bestScore = 0;
+            var bestStart = first;
+            Action<ulong, int> change = (gram, delta) =>
+            {
+                int frequency, count;
+                if (!frequencies.TryGetValue(gram, out frequency))
+                    return;
+                inside.TryGetValue(gram, out count);
+                if (count == 0 && delta > 0)
+                    score += frequency;
+                else if (count == 1 && delta < 0)
+                    score -= frequency;
+                inside[gram] = count + delta;
+            };
+
+            // window over grams starting at start to start + gramsPerSegment - 1
+            var gramsPerSegment = segmentLength - gramLength + 1;
+            for (var i = first; i < first + gramsPerSegment; ++i)
+                change(Gram(data, i, gramLength), 1);
+            for (var start = first; ; ++start)
+            {
+                if (score > bestScore)
+                {
+                    bestScore = score;
+                    bestStart = start;
+                }
+                if (start == last)
+                    break;
+                change(Gram(data, start, gramLength), -1);
+                change(Gram(data, start + gramsPerSegment, gramLength), 1);
+            }
+            return Tuple.Create(bestScore, bestStart);
+        }
+
+        // gramLength bytes at index packed into a key
+        static ulong Gram(byte[] data, int index, int gramLength)
+        {
+            ulong gram = 0;
+            for (var i = 0; i < gramLength; ++i)
+                gram = (gram << 8) | data[index + i];
+            return gram;
+        }
+    }
+}
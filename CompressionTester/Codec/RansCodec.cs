@@ -0,0 +1,329 @@
+﻿/*
+MIT License
+
+Copyright (c) 2016 Chris Lomont
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+
+namespace Lomont.Compression.Codec
+{
+    /// <summary>
+    /// Range asymmetric numeral system (rANS) compression. Symbol counts are scaled
+    /// to a power of two total, so decoding needs no divide, a table lookup
+    /// finds the symbol, and the coder state renormalizes a byte at a time.
+    /// Format:
+    ///   - universal header
+    ///   - scale bits S, Lomont1(4,0). Counts sum to 2^S, called slots
+    ///   - 1 bit, 0 for a dense table:  entries are symbols min to max
+    ///            1 for a sparse table: entries are the symbols present, with values
+    ///   - min symbol, Lomont1(6,0), the symbol of entry 0
+    ///   - entry count - 1, Lomont1(6,0)
+    ///   - sparse only: bits B per symbol value, Lomont1(3,0)
+    ///   - entries 1 to count-1, each (sparse only: symbol - min in B bits) then its
+    ///     first slot in S bits. Entry 0 starts at slot 0, and fixed widths let
+    ///     decoders binary search the table in place.
+    ///   - coder state, 32 bits, then the bytes read while decoding
+    /// </summary>
+    [Codec("Rans")]
+    public class RansCodec : CodecBase
+    {
+        #region Constants
+
+        // coder state is kept in [StateLow, StateLow << 8) between symbols
+        const uint StateLow = 1U << 23;
+
+        /// <summary>
+        /// Most scale bits, leaving at least 8 coder states per slot
+        /// </summary>
+        public const int MaxScaleBits = 20;
+
+        /// <summary>
+        /// Most distinct symbols, since each needs a slot
+        /// </summary>
+        public const uint MaxSymbols = 1U << MaxScaleBits;
+
+        #endregion
+
+        #region Settings
+
+        /// <summary>
+        /// Most scale bits tried. Larger codes closer to the symbol counts, but the
+        /// table costs more, and table decoding needs 2^scale entries. The scale
+        /// giving the smallest output is used, and is larger if needed to give
+        /// each symbol a slot.
+        /// </summary>
+        [CodecParameter("Scale bits", "scale", "Most probability scale bits 1-20, table decoders use 2^scale entries")]
+        public uint ScaleBits { get; set; } = 12;
+
+        #endregion
+
+        #region Compression functions
+
+        /// <summary>
+        /// Write the header for the compression algorithm
+        /// </summary>
+        /// <param name="bitstream"></param>
+        /// <param name="data"></param>
+        /// <param name="headerFlags">Flags telling what to put in the header. Useful when embedding in other streams.</param>
+        /// <returns></returns>
+        public override void WriteHeader(Bitstream bitstream, Datastream data, Header.HeaderFlags headerFlags)
+        {
+            Header.WriteUniversalHeader(bitstream, data, headerFlags);
+
+            var counts = new uint[data.Any() ? data.Max() + 1 : 1];
+            foreach (var symbol in data)
+                counts[symbol]++;
+            if (!data.Any())
+                counts[0] = 1; // empty table still needs one entry
+
+            ChooseScale(counts);
+
+            // table
+            UniversalCodec.Lomont.EncodeLomont1(bitstream, scaleBits, 4, 0);
+            bitstream.Write(sparse ? 1U : 0U, 1);
+            UniversalCodec.Lomont.EncodeLomont1(bitstream, entrySymbols[0], 6, 0);
+            UniversalCodec.Lomont.EncodeLomont1(bitstream, (uint)entrySymbols.Length - 1, 6, 0);
+            if (sparse)
+                UniversalCodec.Lomont.EncodeLomont1(bitstream, symbolBits, 3, 0);
+            for (var i = 1; i < entrySymbols.Length; ++i)
+            {
+                if (sparse)
+                    bitstream.Write(entrySymbols[i] - entrySymbols[0], symbolBits);
+                bitstream.Write(entrySlots[i], scaleBits);
+            }
+
+            // encoder slots by symbol
+            symbolFrequencies = new uint[counts.Length];
+            symbolSlots = new uint[counts.Length];
+            for (var i = 0; i < entrySymbols.Length; ++i)
+            {
+                symbolSlots[entrySymbols[i]] = entrySlots[i];
+                symbolFrequencies[entrySymbols[i]] = entrySlots[i + 1] - entrySlots[i];
+            }
+
+            symbols.Clear();
+        }
+
+        /// <summary>
+        /// Compress a symbol in the compression algorithm
+        /// </summary>
+        /// <param name="bitstream"></param>
+        /// <param name="symbol"></param>
+        public override void CompressSymbol(Bitstream bitstream, uint symbol)
+        {
+            // rANS encodes last symbol first, so save them for the footer
+            symbols.Add(symbol);
+        }
+
+        /// <summary>
+        /// Finish the stream
+        /// </summary>
+        /// <param name="bitstream"></param>
+        public override void WriteFooter(Bitstream bitstream)
+        {
+            // encode in reverse, so the decoder reads forwards
+            uint state = StateLow;
+            var bytes = new List<byte>();
+            for (var i = symbols.Count - 1; i >= 0; --i)
+            {
+                var symbol = symbols[i];
+                var frequency = symbolFrequencies[symbol];
+                var stateMax = ((StateLow >> (int)scaleBits) << 8) * frequency;
+                while (state >= stateMax)
+                {
+                    bytes.Add((byte)state);
+                    state >>= 8;
+                }
+                state = ((state / frequency) << (int)scaleBits) + state % frequency + symbolSlots[symbol];
+            }
+
+            bitstream.Write(state, 32);
+            for (var i = bytes.Count - 1; i >= 0; --i)
+                bitstream.Write(bytes[i], 8);
+            symbols.Clear();
+        }
+
+        #endregion
+
+        #region Decompression functions
+
+        /// <summary>
+        /// Read the header for the compression algorithm
+        /// Return number of symbols in stream if known, else 0 if not present
+        /// </summary>
+        /// <param name="bitstream"></param>
+        /// <param name="headerFlags">Flags telling what to put in the header. Useful when embedding in other streams.</param>
+        /// <returns></returns>
+        public override uint ReadHeader(Bitstream bitstream, Header.HeaderFlags headerFlags)
+        {
+            var header = Header.ReadUniversalHeader(bitstream, headerFlags);
+
+            scaleBits = UniversalCodec.Lomont.DecodeLomont1(bitstream, 4, 0);
+            sparse = bitstream.Read(1) != 0;
+            var symbolMin = UniversalCodec.Lomont.DecodeLomont1(bitstream, 6, 0);
+            var entryCount = UniversalCodec.Lomont.DecodeLomont1(bitstream, 6, 0) + 1;
+            symbolBits = sparse ? UniversalCodec.Lomont.DecodeLomont1(bitstream, 3, 0) : 0;
+
+            entrySymbols = new uint[entryCount];
+            entrySlots = new uint[entryCount + 1];
+            entrySymbols[0] = symbolMin;
+            for (var i = 1; i < entryCount; ++i)
+            {
+                entrySymbols[i] = symbolMin + (sparse ? bitstream.Read(symbolBits) : (uint)i);
+                entrySlots[i] = bitstream.Read(scaleBits);
+            }
+            entrySlots[entryCount] = 1U << (int)scaleBits;
+
+            // map each slot to its entry
+            slotEntries = new uint[1 << (int)scaleBits];
+            for (var i = 0U; i < entryCount; ++i)
+                for (var slot = entrySlots[i]; slot < entrySlots[i + 1]; ++slot)
+                    slotEntries[slot] = i;
+
+            decoderState = bitstream.Read(32);
+            return header.Item1;
+        }
+
+        /// <summary>
+        /// Decompress a symbol in the compression algorithm
+        /// </summary>
+        /// <param name="bitstream"></param>
+        public override uint DecompressSymbol(Bitstream bitstream)
+        {
+            var slot = decoderState & ((1U << (int)scaleBits) - 1);
+            var entry = slotEntries[slot];
+            var frequency = entrySlots[entry + 1] - entrySlots[entry];
+            decoderState = frequency * (decoderState >> (int)scaleBits) + slot - entrySlots[entry];
+            while (decoderState < StateLow)
+                decoderState = (decoderState << 8) | bitstream.Read(8);
+            return entrySymbols[entry];
+        }
+
+        #endregion
+
+        #region Implementation
+
+        // table, entry i is symbol entrySymbols[i] with slots entrySlots[i] to entrySlots[i+1]-1
+        uint[] entrySymbols;
+        uint[] entrySlots;
+        uint scaleBits;
+        bool sparse;
+        uint symbolBits; // sparse table symbol value bits
+
+        // encoder state
+        readonly List<uint> symbols = new List<uint>();
+        uint[] symbolFrequencies;
+        uint[] symbolSlots;
+
+        // decoder state
+        uint[] slotEntries;
+        uint decoderState;
+
+        // Pick the scale and table layout giving the smallest output, fill in the table
+        void ChooseScale(uint[] counts)
+        {
+            var present = new List<uint>();
+            ulong total = 0;
+            for (var i = 0U; i < counts.Length; ++i)
+                if (counts[i] != 0)
+                {
+                    present.Add(i);
+                    total += counts[i];
+                }
+            if (present.Count > MaxSymbols)
+                throw new ArgumentException($"rANS supports at most {MaxSymbols} distinct symbols");
+
+            // dense tables store an S bit slot per symbol after min, sparse 
+            // tables also store symbol values, but only for those present
+            var min = present.First();
+            var denseEntries = (ulong)(present.Last() - min);
+            var sparseEntries = (ulong)(present.Count - 1);
+            var sparseSymbolBits = BitsRequired(present.Last() - min);
+
+            var minScale = BitsRequired((uint)present.Count - 1);
+            if (present.Count == 1)
+                minScale = 0;
+            var maxScale = Math.Max(minScale, Math.Min(Math.Max(ScaleBits, 1), (uint)MaxScaleBits));
+            var bestCost = Double.MaxValue;
+            for (var scale = minScale; scale <= maxScale; ++scale)
+            {
+                var frequencies = NormalizeCounts(counts, present, total, (int)scale);
+
+                // coded bits are counts[i] * log2(2^scale / frequency)
+                var cost = 0.0;
+                foreach (var symbol in present)
+                    cost += counts[symbol] * (scale - Math.Log(frequencies[symbol], 2));
+                var denseCost = denseEntries * scale;
+                var sparseCost = sparseEntries * (sparseSymbolBits + scale) + 4;
+                var useSparse = sparseCost < denseCost;
+                cost += Math.Min(denseCost, sparseCost);
+                if (cost >= bestCost)
+                    continue;
+                bestCost = cost;
+                scaleBits = scale;
+                sparse = useSparse;
+                symbolBits = useSparse ? sparseSymbolBits : 0;
+
+                // entries are present symbols, or all from min to max
+                var entries = useSparse
+                    ? present
+                    : Enumerable.Range((int)min, (int)(present.Last() - min + 1)).Select(s => (uint)s).ToList();
+                entrySymbols = entries.ToArray();
+                entrySlots = new uint[entrySymbols.Length + 1];
+                for (var i = 0; i < entrySymbols.Length; ++i)
+                    entrySlots[i + 1] = entrySlots[i] + frequencies[entrySymbols[i]];
+            }
+        }
+
+        // Scale counts to sum to 2^scaleBits, keeping each present symbol at least 1.
+        // Requires present.Count <= 2^scaleBits
+        static uint[] NormalizeCounts(uint[] counts, List<uint> present, ulong total, int scaleBits)
+        {
+            var target = 1UL << scaleBits;
+            var frequencies = new uint[counts.Length];
+            ulong sum = 0;
+            foreach (var symbol in present)
+            {
+                frequencies[symbol] = (uint)Math.Max(1UL, counts[symbol] * target / total);
+                sum += frequencies[symbol];
+            }
+
+            // hand out slots lost rounding down, largest remainders first
+            var byRemainder = present.OrderByDescending(s => counts[s] * target % total).ToList();
+            for (var i = 0; sum < target; i = (i + 1) % byRemainder.Count, ++sum)
+                frequencies[byRemainder[i]]++;
+
+            // take back slots added raising small counts to 1, largest first
+            var byFrequency = present.OrderByDescending(s => frequencies[s]).ToList();
+            for (var i = 0; sum > target; i = (i + 1) % byFrequency.Count)
+                if (frequencies[byFrequency[i]] > 1)
+                {
+                    frequencies[byFrequency[i]]--;
+                    --sum;
+                }
+            return frequencies;
+        }
+
+        #endregion
+    }
+}
@@ -34,22 +34,29 @@ namespace Lomont.Compression.Codec
     public static class StatRecorder
     {
         private static readonly Dictionary<string,ulong> Log = new Dictionary<string, ulong>();
-        public static void AddStat(string name, uint value)
+        // codecs may run on several threads at once
+        public static void AddStat(string name, ulong value)
         {
-            if (!Log.ContainsKey(name))
-                Log.Add(name,0);
-            Log[name] += value;
+            lock (Log)
+            {
+                if (!Log.ContainsKey(name))
+                    Log.Add(name, 0);
+                Log[name] += value;
+            }
         }
 
         public static void DumpLog(TextWriter output)
         {
-            if (Log.Count == 0 || output == null) return;
-            var maxNameLength = Log.Keys.Max(n => n.Length);
-            var maxVal = Log.Values.Max();
-            var maxValLength = (uint) Math.Ceiling(Math.Log10(maxVal + 1));
-            var format = "{0,-"+(maxNameLength+1) + "} => {1,"+(maxValLength)+"}";
-            foreach (var item in Log.OrderBy(d=>d.Key))
-                output.WriteLine(format,item.Key,item.Value);
+            lock (Log)
+            {
+                if (Log.Count == 0 || output == null) return;
+                var maxNameLength = Log.Keys.Max(n => n.Length);
+                var maxVal = Log.Values.Max();
+                var maxValLength = (uint) Math.Ceiling(Math.Log10(maxVal + 1));
+                var format = "{0,-"+(maxNameLength+1) + "} => {1,"+(maxValLength)+"}";
+                foreach (var item in Log.OrderBy(d=>d.Key))
+                    output.WriteLine(format,item.Key,item.Value);
+            }
         }
     }
 }
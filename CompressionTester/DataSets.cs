@@ -21,6 +21,9 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
+using System;
+using System.Collections.Generic;
+
 namespace Lomont.Compression
 {
     public static class DataSets
@@ -222,6 +225,24 @@ namespace Lomont.Compression
             255,0 // end of list
         };
 
+        /// <summary>
+        /// Generated data reaching cases the corpus does not, as (name, data) pairs
+        /// </summary>
+        public static List<Tuple<string, byte[]>> Generated => new List<Tuple<string, byte[]>>
+        {
+            // one long run, so the shortest match is hundreds of bytes
+            new Tuple<string, byte[]>("long runs", new byte[5000]),
+            // incompressible, so a parse may find no matches
+            new Tuple<string, byte[]>("random", RandomBytes(3000, 1234))
+        };
+
+        // length bytes from a fixed seed, the same each run
+        static byte[] RandomBytes(int length, int seed)
+        {
+            var data = new byte[length];
+            new Random(seed).NextBytes(data);
+            return data;
+        }
 
     }
 }
@@ -0,0 +1,159 @@
+﻿/*
+MIT License
+
+Copyright (c) 2016 Chris Lomont
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.IO;
+using System.IO.MemoryMappedFiles;
+using Lomont.Compression.Codec;
+
+namespace Lomont.Compression
+{
+    /// <summary>
+    /// Decompress a file with the C decoder in ReferenceDecoder.dll, which reads 
+    /// the memory mapped input and writes the memory mapped output directly, 
+    /// so large files are never copied into managed arrays.
+    /// </summary>
+    public static class MappedDecompressor
+    {
+        /// <summary>
+        /// Decompress inputFile to outputFile, return the bytes written.
+        /// A block container is decoded on all cores.
+        /// </summary>
+        /// <param name="codec">Codec that compressed the file, or of the blocks for a container</param>
+        /// <param name="inputFile"></param>
+        /// <param name="outputFile"></param>
+        /// <param name="isContainer">Input is a block container</param>
+        /// <returns></returns>
+        public static long DecompressFile(CodecBase codec, string inputFile, string outputFile, bool isContainer)
+        {
+            var sourceLength = new FileInfo(inputFile).Length;
+            if (sourceLength == 0 || sourceLength > Int32.MaxValue)
+                throw new ArgumentException($"File {inputFile} size {sourceLength} not supported");
+
+            using (var input = MemoryMappedFile.CreateFromFile(inputFile, FileMode.Open, null, 0, MemoryMappedFileAccess.Read))
+            using (var inputView = input.CreateViewAccessor(0, 0, MemoryMappedFileAccess.Read))
+            using (var source = new MappedPointer(inputView))
+            {
+                var destLength = IsInterleaved(codec) && !isContainer
+                    ? NativeMethods.GetInterleavedDecompressedSize(source.Pointer)
+                    : NativeMethods.GetDecompressedSize(source.Pointer);
+                if (destLength > Int32.MaxValue)
+                    throw new ArgumentException($"File {inputFile} decompressed size {destLength} not supported");
+                if (destLength == 0 && !isContainer && (codec is HuffmanCodec || codec is ArithmeticCodec))
+                {
+                    // C decoders return nothing for the other format, so say why
+                    if (IsInterleaved(codec) && NativeMethods.GetDecompressedSize(source.Pointer) != 0)
+                        throw new ArgumentException($"File {inputFile} is not interleaved, decompress with streams=1");
+                    if (!IsInterleaved(codec) && NativeMethods.GetInterleavedDecompressedSize(source.Pointer) != 0)
+                        throw new ArgumentException($"File {inputFile} is interleaved, decompress with streams=2 to 4");
+                }
+                if (destLength == 0)
+                {
+                    File.WriteAllBytes(outputFile, new byte[0]);
+                    return 0;
+                }
+
+                int written;
+                using (var output = MemoryMappedFile.CreateFromFile(outputFile, FileMode.Create, null, destLength, MemoryMappedFileAccess.ReadWrite))
+                using (var outputView = output.CreateViewAccessor(0, destLength, MemoryMappedFileAccess.ReadWrite))
+                using (var dest = new MappedPointer(outputView))
+                    written = Decompress(codec, isContainer, source.Pointer, (int)sourceLength, dest.Pointer, (int)destLength);
+
+                if (written != destLength)
+                    throw new InvalidDataException($"File {inputFile} decoded {written} of {destLength} bytes");
+                return written;
+            }
+        }
+
+        // interleaved streams start with a mark before the size
+        static bool IsInterleaved(CodecBase codec)
+        {
+            return ((codec as HuffmanCodec)?.Streams ?? (codec as ArithmeticCodec)?.Streams ?? 1) > 1;
+        }
+
+        static int Decompress(CodecBase codec, bool isContainer, IntPtr source, int sourceLength, IntPtr dest, int destLength)
+        {
+            if (isContainer)
+                return NativeMethods.DecompressParallel(source, sourceLength, dest, destLength, 0);
+            var huffman = codec as HuffmanCodec;
+            if (huffman != null && huffman.Streams > 1)
+            {
+                var table = new uint[4096];
+                return NativeMethods.DecompressHuffmanInterleaved(source, sourceLength, dest, destLength, table, (uint)table.Length);
+            }
+            if (huffman != null)
+                return NativeMethods.DecompressHuffman(source, sourceLength, dest, destLength);
+            var arithmetic = codec as ArithmeticCodec;
+            if (arithmetic != null && arithmetic.Streams > 1)
+            {
+                var table = new uint[257]; // cumulative counts of byte symbols
+                return NativeMethods.DecompressArithmeticInterleaved(source, sourceLength, dest, destLength, table, (uint)table.Length);
+            }
+            if (arithmetic != null)
+                return NativeMethods.DecompressArithmetic(source, sourceLength, dest, destLength);
+            var lz77 = codec as Lz77Codec;
+            if (lz77?.Dictionary != null)
+                return NativeMethods.DecompressLZ77Dictionary(source, sourceLength, dest, destLength, lz77.Dictionary, lz77.Dictionary.Length);
+            if (lz77 != null)
+                return NativeMethods.DecompressLZ77(source, sourceLength, dest, destLength);
+            var lzcl = codec as LzclCodec;
+            if (lzcl?.Dictionary != null)
+                return NativeMethods.DecompressLZCLDictionary(source, sourceLength, dest, destLength, lzcl.Dictionary, lzcl.Dictionary.Length);
+            if (lzcl != null)
+                return NativeMethods.DecompressLZCL(source, sourceLength, dest, destLength);
+            if (codec is RansCodec)
+            {
+                // symbols, their slots, and a slot map for up to 2^scale slots
+                var scaleBits = Math.Min(((RansCodec)codec).ScaleBits, RansCodec.MaxScaleBits);
+                var table = new uint[2 * 256 + 1 + (1U << (int)scaleBits)];
+                return NativeMethods.DecompressRansFast(source, sourceLength, dest, destLength, table, (uint)table.Length);
+            }
+            throw new ArgumentException($"No C decoder for codec {codec.GetType().Name}");
+        }
+
+        /// <summary>
+        /// Address of a mapped view, held so the view is not unmapped while in use
+        /// </summary>
+        sealed class MappedPointer : IDisposable
+        {
+            public MappedPointer(MemoryMappedViewAccessor view)
+            {
+                handle = view.SafeMemoryMappedViewHandle;
+                handle.DangerousAddRef(ref added);
+                Pointer = IntPtr.Add(handle.DangerousGetHandle(), (int)view.PointerOffset);
+            }
+
+            public IntPtr Pointer { get; }
+
+            public void Dispose()
+            {
+                if (added)
+                    handle.DangerousRelease();
+                added = false;
+            }
+
+            readonly System.Runtime.InteropServices.SafeHandle handle;
+            bool added;
+        }
+    }
+}
@@ -21,10 +21,35 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
+using System;
 using System.Runtime.InteropServices;
 
 namespace Lomont.Compression
 {
+    /// <summary>
+    /// Decoder work counted by a ReferenceDecoder built with DECOMPRESSOR_STATS,
+    /// laid out as DecompressorStats_t
+    /// </summary>
+    [StructLayout(LayoutKind.Sequential)]
+    internal struct DecompressorStats
+    {
+        public ulong BitsRead;
+        public ulong Literals;
+        public ulong Matches;
+        public ulong MatchBytes;
+        // bucket k counts values 2^k to 2^(k+1)-1, and 0 in bucket 0
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 32)]
+        public ulong[] MatchLengths;
+        [MarshalAs(UnmanagedType.ByValArray, SizeConst = 32)]
+        public ulong[] MatchDistances;
+        public ulong HuffmanTableHits;
+        public ulong HuffmanRows;
+        public ulong ArithmeticRenormalizations;
+        public ulong ArithmeticLookupSteps;
+        public ulong RansRenormalizations;
+        public ulong RansLookupSteps;
+    }
+
     internal static class NativeMethods
     {
         // decompress, return bytes decoded
@@ -43,5 +68,79 @@ namespace Lomont.Compression
         [DllImport("ReferenceDecoder.dll")]
         public static extern int DecompressLZCL(byte[] source, int sourceLength, byte[] dest, int destLength);
 
+        // decompress, return bytes decoded
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern int DecompressRans(byte[] source, int sourceLength, byte[] dest, int destLength);
+
+        // decompress data compressed with a preset dictionary, return bytes decoded
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern int DecompressLZ77Dictionary(byte[] source, int sourceLength, byte[] dest, int destLength, byte[] dictionary, int dictionaryLength);
+
+        // decompress data compressed with a preset dictionary, return bytes decoded
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern int DecompressLZCLDictionary(byte[] source, int sourceLength, byte[] dest, int destLength, byte[] dictionary, int dictionaryLength);
+
+        // decompress a block container on threadCount threads, 0 for one per core, return bytes decoded
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern int DecompressParallel(byte[] source, int sourceLength, byte[] dest, int destLength, int threadCount);
+
+        // copy the decoder counts, return 1 if built with DECOMPRESSOR_STATS, else 0 and stats zeroed
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern uint DecompressGetStats(out DecompressorStats stats);
+
+        // zero the decoder counts
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern void DecompressResetStats();
+
+        // Overloads on unmanaged memory, such as memory mapped views, so nothing is copied or pinned
+
+        // bytes the stream decompresses to, read from its header. Also works for block containers.
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern uint GetDecompressedSize(IntPtr source);
+
+        // bytes an interleaved Huffman or Arithmetic stream decompresses to, 0 if not interleaved
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern uint GetInterleavedDecompressedSize(IntPtr source);
+
+        // decompress, return bytes decoded
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern int DecompressHuffman(IntPtr source, int sourceLength, IntPtr dest, int destLength);
+
+        // decompress, return bytes decoded
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern int DecompressLZ77(IntPtr source, int sourceLength, IntPtr dest, int destLength);
+
+        // decompress, return bytes decoded
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern int DecompressArithmetic(IntPtr source, int sourceLength, IntPtr dest, int destLength);
+
+        // decompress, return bytes decoded
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern int DecompressLZCL(IntPtr source, int sourceLength, IntPtr dest, int destLength);
+
+        // decompress data compressed with a preset dictionary, return bytes decoded
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern int DecompressLZ77Dictionary(IntPtr source, int sourceLength, IntPtr dest, int destLength, byte[] dictionary, int dictionaryLength);
+
+        // decompress data compressed with a preset dictionary, return bytes decoded
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern int DecompressLZCLDictionary(IntPtr source, int sourceLength, IntPtr dest, int destLength, byte[] dictionary, int dictionaryLength);
+
+        // decompress, using table to speed decoding, return bytes decoded
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern int DecompressRansFast(IntPtr source, int sourceLength, IntPtr dest, int destLength, uint[] table, uint tableLength);
+
+        // decompress a block container on threadCount threads, 0 for one per core, return bytes decoded
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern int DecompressParallel(IntPtr source, int sourceLength, IntPtr dest, int destLength, int threadCount);
+
+        // decompress data compressed with streams=2-4, using table to speed decoding, return bytes decoded
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern int DecompressHuffmanInterleaved(IntPtr source, int sourceLength, IntPtr dest, int destLength, uint[] table, uint tableLength);
+
+        // decompress data compressed with streams=2-4, using table to speed decoding, return bytes decoded
+        [DllImport("ReferenceDecoder.dll")]
+        public static extern int DecompressArithmeticInterleaved(IntPtr source, int sourceLength, IntPtr dest, int destLength, uint[] table, uint tableLength);
+
     }
 }
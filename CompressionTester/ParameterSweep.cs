@@ -0,0 +1,197 @@
+﻿/*
+MIT License
+
+Copyright (c) 2016 Chris Lomont
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Linq;
+using System.Reflection;
+using System.Threading.Tasks;
+using Lomont.Compression.Codec;
+
+namespace Lomont.Compression
+{
+    /// <summary>
+    /// Try a codec on one input over a grid of parameter values, on all cores, 
+    /// and find the settings giving the smallest output for each decoder buffer size.
+    /// Large inputs are first compressed in a prefix sample, and settings clearly
+    /// worse than one needing no more buffer are dropped before the full run.
+    /// </summary>
+    public class ParameterSweep : Output
+    {
+        /// <summary>
+        /// Results of one setting of the parameters
+        /// </summary>
+        public class Result
+        {
+            /// <summary>
+            /// Parameter values, in grid order
+            /// </summary>
+            public uint[] Values { get; set; }
+            /// <summary>
+            /// Decoder ring buffer size for LZ77 and LZCL, max(maxDist,maxLen)+1, else 0
+            /// </summary>
+            public uint BufferSize { get; set; }
+            /// <summary>
+            /// Compressed size of the sample, or of the whole input if not sampled
+            /// </summary>
+            public int SampleSize { get; set; }
+            /// <summary>
+            /// Compressed size, or -1 if dropped after the sample
+            /// </summary>
+            public int CompressedSize { get; set; } = -1;
+        }
+
+        /// <summary>
+        /// Inputs at least this large are sampled first
+        /// </summary>
+        public int SampleThreshold { get; set; } = 1 << 16;
+
+        /// <summary>
+        /// Settings whose sample is more than this fraction larger than the best
+        /// sample with the same or smaller buffer are dropped
+        /// </summary>
+        public double PruneTolerance { get; set; } = 0.05;
+
+        /// <summary>
+        /// Parse a sweep range as in the -c option: a single value, or min,max,step
+        /// where step is +n to add n or *n to multiply by n each time
+        /// </summary>
+        /// <param name="text"></param>
+        /// <param name="values"></param>
+        /// <returns>true on success</returns>
+        public static bool ParseRange(string text, out List<uint> values)
+        {
+            values = new List<uint>();
+            var words = text.Split(',');
+            uint first, last, step;
+            if (words.Length == 1 && UInt32.TryParse(words[0], out first))
+            {
+                values.Add(first);
+                return true;
+            }
+            if (words.Length != 3 || words[2].Length < 2 ||
+                !UInt32.TryParse(words[0], out first) ||
+                !UInt32.TryParse(words[1], out last) ||
+                !UInt32.TryParse(words[2].Substring(1), out step))
+                return false;
+            var multiply = words[2][0] == '*';
+            if ((!multiply && words[2][0] != '+') || (multiply ? step < 2 || first == 0 : step == 0))
+                return false;
+            for (ulong value = first; value <= last; value = multiply ? value * step : value + step)
+                values.Add((uint)value);
+            return values.Any();
+        }
+
+        /// <summary>
+        /// Compress data with every combination of parameter values.
+        /// </summary>
+        /// <param name="codecType">Codec class, made once per setting so runs are independent</param>
+        /// <param name="parameters">Codec properties to set</param>
+        /// <param name="grid">Values to try for each property</param>
+        /// <param name="data"></param>
+        /// <returns>One result per setting</returns>
+        public List<Result> Run(Type codecType, IList<PropertyInfo> parameters, IList<List<uint>> grid, byte[] data)
+        {
+            // all combinations of values
+            var results = new List<Result>();
+            var counts = new int[grid.Count];
+            while (true)
+            {
+                var result = new Result { Values = grid.Select((g, i) => g[counts[i]]).ToArray() };
+                results.Add(result);
+                var digit = 0;
+                while (digit < counts.Length && ++counts[digit] == grid[digit].Count)
+                    counts[digit++] = 0;
+                if (digit == counts.Length)
+                    break;
+            }
+
+            var sampled = data.Length >= SampleThreshold;
+            var sample = sampled ? data.Take(Math.Max(SampleThreshold / 4, data.Length / 8)).ToArray() : data;
+            Compress(codecType, parameters, results, sample, (r, size) => r.SampleSize = size);
+            if (!sampled)
+            {
+                foreach (var r in results)
+                    r.CompressedSize = r.SampleSize;
+                return results;
+            }
+
+            // keep settings near the best sample for their buffer size or less
+            var kept = new List<Result>();
+            var bestSoFar = Int32.MaxValue;
+            foreach (var group in results.GroupBy(r => r.BufferSize).OrderBy(g => g.Key))
+            {
+                bestSoFar = Math.Min(bestSoFar, group.Min(r => r.SampleSize));
+                kept.AddRange(group.Where(r => r.SampleSize <= bestSoFar * (1 + PruneTolerance)));
+            }
+            WriteLine($"Sample of {sample.Length} bytes kept {kept.Count} of {results.Count} settings");
+            Compress(codecType, parameters, kept, data, (r, size) => r.CompressedSize = size);
+            return results;
+        }
+
+        /// <summary>
+        /// Settings on the Pareto front of compressed size versus buffer size:
+        /// smaller than every setting using the same or less buffer
+        /// </summary>
+        /// <param name="results"></param>
+        /// <returns>Front in order of increasing buffer size</returns>
+        public static List<Result> ParetoFront(IEnumerable<Result> results)
+        {
+            var front = new List<Result>();
+            foreach (var r in results.Where(r => r.CompressedSize >= 0).OrderBy(r => r.BufferSize).ThenBy(r => r.CompressedSize))
+                if (!front.Any() || r.CompressedSize < front.Last().CompressedSize)
+                    front.Add(r);
+            return front;
+        }
+
+        void Compress(Type codecType, IList<PropertyInfo> parameters, List<Result> results, byte[] data, Action<Result, int> store)
+        {
+            // one match index per hash length, shared by all settings
+            var data32 = new Datastream(data);
+            var indices = new ConcurrentDictionary<int, Lazy<MatchIndex>>();
+            Func<uint, MatchIndex> getIndex = minLength =>
+                indices.GetOrAdd((int)Math.Max(1, Math.Min(minLength, 3)), h => new Lazy<MatchIndex>(() => new MatchIndex(data32, (uint)h))).Value;
+
+            Parallel.ForEach(results, result =>
+            {
+                var codec = (CodecBase)Activator.CreateInstance(codecType);
+                for (var i = 0; i < parameters.Count; ++i)
+                    parameters[i].SetValue(codec, result.Values[i]);
+                var lz77 = codec as Lz77Codec;
+                var lzcl = codec as LzclCodec;
+                if (lz77 != null)
+                {
+                    lz77.SharedMatchIndex = getIndex(lz77.MinimumLength);
+                    result.BufferSize = Math.Max(lz77.MaximumDistance, lz77.MaximumLength) + 1;
+                }
+                if (lzcl != null)
+                {
+                    lzcl.SharedMatchIndex = getIndex(lzcl.MinimumLength);
+                    result.BufferSize = Math.Max(lzcl.MaximumDistance, lzcl.MaximumLength) + 1;
+                }
+                store(result, codec.Compress(data).Length);
+            });
+        }
+    }
+}
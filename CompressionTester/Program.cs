@@ -24,6 +24,7 @@ SOFTWARE.
 using System;
 using System.Collections.Generic;
 using System.Data;
+using System.Diagnostics;
 using System.IO;
 using System.Linq;
 using System.Reflection;
@@ -61,6 +62,13 @@ namespace Lomont.Compression
             public bool Verbose { get; set; }
             public bool Decompress { get; set; }
             public bool Testing { get; set; }
+            public uint BlockSize { get; set; }
+            public bool Sweep { get; set; }
+            public string CacheFile { get; set; }
+            public bool MemoryMap { get; set; }
+            public bool SpecializeHeader { get; set; }
+            public string DictionaryFile { get; set; }
+            public uint TrainSize { get; set; }
         }
 
         static void ShowParameters()
@@ -97,12 +105,19 @@ namespace Lomont.Compression
             Console.WriteLine($" -f output formats : {writeArray(OutputFormats)}");
             Console.WriteLine($" -c codecs         : {writeArray(CodecNames)}");
             ShowParameters();
-            // todo - allow parameters like LZ77:minLen=a,b,c:maxLen=a,b,c...
-            // where a,b,c is min, max, increment step as +1 or *2 or such
             Console.WriteLine(" -v verbose");
             //Console.WriteLine($" // -b best(optimize) ");
             Console.WriteLine(" -t test - run current test set");
             Console.WriteLine(" -d decompress, else compress");
+            Console.WriteLine(" -b blocksize - seekable container of independently compressed blocks");
+            Console.WriteLine(" -s sweep - compress inputfile over a grid of codec parameters on all cores,");
+            Console.WriteLine("    given as -c Lzcl:maxDist=16,4096,*2:maxLen=8,256,*2:minLen=2,4,+1");
+            Console.WriteLine(" -m with -d, decompress with the C decoder on memory mapped files, Binary only");
+            Console.WriteLine("    with -i path, test with the C decoder, logging its work if built with DECOMPRESSOR_STATS");
+            Console.WriteLine(" -p with -f C, also write outputfile_defines.h to build a decoder specialized for it");
+            Console.WriteLine(" -k cachefile - keep test results (-t, or -i path) between runs, only retesting changes");
+            Console.WriteLine(" -dict file - Lz77 and Lzcl preset dictionary, the same one is needed to decompress");
+            Console.WriteLine(" -train size - build a dictionary of at most size bytes from the files in -i, to -o");
         }
 
         private static readonly string[] OutputFormats = {"C#", "C", "Binary"};
@@ -168,6 +183,35 @@ namespace Lomont.Compression
                     case "-t":
                         opts.Testing = true;
                         break;
+                    case "-s":
+                        opts.Sweep = true;
+                        break;
+                    case "-b":
+                        uint blockSize;
+                        if (UInt32.TryParse(args[i++], out blockSize) && blockSize > 0)
+                            opts.BlockSize = blockSize;
+                        else
+                            Console.Error.WriteLine($"Invalid block size {args[i - 1]}");
+                        break;
+                    case "-k":
+                        opts.CacheFile = args[i++];
+                        break;
+                    case "-m":
+                        opts.MemoryMap = true;
+                        break;
+                    case "-p":
+                        opts.SpecializeHeader = true;
+                        break;
+                    case "-dict":
+                        opts.DictionaryFile = args[i++];
+                        break;
+                    case "-train":
+                        uint trainSize;
+                        if (UInt32.TryParse(args[i++], out trainSize) && trainSize > 0)
+                            opts.TrainSize = trainSize;
+                        else
+                            Console.Error.WriteLine($"Invalid dictionary size {args[i - 1]}");
+                        break;
                 }
             }
             if (opts.OutputFormatIndex == -1)
@@ -199,9 +243,28 @@ namespace Lomont.Compression
         {
             if (opts.Testing)
             {
-                DoTesting();
+                DoTesting(opts.CacheFile);
                 return 1;
             }
+            if (opts.Sweep)
+                return DoSweep(opts);
+            if (opts.TrainSize > 0)
+                return DoTrain(opts);
+            byte[] dictionary = null;
+            if (!String.IsNullOrEmpty(opts.DictionaryFile))
+            {
+                if (!File.Exists(opts.DictionaryFile))
+                {
+                    Console.Error.WriteLine($"Dictionary {opts.DictionaryFile} does not exist");
+                    return -3;
+                }
+                if (opts.BlockSize > 0)
+                {
+                    Console.Error.WriteLine("Block containers do not support a dictionary");
+                    return -2;
+                }
+                dictionary = File.ReadAllBytes(opts.DictionaryFile);
+            }
             // create list of codecs
             var codecs = new List<CodecBase>();
             for (var i = 0;  i < opts.CodecIndices.Count; ++i)
@@ -217,10 +280,13 @@ namespace Lomont.Compression
                         codec = new HuffmanCodec();
                         break;
                     case "Lz77":
-                        codec = new Lz77Codec();
+                        codec = new Lz77Codec {Dictionary = dictionary};
                         break;
                     case "Lzcl":
-                        codec = new LzclCodec();
+                        codec = new LzclCodec {Dictionary = dictionary};
+                        break;
+                    case "Rans":
+                        codec = new RansCodec();
                         break;
                     default:
                         Console.Error.WriteLine($"Unknown codec {CodecNames[ci]}");
@@ -235,6 +301,11 @@ namespace Lomont.Compression
                 Console.Error.WriteLine("No codec(s) specified");
                 return -2;
             }
+            if (opts.BlockSize > 0 && BlockContainer.CodecType(codecs[0]) < 0)
+            {
+                Console.Error.WriteLine($"Codec {CodecNames[opts.CodecIndices[0]]} cannot be stored in a block container, use Huffman or Arithmetic with streams=1, Lz77, or Lzcl");
+                return -2;
+            }
             if (opts.Verbose)
             {
                 foreach (var c in codecs)
@@ -254,22 +325,48 @@ namespace Lomont.Compression
                     Environment.Exit(-3);
                 }
                 // do first codec only
+                if (opts.MemoryMap && opts.Decompress)
+                {
+                    // C decoder works on the files directly, no managed copies
+                    var length = MappedDecompressor.DecompressFile(codecs[0], opts.Inputfile, opts.Outputfile, opts.BlockSize > 0);
+                    Console.WriteLine(
+                        $"{Path.GetFileName(opts.Inputfile)} ({new FileInfo(opts.Inputfile).Length} bytes) decompressed to {opts.Outputfile} ({length} bytes).");
+                    return 1;
+                }
                 var data = File.ReadAllBytes(opts.Inputfile);
-                var output = opts.Decompress ? codecs[0].Decompress(data) : codecs[0].Compress(data);
+                byte[] output;
+                if (opts.BlockSize > 0)
+                    output = opts.Decompress
+                        ? BlockContainer.Decompress(codecs[0], data)
+                        : BlockContainer.Compress(codecs[0], data, opts.BlockSize);
+                else
+                    output = opts.Decompress ? codecs[0].Decompress(data) : codecs[0].Compress(data);
                 var headerMsg = $"File {opts.Inputfile} compressed from {data.Length} to {output.Length} for {(double)output.Length/data.Length:F3} ratio";
                 if (codecs[0] is Lz77Codec)
                 {
                     var lz77 = codecs[0] as Lz77Codec;
                     var bufSize = Math.Max(lz77.MaximumDistance,lz77.MaximumLength)+1;
                     headerMsg += $" LZ77 bufsize {bufSize}";
+                    if (lz77.PowerOfTwoTokens != 0)
+                        headerMsg += $" pow2 tokens cost {lz77.PowerOfTwoTokenCost} bits";
                 }
                 if (codecs[0] is LzclCodec)
                 {
                     var lzcl = codecs[0] as LzclCodec;
                     var bufSize = Math.Max(lzcl.MaximumDistance, lzcl.MaximumLength)+1;
                     headerMsg += $" LZCL bufsize {bufSize}";
+                    if (lzcl.PowerOfTwoTokens != 0)
+                        headerMsg += $" pow2 tokens cost {lzcl.PowerOfTwoTokenCost} bits";
                 }
                 OutputData(opts.Outputfile,output,OutputFormats[opts.OutputFormatIndex], headerMsg);
+                if (opts.SpecializeHeader && !opts.Decompress && opts.BlockSize == 0 && OutputFormats[opts.OutputFormatIndex] == "C")
+                {
+                    // block headers differ, so only single streams are specialized
+                    var itemName = Path.GetFileNameWithoutExtension(opts.Outputfile);
+                    var definesName = Path.Combine(Path.GetDirectoryName(Path.GetFullPath(opts.Outputfile)), itemName + "_defines.h");
+                    File.WriteAllText(definesName, Utility.FormatDefines(codecs[0].GetDecoderDefines(output), itemName, headerMsg));
+                    Console.WriteLine($"Decoder defines written to {definesName}");
+                }
 
                 var actionText = opts.Decompress ? "decompressed" : "compressed";
                 Console.WriteLine(
@@ -287,7 +384,7 @@ namespace Lomont.Compression
                 //public int OutputFormatIndex { get; set; } = -1;
                 //public bool Decompress { get; set; } = false;
 
-                var test = new Testing();
+                var test = new Testing {OutputWriter = Console.Out};
                 var request = new Testing.Request
                 {
                     Codecs = codecs,
@@ -296,9 +393,10 @@ namespace Lomont.Compression
                     RecurseFiles = opts.RecurseDirectories,
 
                     // Decompress = false,
-                    // UseExternalDecompressor = true,
+                    UseExternalDecompressor = opts.MemoryMap,
                     ShowOnlyErrors = false,
-                    TrapErrors = true
+                    TrapErrors = true,
+                    CacheFilename = opts.CacheFile
                 };
                 test.DoTest(request);
                 return 1;
@@ -307,10 +405,21 @@ namespace Lomont.Compression
             return -4;
         }
 
+        // find codec property with given parameter symbol name, or null
+        static PropertyInfo FindParameter(Type type, string symbolName)
+        {
+            var props = Utility.GetPropertiesWith<CodecParameterAttribute>(type).ToList();
+            return props.FirstOrDefault(p =>
+                {
+                    var attr = p.GetCustomAttribute(typeof(CodecParameterAttribute)) as CodecParameterAttribute;
+                    return attr != null && attr.SymbolName == symbolName;
+                }
+            );
+        }
+
         static void ApplyParameters(CodecBase codec, string parameterText)
         {
             var type = codec.GetType();
-            var props = Utility.GetPropertiesWith<CodecParameterAttribute>(type).ToList();
             parameterText = parameterText.Trim(new char[] {':'});
             var phrases = parameterText.Split(new[] {':'}, StringSplitOptions.RemoveEmptyEntries);
             foreach (var phrase in phrases)
@@ -322,12 +431,7 @@ namespace Lomont.Compression
                     Console.WriteLine($"Error! unknown parameter {phrase}");
                     continue;
                 }
-                var property = props.FirstOrDefault(p =>
-                    {
-                        var attr = p.GetCustomAttribute(typeof(CodecParameterAttribute)) as CodecParameterAttribute;
-                        return attr != null && attr.SymbolName == tokens[0];
-                    }
-                );
+                var property = FindParameter(type, tokens[0]);
                 if (property == null)
                 {
                     Console.WriteLine($"Error! unknown parameter {phrase}");
@@ -338,6 +442,83 @@ namespace Lomont.Compression
             }
         }
 
+        static int DoTrain(Options opts)
+        {
+            if (String.IsNullOrEmpty(opts.Outputfile))
+            {
+                Console.Error.WriteLine("Training needs an output file");
+                return -2;
+            }
+            var filenames = new List<string>();
+            if (Directory.Exists(opts.Inputfile))
+                filenames.AddRange(Directory.GetFiles(opts.Inputfile, "*", opts.RecurseDirectories ? SearchOption.AllDirectories : SearchOption.TopDirectoryOnly));
+            else if (File.Exists(opts.Inputfile))
+                filenames.Add(opts.Inputfile);
+            if (!filenames.Any())
+            {
+                Console.Error.WriteLine($"No training files in {opts.Inputfile}");
+                return -3;
+            }
+            filenames.Sort(StringComparer.Ordinal);
+            var samples = filenames.Select(File.ReadAllBytes).ToList();
+            var dictionary = PresetDictionary.Build(samples, (int)Math.Min(opts.TrainSize, Int32.MaxValue));
+            File.WriteAllBytes(opts.Outputfile, dictionary);
+            Console.WriteLine($"Dictionary of {dictionary.Length} bytes from {filenames.Count} files ({samples.Sum(d => (long)d.Length)} bytes) written to {opts.Outputfile}");
+            return 1;
+        }
+
+        static int DoSweep(Options opts)
+        {
+            if (opts.CodecIndices.Count != 1 || !File.Exists(opts.Inputfile))
+            {
+                Console.Error.WriteLine("Sweep needs one codec and an input file");
+                return -2;
+            }
+            var codecType = CodecTypes.First(t => t.Name.Replace("Codec", "") == CodecNames[opts.CodecIndices[0]]);
+
+            // parameter ranges
+            var parameters = new List<PropertyInfo>();
+            var grid = new List<List<uint>>();
+            var phrases = opts.CodecParameters[0].Split(new[] {':'}, StringSplitOptions.RemoveEmptyEntries);
+            foreach (var phrase in phrases)
+            {
+                var tokens = phrase.Split('=');
+                List<uint> values;
+                var property = tokens.Length == 2 ? FindParameter(codecType, tokens[0]) : null;
+                if (property == null || !ParameterSweep.ParseRange(tokens[1], out values))
+                {
+                    Console.Error.WriteLine($"Error! invalid sweep parameter {phrase}");
+                    return -2;
+                }
+                parameters.Add(property);
+                grid.Add(values);
+            }
+
+            var data = File.ReadAllBytes(opts.Inputfile);
+            var sweep = new ParameterSweep {OutputWriter = Console.Out};
+            var timer = Stopwatch.StartNew();
+            var results = sweep.Run(codecType, parameters, grid, data);
+            Console.WriteLine($"Swept {results.Count} settings in {timer.Elapsed.TotalSeconds:F1} seconds");
+
+            // table of the Pareto front, smallest output for each buffer size
+            var table = new MarkdownTable();
+            var parameterColumns = parameters.Select(p => table.AddColumn(p.Name)).ToList();
+            var bufferColumn = table.AddColumn("Buffer size");
+            var sizeColumn = table.AddColumn("Compressed size");
+            var ratioColumn = table.AddColumn("Ratio");
+            foreach (var r in ParameterSweep.ParetoFront(results))
+            {
+                var row = table.AddRow();
+                for (var i = 0; i < parameters.Count; ++i)
+                    table.SetCell(row, parameterColumns[i], r.Values[i].ToString());
+                table.SetCell(row, bufferColumn, r.BufferSize.ToString());
+                table.SetCell(row, sizeColumn, r.CompressedSize.ToString());
+                table.SetCell(row, ratioColumn, $"{(double)r.CompressedSize / data.Length:F3}");
+            }
+            table.Write(Console.Out);
+            return 1;
+        }
+
         static void Main(string[] args)
         {
             int exitCode;
@@ -355,7 +536,7 @@ namespace Lomont.Compression
             Environment.Exit(exitCode);
         }
 
-        static void DoTesting()
+        static void DoTesting(string cacheFilename)
         {
 
             var test = new Testing
@@ -430,6 +611,9 @@ namespace Lomont.Compression
             //codecCL.Optimize(ds);
             //return;
 
+            // price based parse, which finds no matches on random data
+            var codecClOptimal = new LzclCodec {CodecName = "LZCL optimal", OptimalParsePasses = 2};
+
             var codecH = new HuffmanCodec();
             //codecH.OutputWriter = Console.Out;
             //codecH.Options |= HuffmanCodec.OptionFlags.DumpDecoding;
@@ -459,6 +643,7 @@ namespace Lomont.Compression
                     codecA,
                     codec77,
                     codecCl,
+                    codecClOptimal,
                     //codecGolomb,
                     //codecCLbase,
                     //codecF
@@ -467,6 +652,7 @@ namespace Lomont.Compression
 
                 //TestData = smallTest,
                 //TestData = DataSets.HypnoLightLogo,
+                TestDataSets = DataSets.Generated,
                 Filename = "*.*",
                 Path = Testing.Paths[0],
                 RecurseFiles = true,
@@ -474,7 +660,8 @@ namespace Lomont.Compression
                 //Decompress = false,
                 UseExternalDecompressor = true,
                 ShowOnlyErrors = false,
-                TrapErrors = true
+                TrapErrors = true,
+                CacheFilename = cacheFilename
             };
             test.DoTest(request);
 
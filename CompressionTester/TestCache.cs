@@ -0,0 +1,194 @@
+﻿/*
+MIT License
+
+Copyright (c) 2016 Chris Lomont
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Concurrent;
+using System.IO;
+using System.Linq;
+using System.Reflection;
+using System.Security.Cryptography;
+using System.Text;
+using System.Threading;
+using Lomont.Compression.Codec;
+
+namespace Lomont.Compression
+{
+    /// <summary>
+    /// On disk cache of test results, keyed by a hash of the data and the codec settings,
+    /// so a rerun only recomputes tests whose data, codec, or settings changed. 
+    /// Only successful results are kept, so failures are always retested.
+    /// Safe to use from several threads.
+    /// </summary>
+    public class TestCache
+    {
+        public TestCache(string filename)
+        {
+            Filename = filename;
+            if (File.Exists(filename))
+                Load();
+        }
+
+        /// <summary>
+        /// File holding the results, one tab separated line each
+        /// </summary>
+        public string Filename { get; }
+
+        /// <summary>
+        /// Number of results found in the cache since created
+        /// </summary>
+        public int Hits => hits;
+
+        /// <summary>
+        /// Get a hash of the data, as hex
+        /// </summary>
+        /// <param name="data"></param>
+        /// <returns></returns>
+        public static string HashData(byte[] data)
+        {
+            using (var sha = SHA256.Create())
+                return String.Concat(sha.ComputeHash(data).Select(b => b.ToString("x2")));
+        }
+
+        /// <summary>
+        /// Key for a test of the hashed data by the codec: the codec type and version, 
+        /// every codec setting, and the decompression the test does
+        /// </summary>
+        /// <param name="dataHash"></param>
+        /// <param name="codec"></param>
+        /// <param name="request"></param>
+        /// <returns></returns>
+        public static string MakeKey(string dataHash, CodecBase codec, Testing.Request request)
+        {
+            var type = codec.GetType();
+            var attr = type.GetCustomAttribute(typeof(CodecAttribute)) as CodecAttribute;
+            var key = new StringBuilder();
+            key.Append($"{dataHash}:{type.Name}:v{attr?.Version ?? 0}");
+            foreach (var property in Utility.GetSettings(type).Where(p => p.Name != nameof(CodecBase.CodecName)))
+                key.Append($":{property.Name}={property.GetValue(codec)}");
+            var dictionary = (codec as Lz77Codec)?.Dictionary ?? (codec as LzclCodec)?.Dictionary;
+            if (dictionary != null)
+                key.Append($":dictionary={HashData(dictionary)}");
+            key.Append($":decompress={request.Decompress}:external={request.UseExternalDecompressor}");
+            return key.ToString();
+        }
+
+        /// <summary>
+        /// Get the cached result for key, with the test item fields unset
+        /// </summary>
+        /// <param name="key"></param>
+        /// <param name="result"></param>
+        /// <returns></returns>
+        public bool TryGet(string key, out Testing.Result result)
+        {
+            Entry entry;
+            result = null;
+            if (!entries.TryGetValue(key, out entry))
+                return false;
+            Interlocked.Increment(ref hits);
+            result = new Testing.Result
+            {
+                Success = true,
+                UncompressedLength = entry.UncompressedLength,
+                CompressedLength = entry.CompressedLength,
+                CompressionTicks = entry.CompressionTicks,
+                DecompressionTicks = entry.DecompressionTicks
+            };
+            return true;
+        }
+
+        /// <summary>
+        /// Save a result under key. Unsuccessful results are not kept.
+        /// </summary>
+        /// <param name="key"></param>
+        /// <param name="result"></param>
+        public void Add(string key, Testing.Result result)
+        {
+            if (!result.Success)
+                return;
+            entries[key] = new Entry
+            {
+                UncompressedLength = result.UncompressedLength,
+                CompressedLength = result.CompressedLength,
+                CompressionTicks = result.CompressionTicks,
+                DecompressionTicks = result.DecompressionTicks
+            };
+        }
+
+        /// <summary>
+        /// Write all results to the cache file
+        /// </summary>
+        public void Save()
+        {
+            // write then replace, so an interrupted save leaves the old cache
+            var tempName = Filename + ".tmp";
+            using (var writer = new StreamWriter(tempName))
+            {
+                foreach (var pair in entries.OrderBy(p => p.Key, StringComparer.Ordinal))
+                {
+                    var e = pair.Value;
+                    writer.WriteLine($"{pair.Key}\t{e.UncompressedLength}\t{e.CompressedLength}\t{e.CompressionTicks}\t{e.DecompressionTicks}");
+                }
+            }
+            if (File.Exists(Filename))
+                File.Delete(Filename);
+            File.Move(tempName, Filename);
+        }
+
+        #region Implementation
+
+        class Entry
+        {
+            public long UncompressedLength { get; set; }
+            public long CompressedLength { get; set; }
+            public long CompressionTicks { get; set; }
+            public long DecompressionTicks { get; set; }
+        }
+
+        readonly ConcurrentDictionary<string, Entry> entries = new ConcurrentDictionary<string, Entry>();
+        int hits;
+
+        void Load()
+        {
+            foreach (var line in File.ReadLines(Filename))
+            {
+                var fields = line.Split('\t');
+                long uncompressed, compressed, compressTicks, decompressTicks;
+                if (fields.Length != 5 ||
+                    !Int64.TryParse(fields[1], out uncompressed) ||
+                    !Int64.TryParse(fields[2], out compressed) ||
+                    !Int64.TryParse(fields[3], out compressTicks) ||
+                    !Int64.TryParse(fields[4], out decompressTicks))
+                    continue; // skip damaged lines
+                entries[fields[0]] = new Entry
+                {
+                    UncompressedLength = uncompressed,
+                    CompressedLength = compressed,
+                    CompressionTicks = compressTicks,
+                    DecompressionTicks = decompressTicks
+                };
+            }
+        }
+
+        #endregion
+    }
+}
@@ -26,6 +26,8 @@ using System.Collections.Generic;
 using System.Diagnostics;
 using System.IO;
 using System.Linq;
+using System.Threading;
+using System.Threading.Tasks;
 using Lomont.Compression.Codec;
 
 namespace Lomont.Compression
@@ -47,6 +49,10 @@ namespace Lomont.Compression
             /// </summary>
             public byte[] TestData { get; set; }
             /// <summary>
+            /// Named data arrays to test, such as DataSets.Generated
+            /// </summary>
+            public List<Tuple<string, byte[]>> TestDataSets { get; set; }
+            /// <summary>
             /// A filename to test, or a file pattern when used with path
             /// </summary>
             public string Filename { get; set;  }
@@ -74,6 +80,10 @@ namespace Lomont.Compression
             /// Trap exceptions, otherwise let fall through
             /// </summary>
             public bool TrapErrors { get; set; } = true;
+            /// <summary>
+            /// File caching results between runs, or null for none
+            /// </summary>
+            public string CacheFilename { get; set; }
         }
 
         /// <summary>
@@ -126,6 +136,11 @@ namespace Lomont.Compression
             WriteLine();
         }
 
+        /// <summary>
+        /// Test each (file, codec) item. Items run in parallel, each on its own copy
+        /// of the codec, and are reported in order once all are done.
+        /// </summary>
+        /// <param name="request"></param>
         public void DoTest(Request request)
         {
             WriteLine("codec, success, uncompressed size, compressed size, compression ratio, compression ticks, decompression ticks, filesize, filename,");
@@ -133,20 +148,65 @@ namespace Lomont.Compression
             var stats = new Stats();
             var results = new List<Result>();
 
-            foreach (var dataSet in GetItems(request))
+            var items = GetItems(request).ToList();
+            foreach (var codec in items.Select(item => item.Item1).Distinct())
             {
-                var codec = dataSet.Item1;
-                var data = dataSet.Item2;
-                var filename = dataSet.Item3;
+                if (String.IsNullOrEmpty(codec.CodecName))
+                    codec.CodecName = codec.GetType().Name;
+                codec.CodecName = codec.CodecName.Replace("Codec", "");
+            }
+
+            var cache = String.IsNullOrEmpty(request.CacheFilename) ? null : new TestCache(request.CacheFilename);
+            var hashes = new Dictionary<byte[], string>();
+            if (cache != null)
+                foreach (var data in items.Select(item => item.Item2).Distinct())
+                    hashes.Add(data, TestCache.HashData(data));
 
+            var itemResults = new Result[items.Count];
+            var itemErrors = new Exception[items.Count];
+            var done = 0;
+            Parallel.For(0, items.Count, i =>
+            {
+                var codec = items[i].Item1;
+                var data = items[i].Item2;
                 try
                 {
-                    var result = TestDataRoundtrip(request, codec, data);
-                    result.Codec = codec;
-                    if (String.IsNullOrEmpty(codec.CodecName))
-                        codec.CodecName = codec.GetType().Name;
-                    codec.CodecName = codec.CodecName.Replace("Codec", "");
+                    Result result;
+                    var key = cache == null ? null : TestCache.MakeKey(hashes[data], codec, request);
+                    if (cache == null || !cache.TryGet(key, out result))
+                    {
+                        result = TestDataRoundtrip(request, CopyCodec(codec), data);
+                        cache?.Add(key, result);
+                    }
+                    itemResults[i] = result;
+                }
+                catch (Exception ex)
+                {
+                    itemErrors[i] = ex;
+                }
+
+                var count = Interlocked.Increment(ref done);
+                lock (itemResults)
+                {
+                    if (!Console.IsInputRedirected && Console.KeyAvailable)
+                    {
+                        while (Console.KeyAvailable)
+                            Console.ReadKey(true);
+                        WriteLine($"{count} of {items.Count} done");
+                    }
+                }
+            });
+            cache?.Save();
+
+            for (var i = 0; i < items.Count; ++i)
+            {
+                var codec = items[i].Item1;
+                var filename = items[i].Item3;
 
+                if (itemErrors[i] == null)
+                {
+                    var result = itemResults[i];
+                    result.Codec = codec;
                     result.DataFilename = filename;
                     results.Add(result);
 
@@ -163,28 +223,21 @@ namespace Lomont.Compression
                     }
                     if (!request.ShowOnlyErrors && result.Success)
                         DumpResult(result, codec, filename);
-
                 }
-                // public bool TrapErrors { get; set; }
-                catch (Exception ex)
+                else
                 {
                     stats.Failed++;
                     var length = 0L;
                     if (!String.IsNullOrEmpty(filename) && File.Exists(filename))
                         length = new FileInfo(filename).Length;
-                    WriteLine($"EXCEPTION: {filename,30} ({length,10}): " + ex);
+                    WriteLine($"EXCEPTION: {filename,30} ({length,10}): " + itemErrors[i]);
                     if (!request.TrapErrors)
-                        throw;
+                        throw itemErrors[i];
                 }
-
-                if (Console.KeyAvailable)
-                {
-                    while (Console.KeyAvailable)
-                        Console.ReadKey(true);
-                    DumpStats(stats);
-                }
-
             }
+            if (cache != null)
+                WriteLine($"{cache.Hits} of {items.Count} results from cache {cache.Filename}");
+
             // final summary
             DumpStats(stats);
 
@@ -195,6 +248,21 @@ namespace Lomont.Compression
             StatRecorder.DumpLog(OutputWriter);
         }
 
+        // new codec with the same settings, so items can run at once
+        static CodecBase CopyCodec(CodecBase codec)
+        {
+            var copy = (CodecBase)Activator.CreateInstance(codec.GetType());
+            foreach (var property in Utility.GetSettings(codec.GetType()))
+                property.SetValue(copy, property.GetValue(codec));
+            copy.OutputWriter = codec.OutputWriter;
+            // preset dictionaries are not settings, share them
+            if (codec is Lz77Codec)
+                ((Lz77Codec)copy).Dictionary = ((Lz77Codec)codec).Dictionary;
+            if (codec is LzclCodec)
+                ((LzclCodec)copy).Dictionary = ((LzclCodec)codec).Dictionary;
+            return copy;
+        }
+
         public void DumpTable(List<Result> results, Stats stats)
         {
             var m = new MarkdownTable();
@@ -280,6 +348,12 @@ namespace Lomont.Compression
                 foreach (var codec in codecs)
                     yield return new Tuple<CodecBase, byte[],string>(codec,data,"");
             }
+            if (request.TestDataSets != null)
+            {
+                foreach (var set in request.TestDataSets)
+                foreach (var codec in codecs)
+                    yield return new Tuple<CodecBase, byte[], string>(codec, set.Item2, set.Item1);
+            }
 
             int fileMaxSize = 1000000;
 
@@ -356,34 +430,18 @@ namespace Lomont.Compression
                     byte canary = (byte)(data.Length^0x5A); // check survives
                     var decompressedCanary = new byte[data.Length+1];
                     decompressedCanary[decompressedCanary.Length - 1] = canary;
-                    if (codec.GetType() == typeof(HuffmanCodec) && compressed != null)
-                    {
-                        timer.Start();
-                        NativeMethods.DecompressHuffman(compressed, compressed.Length, decompressedCanary,
-                            decompressedCanary.Length - 1);
-                        timer.Stop();
-                    }
-                    else if (codec.GetType() == typeof(Lz77Codec) && compressed != null)
+                    if (NativeStatsBuilt.Value)
                     {
-                        timer.Start();
-                        NativeMethods.DecompressLZ77(compressed, compressed.Length, decompressedCanary,
-                            decompressedCanary.Length - 1);
-                        timer.Stop();
-                    }
-                    else if (codec.GetType() == typeof(ArithmeticCodec) && compressed != null)
-                    {
-                        timer.Start();
-                        NativeMethods.DecompressArithmetic(compressed, compressed.Length, decompressedCanary,
-                            decompressedCanary.Length - 1);
-                        timer.Stop();
-                    }
-                    else if (codec.GetType() == typeof(LzclCodec) && compressed != null)
-                    {
-                        timer.Start();
-                        NativeMethods.DecompressLZCL(compressed, compressed.Length, decompressedCanary, 
-                            decompressedCanary.Length - 1);
-                        timer.Stop();
+                        // counts are global in the decoder, so decode one at a time
+                        lock (NativeStatsBuilt)
+                        {
+                            NativeMethods.DecompressResetStats();
+                            ExternalDecompress(codec, compressed, decompressedCanary, timer);
+                            RecordNativeStats(codec);
+                        }
                     }
+                    else
+                        ExternalDecompress(codec, compressed, decompressedCanary, timer);
                     if (decompressedCanary[decompressedCanary.Length - 1] != canary)
                         throw new Exception("Decompression canary overwritten!");
                     // must shrink decompressed to proper size for compare
@@ -402,6 +460,116 @@ namespace Lomont.Compression
             return result;
         }
 
+        // decode with the C decompressor into decompressedCanary, less its last byte, timing the call
+        static void ExternalDecompress(CodecBase codec, byte[] compressed, byte[] decompressedCanary, Stopwatch timer)
+        {
+            if (compressed == null)
+                return;
+            if (codec.GetType() == typeof(HuffmanCodec))
+            {
+                timer.Start();
+                NativeMethods.DecompressHuffman(compressed, compressed.Length, decompressedCanary,
+                    decompressedCanary.Length - 1);
+                timer.Stop();
+            }
+            else if (codec.GetType() == typeof(Lz77Codec))
+            {
+                var dictionary = ((Lz77Codec)codec).Dictionary;
+                timer.Start();
+                if (dictionary != null)
+                    NativeMethods.DecompressLZ77Dictionary(compressed, compressed.Length, decompressedCanary,
+                        decompressedCanary.Length - 1, dictionary, dictionary.Length);
+                else
+                    NativeMethods.DecompressLZ77(compressed, compressed.Length, decompressedCanary,
+                        decompressedCanary.Length - 1);
+                timer.Stop();
+            }
+            else if (codec.GetType() == typeof(ArithmeticCodec))
+            {
+                timer.Start();
+                NativeMethods.DecompressArithmetic(compressed, compressed.Length, decompressedCanary,
+                    decompressedCanary.Length - 1);
+                timer.Stop();
+            }
+            else if (codec.GetType() == typeof(LzclCodec))
+            {
+                var dictionary = ((LzclCodec)codec).Dictionary;
+                timer.Start();
+                if (dictionary != null)
+                    NativeMethods.DecompressLZCLDictionary(compressed, compressed.Length, decompressedCanary,
+                        decompressedCanary.Length - 1, dictionary, dictionary.Length);
+                else
+                    NativeMethods.DecompressLZCL(compressed, compressed.Length, decompressedCanary, 
+                        decompressedCanary.Length - 1);
+                timer.Stop();
+            }
+            else if (codec.GetType() == typeof(RansCodec))
+            {
+                timer.Start();
+                NativeMethods.DecompressRans(compressed, compressed.Length, decompressedCanary,
+                    decompressedCanary.Length - 1);
+                timer.Stop();
+            }
+        }
+
+        // true if the C decompressor was built with DECOMPRESSOR_STATS
+        static readonly Lazy<bool> NativeStatsBuilt = new Lazy<bool>(() =>
+        {
+            DecompressorStats stats;
+            return NativeMethods.DecompressGetStats(out stats) != 0;
+        });
+
+        // log the C decoder counts for the last decode, summed per codec,
+        // so decode cost shows next to the compressed sizes
+        static void RecordNativeStats(CodecBase codec)
+        {
+            DecompressorStats stats;
+            NativeMethods.DecompressGetStats(out stats);
+            var prefix = $"decode {codec.CodecName}: ";
+            StatRecorder.AddStat(prefix + "bits read", stats.BitsRead);
+            if (stats.Literals + stats.Matches > 0)
+            {
+                StatRecorder.AddStat(prefix + "literals", stats.Literals);
+                StatRecorder.AddStat(prefix + "matches", stats.Matches);
+                StatRecorder.AddStat(prefix + "match bytes", stats.MatchBytes);
+                // bucket k counts lengths in [2^k,2^(k+1)) and 0 based distances
+                // one less, the last bucket taking all larger ones
+                for (var k = 0; k < 32; ++k)
+                {
+                    if (stats.MatchLengths[k] != 0)
+                        StatRecorder.AddStat(prefix + "match length " + BucketRange(k, 0), stats.MatchLengths[k]);
+                    if (stats.MatchDistances[k] != 0)
+                        StatRecorder.AddStat(prefix + "match distance " + BucketRange(k, 1), stats.MatchDistances[k]);
+                }
+            }
+            if (stats.HuffmanTableHits + stats.HuffmanRows > 0)
+            {
+                StatRecorder.AddStat(prefix + "Huffman table hits", stats.HuffmanTableHits);
+                StatRecorder.AddStat(prefix + "Huffman rows walked", stats.HuffmanRows);
+            }
+            if (stats.ArithmeticRenormalizations + stats.ArithmeticLookupSteps > 0)
+            {
+                StatRecorder.AddStat(prefix + "arithmetic renormalizations", stats.ArithmeticRenormalizations);
+                StatRecorder.AddStat(prefix + "arithmetic lookup steps", stats.ArithmeticLookupSteps);
+            }
+            if (stats.RansRenormalizations + stats.RansLookupSteps > 0)
+            {
+                StatRecorder.AddStat(prefix + "rANS renormalizations", stats.RansRenormalizations);
+                StatRecorder.AddStat(prefix + "rANS lookup steps", stats.RansLookupSteps);
+            }
+        }
+
+        // label of histogram bucket k, offset below its powers of two,
+        // bucket 0 also holding 0
+        static string BucketRange(int k, ulong offset)
+        {
+            var low = k == 0 ? 0 : (1UL << k) - offset;
+            if (k == 31)
+                return $"{low,10}+";
+            var high = (2UL << k) - 1 - offset;
+            return low == high ? $"{low,10}" : $"{low,10}-{high}";
+        }
+
         public static void Optimize(byte [] data)
         {
             var entropy = CodecBase.ComputeShannonEntropy(data);
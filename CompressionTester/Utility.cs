@@ -65,6 +65,21 @@ namespace Lomont.Compression
                 .Where(p => p.GetCustomAttributes(typeof(TAttribute), false).Length > 0);
         }
 
+        /// <summary>
+        /// Get the settings of an object: public read/write instance properties 
+        /// holding a primitive, enum, or string, ordered by name
+        /// </summary>
+        /// <param name="type"></param>
+        /// <returns></returns>
+        public static IEnumerable<PropertyInfo> GetSettings(Type type)
+        {
+            return type
+                .GetProperties(BindingFlags.Public | BindingFlags.Instance)
+                .Where(p => p.CanRead && p.CanWrite && p.GetIndexParameters().Length == 0)
+                .Where(p => p.PropertyType.IsPrimitive || p.PropertyType.IsEnum || p.PropertyType == typeof(string))
+                .OrderBy(p => p.Name, StringComparer.Ordinal);
+        }
+
         /// <summary>
         /// Format data as C code
         /// </summary>
@@ -92,5 +107,27 @@ namespace Lomont.Compression
             return output.ToString();
         }
 
+        /// <summary>
+        /// Format #defines as a C header, to select with DECOMPRESSOR_SPECIALIZE
+        /// </summary>
+        /// <param name="defines"></param>
+        /// <param name="itemName"></param>
+        /// <param name="headerMessage"></param>
+        /// <returns></returns>
+        public static string FormatDefines(IEnumerable<Tuple<string, uint>> defines, string itemName, string headerMessage)
+        {
+            var output = new StringBuilder();
+            var guard = "_" + new string(itemName.ToUpperInvariant().Select(c => Char.IsLetterOrDigit(c) ? c : '_').ToArray()) + "_DEFINES";
+            output.AppendLine($"// {headerMessage}");
+            output.AppendLine($"// Decoder specialized for {itemName}, select with");
+            output.AppendLine($"// #define DECOMPRESSOR_SPECIALIZE \"{itemName}_defines.h\"");
+            output.AppendLine($"#ifndef {guard}");
+            output.AppendLine($"#define {guard}");
+            foreach (var define in defines)
+                output.AppendLine($"#define {define.Item1,-36} {define.Item2}");
+            output.AppendLine($"#endif // {guard}");
+            return output.ToString();
+        }
+
     }
 }
@@ -0,0 +1,697 @@
+/*
+MIT License
+
+Copyright (c) 2016 Chris Lomont
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+// Host benchmark for the reference decoder, laid out like PIC32Test.X/src/tester.c.
+// Times every codec, one-shot and incremental, over the Calgary and Cantebury
+// corpus files. Compressed copies of each file are made with CompressionTester,
+// named file.Huffman, file.Arithmetic, file.Rans, file.Lz77, and file.Lzcl.
+//
+// usage: HostBenchmark corpusDir compressedDir [-n repeats] [-r ringSize]
+
+// clock_gettime and CLOCK_MONOTONIC under -std=c11, before any header
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../ReferenceDecoder/Decompressor.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define HAVE_CYCLES
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES
+#endif
+
+#ifdef _MSC_VER
+#define NOINLINE __declspec(noinline)
+#else
+#define NOINLINE __attribute__((noinline))
+#endif
+
+#define CANARY 0xD7
+// stack bytes painted to find the deepest a decoder reaches
+#define STACK_PAINT 32768
+#define STACK_PATTERN 0xA5
+// Huffman lookup table entries, and arithmetic table entries (symbols and counts)
+#define HUFFMAN_TABLE 512
+#define ARITHMETIC_TABLE (257 + 65536)
+// bytes per line when reading through a source, as for a QSPI flash burst
+#define SOURCE_LINE 32
+
+// Calgary and Cantebury corpus files, relative to the corpus directory
+static const char * corpusFiles[] = {
+    "Calgary/bib", "Calgary/book1", "Calgary/book2", "Calgary/geo", "Calgary/news",
+    "Calgary/obj1", "Calgary/obj2", "Calgary/paper1", "Calgary/paper2", "Calgary/paper3",
+    "Calgary/paper4", "Calgary/paper5", "Calgary/paper6", "Calgary/pic", "Calgary/progc",
+    "Calgary/progl", "Calgary/progp", "Calgary/trans",
+    "Cantebury/alice29.txt", "Cantebury/asyoulik.txt", "Cantebury/cp.html", "Cantebury/fields.c",
+    "Cantebury/grammar.lsp", "Cantebury/kennedy.xls", "Cantebury/lcet10.txt", "Cantebury/plrabn12.txt",
+    "Cantebury/ptt5", "Cantebury/sum", "Cantebury/xargs.1"
+};
+
+/************************* Timing *********************************************/
+
+// nanoseconds from a fixed start
+static uint64_t ReadNanoseconds()
+{
+#ifdef _WIN32
+    LARGE_INTEGER count, frequency;
+    QueryPerformanceCounter(&count);
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)(count.QuadPart / frequency.QuadPart) * 1000000000ULL +
+        (uint64_t)(count.QuadPart % frequency.QuadPart) * 1000000000ULL / frequency.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+#endif
+}
+
+// cycle counter for per call latency, the time stamp counter on x86,
+// else nanoseconds
+static uint64_t ReadCycles()
+{
+#ifdef HAVE_CYCLES
+    return __rdtsc();
+#else
+    return ReadNanoseconds();
+#endif
+}
+
+/************************* Decoders under test ********************************/
+
+// one decoder run: where to decode from and to, scratch buffers, and
+// where to record the cycles taken by each call into the decoder
+typedef struct
+{
+    const uint8_t * source;
+    uint32_t sourceLength;
+    uint8_t * dest;
+    uint32_t destLength;
+    uint8_t * ring;
+    uint32_t ringLength;
+    uint32_t * table;
+    // per call cycles, 0 when not recording
+    uint32_t * latency;
+    uint32_t latencyCount;
+} Run_t;
+
+// make one call into the decoder, recording its cycles if asked
+#define CALL(run, expr) \
+    do { \
+        if ((run)->latency != 0) \
+        { \
+            uint64_t start__ = ReadCycles(); \
+            expr; \
+            (run)->latency[(run)->latencyCount++] = (uint32_t)(ReadCycles() - start__); \
+        } \
+        else \
+        { \
+            expr; \
+        } \
+    } while (0)
+
+// copy count bytes decoded into the cyclic buffer, ending at byteIndex, out to dest
+static void CopyRing(Run_t * run, uint32_t byteIndex, uint32_t count)
+{
+    uint32_t start = byteIndex - count;
+    while (count > 0)
+    {
+        uint32_t position = start % run->ringLength;
+        uint32_t length = run->ringLength - position;
+        if (length > count)
+            length = count;
+        memcpy(run->dest + start, run->ring + position, length);
+        start += length;
+        count -= length;
+    }
+}
+
+// decoders return bytes written to dest
+
+#ifdef DECOMPRESSOR_USE_HUFFMAN
+static uint32_t HuffmanOneShot(Run_t * run)
+{
+    int32_t length;
+    CALL(run, length = DecompressHuffman(run->source, run->sourceLength, run->dest, run->destLength));
+    return (uint32_t)length;
+}
+
+static uint32_t HuffmanIncremental(Run_t * run)
+{
+    HuffmanState_t huffmanState;
+    uint32_t symbol, index = 0;
+    DecompressHuffmanStart(&huffmanState, run->source, run->sourceLength);
+    while (index < run->destLength)
+    {
+        CALL(run, symbol = DecompressHuffmanSymbol(&huffmanState));
+        if (symbol == CL_COMPRESSOR_END_TOKEN)
+            break;
+        run->dest[index++] = (uint8_t)symbol;
+    }
+    return index;
+}
+
+#ifdef DECOMPRESSOR_USE_HUFFMAN_TABLE
+static uint32_t HuffmanTable(Run_t * run)
+{
+    int32_t length;
+    CALL(run, length = DecompressHuffmanFast(run->source, run->sourceLength, run->dest, run->destLength, run->table, HUFFMAN_TABLE));
+    return (uint32_t)length;
+}
+
+static uint32_t HuffmanTableIncremental(Run_t * run)
+{
+    HuffmanState_t huffmanState;
+    uint32_t symbol, index = 0;
+    DecompressHuffmanStartFast(&huffmanState, run->source, run->sourceLength, run->table, HUFFMAN_TABLE);
+    while (index < run->destLength)
+    {
+        CALL(run, symbol = DecompressHuffmanSymbol(&huffmanState));
+        if (symbol == CL_COMPRESSOR_END_TOKEN)
+            break;
+        run->dest[index++] = (uint8_t)symbol;
+    }
+    return index;
+}
+#endif
+#endif // DECOMPRESSOR_USE_HUFFMAN
+
+#ifdef DECOMPRESSOR_USE_ARITHMETIC
+static uint32_t ArithmeticOneShot(Run_t * run)
+{
+    int32_t length;
+    CALL(run, length = DecompressArithmetic(run->source, run->sourceLength, run->dest, run->destLength));
+    return (uint32_t)length;
+}
+
+static uint32_t ArithmeticIncremental(Run_t * run)
+{
+    ArithmeticState_t arithmeticState;
+    uint32_t symbol, index = 0;
+    uint32_t length = DecompressArithmeticStart(&arithmeticState, run->source, run->sourceLength);
+    if (length > run->destLength)
+        length = run->destLength;
+    while (index < length)
+    {
+        CALL(run, symbol = DecompressArithmeticSymbol(&arithmeticState));
+        run->dest[index++] = (uint8_t)symbol;
+    }
+    return index;
+}
+
+#ifdef DECOMPRESSOR_USE_ARITHMETIC_TABLE
+static uint32_t ArithmeticTable(Run_t * run)
+{
+    int32_t length;
+    CALL(run, length = DecompressArithmeticFast(run->source, run->sourceLength, run->dest, run->destLength, run->table, ARITHMETIC_TABLE));
+    return (uint32_t)length;
+}
+
+static uint32_t ArithmeticTableIncremental(Run_t * run)
+{
+    ArithmeticState_t arithmeticState;
+    uint32_t symbol, index = 0;
+    uint32_t length = DecompressArithmeticStartFast(&arithmeticState, run->source, run->sourceLength, run->table, ARITHMETIC_TABLE);
+    if (length > run->destLength)
+        length = run->destLength;
+    while (index < length)
+    {
+        CALL(run, symbol = DecompressArithmeticSymbol(&arithmeticState));
+        run->dest[index++] = (uint8_t)symbol;
+    }
+    return index;
+}
+#endif
+#endif // DECOMPRESSOR_USE_ARITHMETIC
+
+#ifdef DECOMPRESSOR_USE_RANS
+static uint32_t RansOneShot(Run_t * run)
+{
+    int32_t length;
+    CALL(run, length = DecompressRans(run->source, run->sourceLength, run->dest, run->destLength));
+    return (uint32_t)length;
+}
+
+static uint32_t RansIncremental(Run_t * run)
+{
+    RansState_t ransState;
+    uint32_t symbol, index = 0;
+    uint32_t length = DecompressRansStart(&ransState, run->source, run->sourceLength);
+    if (length > run->destLength)
+        length = run->destLength;
+    while (index < length)
+    {
+        CALL(run, symbol = DecompressRansSymbol(&ransState));
+        run->dest[index++] = (uint8_t)symbol;
+    }
+    return index;
+}
+#endif // DECOMPRESSOR_USE_RANS
+
+#ifdef DECOMPRESSOR_USE_LZ77
+static uint32_t LZ77OneShot(Run_t * run)
+{
+    int32_t length;
+    CALL(run, length = DecompressLZ77(run->source, run->sourceLength, run->dest, run->destLength));
+    return (uint32_t)length;
+}
+
+static uint32_t LZ77Incremental(Run_t * run)
+{
+    LZ77State_t lz77State;
+    uint32_t runLength;
+    DecompressLZ77Start(&lz77State, run->source, run->sourceLength, run->ring, run->ringLength);
+    while (1)
+    {
+        CALL(run, runLength = DecompressLZ77Block(&lz77State));
+        if (runLength == CL_COMPRESSOR_END_TOKEN || lz77State.byteIndex > run->destLength)
+            break;
+        CopyRing(run, lz77State.byteIndex, runLength);
+    }
+    return lz77State.byteIndex;
+}
+
+static uint32_t LZ77Partial(Run_t * run)
+{
+    LZ77State_t lz77State;
+    uint32_t count, index = 0;
+    DecompressLZ77Start(&lz77State, run->source, run->sourceLength, run->ring, run->ringLength);
+    while (index < run->destLength)
+    {
+        uint32_t maxBytes = run->destLength - index < 64 ? run->destLength - index : 64;
+        CALL(run, count = DecompressLZ77Partial(&lz77State, run->dest + index, maxBytes));
+        if (count == 0)
+            break;
+        index += count;
+    }
+    return index;
+}
+#endif // DECOMPRESSOR_USE_LZ77
+
+#ifdef DECOMPRESSOR_USE_LZCL
+static uint32_t LZCLOneShot(Run_t * run)
+{
+    int32_t length;
+    CALL(run, length = DecompressLZCL(run->source, run->sourceLength, run->dest, run->destLength));
+    return (uint32_t)length;
+}
+
+static uint32_t LZCLIncremental(Run_t * run)
+{
+    LZCLState_t lzclState;
+    uint32_t runLength;
+    DecompressLZCLStart(&lzclState, run->source, run->sourceLength, run->ring, run->ringLength);
+    while (1)
+    {
+        CALL(run, runLength = DecompressLZCLBlock(&lzclState));
+        if (runLength == CL_COMPRESSOR_END_TOKEN || lzclState.byteIndex > run->destLength)
+            break;
+        CopyRing(run, lzclState.byteIndex, runLength);
+    }
+    return lzclState.byteIndex;
+}
+
+static uint32_t LZCLPartial(Run_t * run)
+{
+    LZCLState_t lzclState;
+    uint32_t count, index = 0;
+    DecompressLZCLStart(&lzclState, run->source, run->sourceLength, run->ring, run->ringLength);
+    while (index < run->destLength)
+    {
+        uint32_t maxBytes = run->destLength - index < 64 ? run->destLength - index : 64;
+        CALL(run, count = DecompressLZCLPartial(&lzclState, run->dest + index, maxBytes));
+        if (count == 0)
+            break;
+        index += count;
+    }
+    return index;
+}
+
+#ifdef DECOMPRESSOR_USE_SOURCE_READER
+// Stand in for an external flash read, the data is really in memory
+static void FlashRead(void * context, const uint8_t * address, uint8_t * buffer, uint32_t length)
+{
+    (void)context;
+    memcpy(buffer, address, length);
+}
+
+static uint32_t LZCLSource(Run_t * run)
+{
+    static uint8_t lines[DECOMPRESSOR_SOURCE_LINES * SOURCE_LINE];
+    DecompressSource_t source;
+    int32_t length;
+    DecompressAddSource(&source, run->source, run->sourceLength, FlashRead, 0, lines, SOURCE_LINE);
+    CALL(run, length = DecompressLZCL(run->source, run->sourceLength, run->dest, run->destLength));
+    DecompressRemoveSource(&source);
+    return (uint32_t)length;
+}
+#endif
+#endif // DECOMPRESSOR_USE_LZCL
+
+typedef uint32_t (*Decoder_t)(Run_t * run);
+
+typedef struct
+{
+    const char * name;
+    // compressed file extension
+    const char * codec;
+    Decoder_t decoder;
+    // decoder state the caller holds, not counting the ring buffer or table
+    uint32_t stateSize;
+    // uses the ring buffer
+    int usesRing;
+    // table entries used, 0 for none
+    uint32_t tableLength;
+} Test_t;
+
+static const Test_t tests[] = {
+#ifdef DECOMPRESSOR_USE_HUFFMAN
+    { "Huffman",                    "Huffman",    HuffmanOneShot,             0,                         0, 0 },
+    { "Huffman incremental",        "Huffman",    HuffmanIncremental,         sizeof(HuffmanState_t),    0, 0 },
+#ifdef DECOMPRESSOR_USE_HUFFMAN_TABLE
+    { "Huffman table",              "Huffman",    HuffmanTable,               0,                         0, HUFFMAN_TABLE },
+    { "Huffman table incremental",  "Huffman",    HuffmanTableIncremental,    sizeof(HuffmanState_t),    0, HUFFMAN_TABLE },
+#endif
+#endif
+#ifdef DECOMPRESSOR_USE_ARITHMETIC
+    { "Arithmetic",                 "Arithmetic", ArithmeticOneShot,          0,                         0, 0 },
+    { "Arithmetic incremental",     "Arithmetic", ArithmeticIncremental,      sizeof(ArithmeticState_t), 0, 0 },
+#ifdef DECOMPRESSOR_USE_ARITHMETIC_TABLE
+    { "Arithmetic table",           "Arithmetic", ArithmeticTable,            0,                         0, ARITHMETIC_TABLE },
+    { "Arithmetic table incr.",     "Arithmetic", ArithmeticTableIncremental, sizeof(ArithmeticState_t), 0, ARITHMETIC_TABLE },
+#endif
+#endif
+#ifdef DECOMPRESSOR_USE_RANS
+    { "Rans",                       "Rans",       RansOneShot,                0,                         0, 0 },
+    { "Rans incremental",           "Rans",       RansIncremental,            sizeof(RansState_t),       0, 0 },
+#endif
+#ifdef DECOMPRESSOR_USE_LZ77
+    { "LZ77",                       "Lz77",       LZ77OneShot,                0,                         0, 0 },
+    { "LZ77 incremental",           "Lz77",       LZ77Incremental,            sizeof(LZ77State_t),       1, 0 },
+    { "LZ77 partial",               "Lz77",       LZ77Partial,                sizeof(LZ77State_t),       1, 0 },
+#endif
+#ifdef DECOMPRESSOR_USE_LZCL
+    { "LZCL",                       "Lzcl",       LZCLOneShot,                0,                         0, 0 },
+    { "LZCL incremental",           "Lzcl",       LZCLIncremental,            sizeof(LZCLState_t),       1, 0 },
+    { "LZCL partial",               "Lzcl",       LZCLPartial,                sizeof(LZCLState_t),       1, 0 },
+#ifdef DECOMPRESSOR_USE_SOURCE_READER
+    { "LZCL source reader",         "Lzcl",       LZCLSource,                 sizeof(DecompressSource_t) + DECOMPRESSOR_SOURCE_LINES * SOURCE_LINE, 0, 0 },
+#endif
+#endif
+};
+
+/************************* Measuring ******************************************/
+
+// simple (and weak) checksum
+static uint16_t Fletcher16(const uint8_t *data, int count )
+{
+    uint16_t sum1 = 0;
+    uint16_t sum2 = 0;
+    int index;
+ 
+    for( index = 0; index < count; ++index )
+    {
+       sum1 = (sum1 + data[index]) % 255;
+       sum2 = (sum2 + sum1) % 255;
+    }
+ 
+    return (sum2 << 8) | sum1;
+}
+
+static int CompareUint32(const void * a, const void * b)
+{
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int CompareUint64(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// value at fraction percent of sorted values
+static uint32_t Percentile(const uint32_t * sorted, uint32_t count, uint32_t percent)
+{
+    uint32_t index = (uint32_t)(((uint64_t)count * percent + 99) / 100);
+    if (index > 0)
+        --index;
+    return count == 0 ? 0 : sorted[index];
+}
+
+// lowest stack address painted by PaintStack
+static uintptr_t paintedStack;
+
+// Fill stack below the caller with a pattern
+static NOINLINE void PaintStack()
+{
+    volatile uint8_t area[STACK_PAINT];
+    uint32_t index;
+    for (index = 0; index < STACK_PAINT; ++index)
+        area[index] = STACK_PATTERN;
+    paintedStack = (uintptr_t)area;
+}
+
+// Return bytes of painted stack overwritten since PaintStack, by a call made
+// from the same function. Assumes the stack grows down, as on all common hosts.
+static NOINLINE uint32_t ScanStack()
+{
+    volatile uint8_t * area = (volatile uint8_t*)paintedStack;
+    uint32_t index = 0;
+    while (index < STACK_PAINT && area[index] == STACK_PATTERN)
+        ++index;
+    return STACK_PAINT - index;
+}
+
+// results of one test on one file
+typedef struct
+{
+    uint64_t nanoseconds;
+    uint64_t cycles;
+    uint32_t p50, p99;
+    uint32_t calls;
+    uint32_t stack;
+    int ok;
+} Result_t;
+
+// Run a test repeats times after a warm-up, keep the median time
+static void Measure(const Test_t * test, Run_t * run, const uint8_t * original, uint32_t repeats, uint32_t * latency, Result_t * result)
+{
+    uint64_t * nanoseconds = (uint64_t*)malloc(sizeof(uint64_t) * repeats);
+    uint64_t * cycles = (uint64_t*)malloc(sizeof(uint64_t) * repeats);
+    uint8_t * canaryBuffer = run->dest - 1;
+    uint32_t index, length;
+
+    // warm up caches, branch predictors, and clocks, then check the output
+    canaryBuffer[0] = canaryBuffer[run->destLength + 1] = CANARY;
+    memset(run->dest, 0, run->destLength);
+    length = test->decoder(run);
+    result->ok = length == run->destLength &&
+        memcmp(run->dest, original, run->destLength) == 0 &&
+        canaryBuffer[0] == CANARY && canaryBuffer[run->destLength + 1] == CANARY;
+
+    for (index = 0; index < repeats; ++index)
+    {
+        uint64_t startNanoseconds = ReadNanoseconds();
+        uint64_t startCycles = ReadCycles();
+        test->decoder(run);
+        cycles[index] = ReadCycles() - startCycles;
+        nanoseconds[index] = ReadNanoseconds() - startNanoseconds;
+    }
+    qsort(nanoseconds, repeats, sizeof(uint64_t), CompareUint64);
+    qsort(cycles, repeats, sizeof(uint64_t), CompareUint64);
+    result->nanoseconds = nanoseconds[repeats / 2];
+    result->cycles = cycles[repeats / 2];
+
+    // separate pass for per call latency, since timing each call slows the loop
+    run->latency = latency;
+    run->latencyCount = 0;
+    test->decoder(run);
+    run->latency = 0;
+    qsort(latency, run->latencyCount, sizeof(uint32_t), CompareUint32);
+    result->calls = run->latencyCount;
+    result->p50 = Percentile(latency, run->latencyCount, 50);
+    result->p99 = Percentile(latency, run->latencyCount, 99);
+
+    PaintStack();
+    test->decoder(run);
+    result->stack = ScanStack();
+
+    free(nanoseconds);
+    free(cycles);
+}
+
+void Tally(const char * name, const char * file, uint32_t size, uint32_t decompressedSize, const Test_t * test, const Run_t * run, const Result_t * result)
+{
+    double seconds = result->nanoseconds / 1e9;
+    double mbps = seconds > 0 ? decompressedSize / seconds / 1e6 : 0;
+    double cpb = decompressedSize > 0 ? (double)result->cycles / decompressedSize : 0;
+    uint32_t state = test->stateSize + (test->usesRing ? run->ringLength : 0) + test->tableLength * sizeof(uint32_t);
+
+    printf("%-26s, %-22s, %10u, %10u, %4u%%, ", name, file, size, decompressedSize, decompressedSize ? (uint32_t)(100ULL * size / decompressedSize) : 0);
+    printf("%10.2f, %8.2f, %9u, %9u, %8u, %8u, %7u, ",
+        cpb, mbps, result->p50, result->p99, result->calls, state, result->stack);
+    printf("%s, %8u,\n", result->ok ? "      OK" : "  FAILED", (uint32_t)Fletcher16(run->dest, decompressedSize));
+}
+
+static uint8_t * ReadFile(const char * directory, const char * name, const char * extension, uint32_t * length)
+{
+    char path[1024];
+    FILE * file;
+    uint8_t * data;
+    long size;
+    snprintf(path, sizeof(path), "%s/%s%s", directory, name, extension);
+    file = fopen(path, "rb");
+    if (file == 0)
+        return 0;
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    data = (uint8_t*)malloc(size + 1);
+    if (data != 0 && fread(data, 1, size, file) != (size_t)size)
+    {
+        free(data);
+        data = 0;
+    }
+    fclose(file);
+    *length = (uint32_t)size;
+    return data;
+}
+
+// name part of a corpus path
+static const char * BaseName(const char * path)
+{
+    const char * slash = strrchr(path, '/');
+    return slash ? slash + 1 : path;
+}
+
+void DoTests(const char * corpusDirectory, const char * compressedDirectory, uint32_t repeats, uint32_t ringLength)
+{
+    uint32_t * table = (uint32_t*)malloc(sizeof(uint32_t) * (ARITHMETIC_TABLE > HUFFMAN_TABLE ? ARITHMETIC_TABLE : HUFFMAN_TABLE));
+    uint8_t * ring = (uint8_t*)malloc(ringLength);
+    uint32_t fileIndex, testIndex, failures = 0, skipped = 0;
+
+    // header
+    printf("Codec                     , File                  , start size,   end size, ratio, cycles/byte,     MB/s, p50 cycles, p99 cycles,    calls,    state,   stack, Canaries, Checksum,\n");
+
+    for (fileIndex = 0; fileIndex < sizeof(corpusFiles) / sizeof(corpusFiles[0]); ++fileIndex)
+    {
+        const char * name = corpusFiles[fileIndex];
+        uint32_t originalLength;
+        uint8_t * original = ReadFile(corpusDirectory, name, "", &originalLength);
+        uint8_t * canaryBuffer;
+        uint32_t * latency;
+        if (original == 0)
+        {
+            printf("Missing %s/%s\n", corpusDirectory, name);
+            continue;
+        }
+        // where we decode to, with edge checking canaries
+        canaryBuffer = (uint8_t*)malloc(originalLength + 2);
+        // one entry per call, at most one call per byte plus the end
+        latency = (uint32_t*)malloc(sizeof(uint32_t) * (originalLength + 2));
+
+        for (testIndex = 0; testIndex < sizeof(tests) / sizeof(tests[0]); ++testIndex)
+        {
+            const Test_t * test = tests + testIndex;
+            char extension[32];
+            uint32_t sourceLength;
+            uint8_t * source;
+            Run_t run;
+            Result_t result;
+
+            snprintf(extension, sizeof(extension), ".%s", test->codec);
+            source = ReadFile(compressedDirectory, BaseName(name), extension, &sourceLength);
+            if (source == 0)
+            {
+                printf("%-26s, %-22s, missing %s/%s%s\n", test->name, BaseName(name), compressedDirectory, BaseName(name), extension);
+                continue;
+            }
+            if (sourceLength > DECOMPRESSOR_MAX_STREAM_BYTES)
+            {
+                // too long for the bit positions of this build, see DECOMPRESSOR_COMPACT_STATE
+                printf("%-26s, %-22s, %10u, skipped, over %u bytes\n", test->name, BaseName(name), sourceLength, DECOMPRESSOR_MAX_STREAM_BYTES);
+                ++skipped;
+                free(source);
+                continue;
+            }
+
+            memset(&run, 0, sizeof(run));
+            run.source = source;
+            run.sourceLength = sourceLength;
+            run.dest = canaryBuffer + 1;
+            run.destLength = originalLength;
+            run.ring = ring;
+            run.ringLength = ringLength;
+            run.table = table;
+
+            Measure(test, &run, original, repeats, latency, &result);
+            Tally(test->name, BaseName(name), sourceLength, originalLength, test, &run, &result);
+            failures += result.ok ? 0 : 1;
+            free(source);
+        }
+        free(latency);
+        free(canaryBuffer);
+        free(original);
+    }
+    printf("%u failures\n", failures);
+    if (skipped != 0)
+        printf("%u skipped\n", skipped);
+    free(ring);
+    free(table);
+}
+
+int main(int argc, char ** argv)
+{
+    uint32_t repeats = 5, ringLength = 8192;
+    int index;
+    if (argc < 3)
+    {
+        printf("usage: HostBenchmark corpusDir compressedDir [-n repeats] [-r ringSize]\n");
+        printf("    compressedDir holds file.Huffman, file.Arithmetic, file.Rans, file.Lz77, file.Lzcl\n");
+        printf("    ringSize is the incremental LZ77 and LZCL buffer, at least maxDist + maxLen + 1\n");
+        return 1;
+    }
+    for (index = 3; index + 1 < argc; index += 2)
+    {
+        if (strcmp(argv[index], "-n") == 0)
+            repeats = (uint32_t)atoi(argv[index + 1]);
+        else if (strcmp(argv[index], "-r") == 0)
+            ringLength = (uint32_t)atoi(argv[index + 1]);
+    }
+    if (repeats < 1)
+        repeats = 1;
+    if (ringLength < 2)
+        ringLength = 2;
+    DoTests(argv[1], argv[2], repeats, ringLength);
+    return 0;
+}
@@ -24,8 +24,23 @@ SOFTWARE.
 // reference decompressor for Chris Lomont tiny decompression library
 #include <inttypes.h>
 #include <string.h> // for memset
+#include <stddef.h> // for offsetof
 #include "Decompressor.h"
 
+// pick a 16 byte vector unit with a byte shuffle for LZ run copies, if the target has one
+#ifdef DECOMPRESSOR_USE_SIMD
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define LZ_SIMD_SSSE3
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h> // for __cpuid
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define LZ_SIMD_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
 /************************* utility functions **********************************/
 
 // Count number of ones set in value
@@ -62,24 +77,284 @@ static uint32_t BitsRequired(uint32_t value)
 	return 1 + FloorLog2(value);
 }
 
+/************************* instrumentation ************************************/
+
+#ifdef DECOMPRESSOR_STATS
+DecompressorStats_t decompressorStats;
+
+// add n to a counter
+#define DECOMPRESSOR_COUNT(field, n) (decompressorStats.field += (n))
+
+// count a run in the match histograms
+static void CountLZMatch(uint32_t distance, uint32_t length)
+{
+	uint32_t bucket = FloorLog2(length);
+	decompressorStats.matches++;
+	decompressorStats.matchBytes += length;
+	decompressorStats.matchLengths[bucket < 32 ? bucket : 31]++;
+	bucket = FloorLog2(distance + 1);
+	decompressorStats.matchDistances[bucket < 32 ? bucket : 31]++;
+}
+#define DECOMPRESSOR_COUNT_MATCH(distance, length) CountLZMatch(distance, length)
+#else
+#define DECOMPRESSOR_COUNT(field, n) ((void)0)
+#define DECOMPRESSOR_COUNT_MATCH(distance, length) ((void)0)
+#endif
+
+EXPORT_WIN32 uint32_t DecompressGetStats(DecompressorStats_t * stats)
+{
+#ifdef DECOMPRESSOR_STATS
+	*stats = decompressorStats;
+	return 1;
+#else
+	memset(stats, 0, sizeof(DecompressorStats_t));
+	return 0;
+#endif
+}
+
+EXPORT_WIN32 void DecompressResetStats(void)
+{
+#ifdef DECOMPRESSOR_STATS
+	memset(&decompressorStats, 0, sizeof(DecompressorStats_t));
+#endif
+}
+
 /************************* bitstream implementation ***************************/
 
+// Return 1 if a stream of byteLength bytes can be decoded, 0 if too long
+// for the bit positions, see DECOMPRESSOR_COMPACT_STATE
+static uint32_t BitstreamFits(int32_t byteLength)
+{
+#ifdef DECOMPRESSOR_COMPACT_STATE
+	return (uint32_t)byteLength <= DECOMPRESSOR_MAX_STREAM_BYTES;
+#else
+	(void)byteLength;
+	return 1;
+#endif
+}
+
+#ifdef DECOMPRESSOR_USE_SOURCE_READER
+
+// tag of an empty cache line
+#define SOURCE_NO_LINE (~(uintptr_t)0)
+
+// sources from DecompressAddSource, latest first
+static DecompressSource_t * decompressSources = 0;
+
+EXPORT_WIN32 uint32_t DecompressAddSource(DecompressSource_t * source, const uint8_t * base, uint32_t length, DecompressRead_t read, void * context, uint8_t * lines, uint32_t lineSize)
+{
+	uint32_t i;
+	if (lineSize == 0 || (lineSize & (lineSize - 1)) != 0)
+		return 0;
+	source->base = base;
+	source->length = length;
+	source->read = read;
+	source->context = context;
+	source->lines = lines;
+	source->lineSize = lineSize;
+	for (i = 0; i < DECOMPRESSOR_SOURCE_LINES; ++i)
+		source->tags[i] = SOURCE_NO_LINE;
+	source->last = source->next = 0;
+	source->nextSource = decompressSources;
+	decompressSources = source;
+	return 1;
+}
+
+EXPORT_WIN32 void DecompressRemoveSource(DecompressSource_t * source)
+{
+	DecompressSource_t ** link = &decompressSources;
+	while (*link != 0 && *link != source)
+		link = &(*link)->nextSource;
+	if (*link != 0)
+		*link = source->nextSource;
+}
+
+// Source holding data, or 0 if it is in memory
+static DecompressSource_t * FindSource(const void * data)
+{
+	DecompressSource_t * source;
+	for (source = decompressSources; source != 0; source = source->nextSource)
+		if ((uintptr_t)data - (uintptr_t)source->base < source->length)
+			return source;
+	return 0;
+}
+
+// Byte at address through the source lines, reading a line on a miss
+static uint8_t ReadSourceByte(DecompressSource_t * source, const uint8_t * address)
+{
+	uintptr_t line = (uintptr_t)address & ~(uintptr_t)(source->lineSize - 1);
+	uint32_t i = source->last;
+	if (source->tags[i] != line)
+	{
+		for (i = 0; i < DECOMPRESSOR_SOURCE_LINES; ++i)
+			if (source->tags[i] == line)
+				break;
+		if (i == DECOMPRESSOR_SOURCE_LINES)
+		{
+			// replace lines in turn, reading only bytes inside the data
+			uintptr_t start = line, end = line + source->lineSize;
+			uintptr_t first = (uintptr_t)source->base, last = first + source->length;
+			if (start < first)
+				start = first;
+			if (end > last)
+				end = last;
+			i = source->next;
+			source->next = (i + 1) & (DECOMPRESSOR_SOURCE_LINES - 1);
+			source->tags[i] = line;
+			if (start < end)
+				source->read(source->context, (const uint8_t *)start, source->lines + i * source->lineSize + (start - line), (uint32_t)(end - start));
+		}
+		source->last = i;
+	}
+	return source->lines[i * source->lineSize + ((uintptr_t)address - line)];
+}
+
+// byte index of a bitstream's data
+#define BITSTREAM_BYTE(bitstream, index) ((bitstream)->source != 0 ? \
+	ReadSourceByte((bitstream)->source, (const uint8_t *)(bitstream)->data + (index)) : \
+	((const uint8_t *)(bitstream)->data)[index])
+#else
+#define BITSTREAM_BYTE(bitstream, index) (((const uint8_t *)(bitstream)->data)[index])
+#endif
+
 // Initialize a bitstream to read from the given position
-static void InitializeBitstream(Bitstream_t * bitstream, const void * data)
+// Longer data than positions can reach is cut to DECOMPRESSOR_MAX_STREAM_BYTES
+static void InitializeBitstream(Bitstream_t * bitstream, const void * data, uint32_t byteLength)
 {
 	bitstream->data = data;
+#ifdef DECOMPRESSOR_USE_SOURCE_READER
+	bitstream->source = FindSource(data);
+#endif
 	bitstream->position = 0;
+	bitstream->byteLength = (BitstreamPosition_t)(byteLength < DECOMPRESSOR_MAX_STREAM_BYTES ? byteLength : DECOMPRESSOR_MAX_STREAM_BYTES);
+#ifdef DECOMPRESSOR_FAST_BITSTREAM
+	bitstream->cache = 0;
+	bitstream->cacheBits = 0;
+#endif
+}
+
+#ifdef DECOMPRESSOR_FAST_BITSTREAM
+
+#define BITSTREAM_CACHE_BITS (8 * sizeof(BitstreamCache_t))
+
+// Fill the cache with as many whole bytes as fit
+static void RefillBitstream(Bitstream_t * bitstream)
+{
+	uint32_t index;
+	if (bitstream->cacheBits == 0)
+	{
+		// may start mid byte, so load the first byte and drop bits already read
+		uint32_t skip = bitstream->position & 7;
+		index = bitstream->position / 8;
+		bitstream->cache = index < bitstream->byteLength ? BITSTREAM_BYTE(bitstream, index) : 0;
+		bitstream->cache <<= BITSTREAM_CACHE_BITS - 8 + skip;
+		bitstream->cacheBits = 8 - skip;
+	}
+	// position + cacheBits is now byte aligned
+	while (bitstream->cacheBits <= BITSTREAM_CACHE_BITS - 8)
+	{
+		BitstreamCache_t b;
+		index = (bitstream->position + bitstream->cacheBits) / 8;
+		b = index < bitstream->byteLength ? BITSTREAM_BYTE(bitstream, index) : 0;
+		bitstream->cache |= b << (BITSTREAM_CACHE_BITS - 8 - bitstream->cacheBits);
+		bitstream->cacheBits += 8;
+	}
+}
+
+// Look at the next bitLength bits, MSB first, without consuming them
+// bitLength must be at most BITSTREAM_CACHE_BITS - 7
+static uint32_t PeekBitstream(Bitstream_t * bitstream, uint32_t bitLength)
+{
+	if (bitLength == 0)
+		return 0;
+	if (bitstream->cacheBits < bitLength)
+		RefillBitstream(bitstream);
+	return (uint32_t)(bitstream->cache >> (BITSTREAM_CACHE_BITS - bitLength));
+}
+
+// Consume bits already obtained from PeekBitstream
+static void ConsumeBitstream(Bitstream_t * bitstream, uint32_t bitLength)
+{
+	DECOMPRESSOR_COUNT(bitsRead, bitLength);
+	bitstream->cache <<= bitLength;
+	bitstream->cacheBits -= bitLength;
+	bitstream->position += bitLength;
+}
+
+// Read values from current position, MSB first
+static uint32_t ReadBitstream(Bitstream_t * bitstream, uint32_t bitLength)
+{
+	uint32_t value;
+	if (bitLength > BITSTREAM_CACHE_BITS - 7)
+	{
+		// too long for one refill, split it
+		value = ReadBitstream(bitstream, bitLength - 16) << 16;
+		return value | ReadBitstream(bitstream, 16);
+	}
+	value = PeekBitstream(bitstream, bitLength);
+	ConsumeBitstream(bitstream, bitLength);
+	return value;
+}
+
+// Move current position forward
+static void SkipBitstream(Bitstream_t * bitstream, uint32_t bitLength)
+{
+	if (bitLength < bitstream->cacheBits)
+		ConsumeBitstream(bitstream, bitLength);
+	else
+	{
+		bitstream->position += bitLength;
+		bitstream->cache = 0;
+		bitstream->cacheBits = 0;
+	}
+}
+
+// Move current position to the given bit position
+static void SetBitstreamPosition(Bitstream_t * bitstream, uint32_t position)
+{
+	if (position >= bitstream->position)
+		SkipBitstream(bitstream, position - bitstream->position);
+	else
+	{
+		bitstream->position = position;
+		bitstream->cache = 0;
+		bitstream->cacheBits = 0;
+	}
+}
+
+// Read values from given position, update it, MSB first
+// Does not use or change the cache, so is good for random access
+static uint32_t ReadFromBitstreamPosition(Bitstream_t * bitstream, uint32_t * position, uint32_t bitLength)
+{
+	BitstreamCache_t value = 0;
+	uint32_t index, end;
+	if (bitLength > BITSTREAM_CACHE_BITS - 7)
+	{
+		// too long to assemble at once, split it
+		value = ReadFromBitstreamPosition(bitstream, position, bitLength - 16) << 16;
+		return (uint32_t)value | ReadFromBitstreamPosition(bitstream, position, 16);
+	}
+	DECOMPRESSOR_COUNT(bitsRead, bitLength);
+	index = *position / 8;
+	end = (*position + bitLength + 7) / 8;
+	for (; index < end; ++index)
+		value = (value << 8) | (index < bitstream->byteLength ? BITSTREAM_BYTE(bitstream, index) : 0);
+	value >>= end * 8 - *position - bitLength;
+	*position += bitLength;
+	return (uint32_t)value & (uint32_t)((((BitstreamCache_t)1) << bitLength) - 1);
 }
 
+#else
+
 // Read values from current position, MSB first
 static uint32_t ReadBitstream(Bitstream_t * bitstream, uint32_t bitLength)
 {
 	uint32_t value = 0, i;
-	const uint8_t * bits = bitstream->data;
+	DECOMPRESSOR_COUNT(bitsRead, bitLength);
 	for (i = 0; i < bitLength; ++i)
 	{
 		uint32_t pos = bitstream->position;
-		uint32_t b1 = bits[pos / 8];
+		uint32_t b1 = BITSTREAM_BYTE(bitstream, pos / 8);
 		uint32_t b = ((b1 >> (7 - (pos & 7))) & 1);
 		bitstream->position++;
 		value <<= 1;
@@ -88,6 +363,39 @@ static uint32_t ReadBitstream(Bitstream_t * bitstream, uint32_t bitLength)
 	return value;
 }
 
+// Move current position forward
+static void SkipBitstream(Bitstream_t * bitstream, uint32_t bitLength)
+{
+	bitstream->position += bitLength;
+}
+
+// Look at the next bitLength bits, MSB first, without consuming them
+// Bits past the end of the data read as 0
+static uint32_t PeekBitstream(Bitstream_t * bitstream, uint32_t bitLength)
+{
+	uint32_t value = 0, i, pos = bitstream->position;
+	for (i = 0; i < bitLength; ++i, ++pos)
+	{
+		value <<= 1;
+		if (pos / 8 < bitstream->byteLength)
+			value |= (BITSTREAM_BYTE(bitstream, pos / 8) >> (7 - (pos & 7))) & 1;
+	}
+	return value;
+}
+
+// Consume bits already obtained from PeekBitstream
+static void ConsumeBitstream(Bitstream_t * bitstream, uint32_t bitLength)
+{
+	DECOMPRESSOR_COUNT(bitsRead, bitLength);
+	bitstream->position += bitLength;
+}
+
+// Move current position to the given bit position
+static void SetBitstreamPosition(Bitstream_t * bitstream, uint32_t position)
+{
+	bitstream->position = position;
+}
+
 // Read values from given position, update it, MSB first
 static uint32_t ReadFromBitstreamPosition(Bitstream_t * bitstream, uint32_t * position, uint32_t bitLength)
 {
@@ -99,6 +407,7 @@ static uint32_t ReadFromBitstreamPosition(Bitstream_t * bitstream, uint32_t * po
 	return value;
 }
 
+#endif // DECOMPRESSOR_FAST_BITSTREAM
 
 /************************* universal coding implementation ********************/
 
@@ -126,15 +435,55 @@ static uint32_t DecodeUniversalLomont1(Bitstream_t * bitstream, int chunkSize, i
 }
 
 
+#ifdef DECOMPRESSOR_USE_INTERLEAVED
+
+// most interleaved streams, matching CodecBase.MaxInterleavedStreams
+#define DECOMPRESSOR_MAX_STREAMS 4
+
+// Read the bit length of each interleaved stream, which start right after them.
+// Fills in the bit position and length of each stream.
+static void ReadInterleavedStreams(Bitstream_t * bitstream, uint32_t streamCount, uint32_t * positions, uint32_t * lengths)
+{
+	uint32_t i, position;
+	for (i = 0; i < streamCount; ++i)
+		lengths[i] = DecodeUniversalLomont1(bitstream, 8, -1);
+	position = bitstream->position;
+	for (i = 0; i < streamCount; ++i)
+	{
+		positions[i] = position;
+		position += lengths[i];
+	}
+}
+
+// Interleaved streams start with a symbol count of 0, so the single stream
+// decoders decode nothing, then the real header. Return 1 if the mark is there.
+static uint32_t ReadInterleavedMark(Bitstream_t * bitstream)
+{
+	return DecodeUniversalLomont1(bitstream, 6, 0) == 0;
+}
+#endif
+
 /************************* Universal compression header ***********************/
 
 // get size of decompressed stream
 uint32_t GetDecompressedSize(const uint8_t * source)
 {
 	Bitstream_t bitstream;
-	InitializeBitstream(&bitstream, source);
+	InitializeBitstream(&bitstream, source, 0xFFFFFFFF); // length unknown, header is at the start
+	return DecodeUniversalLomont1(&bitstream, 6, 0); // number of bytes to decompress
+}
+
+#ifdef DECOMPRESSOR_USE_INTERLEAVED
+// get size of a decompressed interleaved Huffman or Arithmetic stream
+uint32_t GetInterleavedDecompressedSize(const uint8_t * source)
+{
+	Bitstream_t bitstream;
+	InitializeBitstream(&bitstream, source, 0xFFFFFFFF); // length unknown, header is at the start
+	if (!ReadInterleavedMark(&bitstream))
+		return 0;
 	return DecodeUniversalLomont1(&bitstream, 6, 0); // number of bytes to decompress
 }
+#endif
 
 
 /************************* Huffman coding implementation **********************/
@@ -152,10 +501,8 @@ static void ParseHuffmanTable(HuffmanState_t * state)
 	for (length = state->minCodewordLength; length <= state->maxCodewordLength; ++length)
 	{
 		uint32_t count = ReadBitstream(&state->bitstream, state->bitsPerCodelengthCount);
-		// read symbols - todo - simply add to position
-		uint32_t symbolIndex;
-		for (symbolIndex = 0; symbolIndex < count; ++symbolIndex)
-			ReadBitstream(&state->bitstream, state->bitsPerSymbol);
+		// skip symbols
+		SkipBitstream(&state->bitstream, count * state->bitsPerSymbol);
 	}
 }
 
@@ -173,33 +520,21 @@ static void ReadHuffmanHeaderNoLength(HuffmanState_t * state)
 	uint32_t deltaCodewordLength = 1 + DecodeUniversalLomont1(&state->bitstream, 4, -1);  // 9-12, up to 16,17
 
 	state->maxCodewordLength = (uint8_t)(state->minCodewordLength + deltaCodewordLength);
+#ifdef DECOMPRESSOR_USE_HUFFMAN_TABLE
+	state->lookupBits = 0; // no lookup table unless one is built
+	state->lookupPairs = 0;
+#endif
 	ParseHuffmanTable(state);
 }
 
-// Call after starting decompression with DecompressHuffmanStart to get individual symbols
-// decompress a symbol 0-255. Returns CL_COMPRESSOR_END_TOKEN when no more
-EXPORT_WIN32 uint32_t DecompressHuffmanSymbol(HuffmanState_t * state)
+// Walk the codeword table in the stream to finish decoding a symbol
+// accumulator holds codeword bits read so far, the length of the row at tableIndex, 
+// and firstCodewordOnRow is the first codeword on that row 
+static uint32_t WalkHuffmanTable(HuffmanState_t * state, uint32_t accumulator, uint32_t firstCodewordOnRow, uint32_t tableIndex)
 {
-	if (state->byteLength == 0)
-		return CL_COMPRESSOR_END_TOKEN;
-	if (state->byteLength != 0xFFFFFFFF)
-		state->byteLength--;
-	// items for walking the table
-	uint32_t accumulator = 0;        // store bits read in until matches a codeword
-	uint32_t firstCodewordOnRow = 0; // first codeword on the current table entry
-
-									 // read min number of bits
-	uint32_t i;
-	for (i = 0; i < state->minCodewordLength; ++i)
-	{
-		accumulator = 2 * accumulator + ReadBitstream(&state->bitstream, 1); // accumulate bits
-		firstCodewordOnRow <<= 1;
-	}
-
-	uint32_t tableIndex = state->tablePosition; // decoding table starts here
 	while (1)
 	{
-
+		DECOMPRESSOR_COUNT(huffmanRows, 1);
 		uint32_t numberOfCodes = ReadFromBitstreamPosition(&state->bitstream, &tableIndex, state->bitsPerCodelengthCount);
 
 		if (numberOfCodes > 0 && accumulator - firstCodewordOnRow < numberOfCodes)
@@ -218,36 +553,307 @@ EXPORT_WIN32 uint32_t DecompressHuffmanSymbol(HuffmanState_t * state)
 	}
 }
 
+// Decode one codeword, without checking the byte length
+static uint32_t DecodeHuffmanCodeword(HuffmanState_t * state)
+{
+#ifdef DECOMPRESSOR_USE_HUFFMAN_TABLE
+	if (state->lookupBits != 0)
+	{
+		uint32_t index = PeekBitstream(&state->bitstream, state->lookupBits);
+		uint32_t entry = state->lookup[index];
+		if (entry != 0)
+		{
+			DECOMPRESSOR_COUNT(huffmanTableHits, 1);
+			ConsumeBitstream(&state->bitstream, entry & 31);
+			return state->lookupPairs ? (entry >> 5) & 255 : entry >> 5;
+		}
+		// codeword longer than table, resume walking the stream table
+		ConsumeBitstream(&state->bitstream, state->lookupBits);
+		index = 2 * index + ReadBitstream(&state->bitstream, 1);
+		return WalkHuffmanTable(state, index, state->lookupFirstCodeword, state->lookupTablePosition);
+	}
+#endif
+
+	// read min number of bits, walk table from the start
+	uint32_t accumulator = ReadBitstream(&state->bitstream, state->minCodewordLength);
+	return WalkHuffmanTable(state, accumulator, 0, state->tablePosition);
+}
+
+// Call after starting decompression with DecompressHuffmanStart to get individual symbols
+// decompress a symbol 0-255. Returns CL_COMPRESSOR_END_TOKEN when no more
+EXPORT_WIN32 uint32_t DecompressHuffmanSymbol(HuffmanState_t * state)
+{
+	if (state->byteLength == 0)
+		return CL_COMPRESSOR_END_TOKEN;
+	if (state->byteLength != 0xFFFFFFFF)
+		state->byteLength--;
+	return DecodeHuffmanCodeword(state);
+}
+
+// Call after starting decompression with DecompressHuffmanStart to decode
+// up to maxBytes symbols into out. Returns number written, 0 when done.
+// Checks the byte length once per call, and with a pair table decodes two
+// short codewords per lookup.
+EXPORT_WIN32 uint32_t DecompressHuffmanBlock(HuffmanState_t * state, uint8_t * out, uint32_t maxBytes)
+{
+	uint32_t count = 0;
+	if (state->byteLength != 0xFFFFFFFF)
+	{
+		if (maxBytes > state->byteLength)
+			maxBytes = state->byteLength;
+		state->byteLength -= maxBytes;
+	}
+#ifdef DECOMPRESSOR_USE_HUFFMAN_TABLE
+	if (state->lookupPairs)
+	{
+		while (count + 2 <= maxBytes)
+		{
+			uint32_t entry = state->lookup[PeekBitstream(&state->bitstream, state->lookupBits)];
+			if (entry != 0)
+			{
+				// always store both, the second is overwritten when not paired
+				DECOMPRESSOR_COUNT(huffmanTableHits, 1);
+				ConsumeBitstream(&state->bitstream, (entry >> 21) & 31);
+				out[count] = (uint8_t)(entry >> 5);
+				out[count + 1] = (uint8_t)(entry >> 13);
+				count += 1 + (entry >> 26);
+			}
+			else
+				out[count++] = (uint8_t)DecodeHuffmanCodeword(state);
+		}
+	}
+#endif
+	while (count < maxBytes)
+		out[count++] = (uint8_t)DecodeHuffmanCodeword(state);
+	return count;
+}
+
+#ifdef DECOMPRESSOR_USE_HUFFMAN_TABLE
+// Fill in lookup table from the codeword table in the stream
+// Codewords of length at most lookupBits are entered directly, 
+// longer ones leave their prefix entries 0
+static void BuildHuffmanLookup(HuffmanState_t * state, uint32_t * table)
+{
+	uint32_t tableIndex = state->tablePosition;
+	uint32_t codeword = 0; // first codeword on the current row
+	uint32_t length;
+	memset(table, 0, sizeof(uint32_t) << state->lookupBits);
+	for (length = state->minCodewordLength; length <= state->lookupBits; ++length)
+	{
+		uint32_t numberOfCodes = ReadFromBitstreamPosition(&state->bitstream, &tableIndex, state->bitsPerCodelengthCount);
+		uint32_t shift = state->lookupBits - length, i, j;
+		for (i = 0; i < numberOfCodes; ++i)
+		{
+			uint32_t entry = (ReadFromBitstreamPosition(&state->bitstream, &tableIndex, state->bitsPerSymbol) << 5) | length;
+			// every index starting with this codeword decodes to it
+			uint32_t first = (codeword + i) << shift;
+			for (j = 0; j < (1U << shift); ++j)
+				table[first + j] = entry;
+		}
+		codeword = (codeword + numberOfCodes) << 1;
+	}
+	state->lookupTablePosition = tableIndex;
+	state->lookupFirstCodeword = codeword;
+	state->lookup = table;
+}
+
+// Add a second codeword to each lookup entry where both fit in lookupBits
+// Needs bitsPerSymbol <= 8. Pair entries keep the single entry in the low 13 bits, 
+// then the second symbol in bits 13-20, bits to consume in bits 21-25, and 
+// bit 26 set when there are two symbols. 
+// The low bits are never changed, so entries are paired in place.
+static void PairHuffmanLookup(HuffmanState_t * state, uint32_t * table)
+{
+	uint32_t mask = (1U << state->lookupBits) - 1, index;
+	for (index = 0; index <= mask; ++index)
+	{
+		uint32_t first = table[index] & 0x1FFF;
+		uint32_t firstLength = first & 31;
+		if (first == 0)
+			continue; // long codeword
+		// entry for the bits after the first codeword, zero filled
+		uint32_t second = table[(index << firstLength) & mask] & 0x1FFF;
+		uint32_t pairLength = firstLength + (second & 31);
+		if (firstLength < state->lookupBits && second != 0 && pairLength <= state->lookupBits)
+			table[index] |= ((second >> 5) << 13) | (pairLength << 21) | (1U << 26);
+		else
+			table[index] |= firstLength << 21;
+	}
+	state->lookupPairs = 1;
+}
+#endif
+
 // Partial call decompression
 // start decompression, follow up with DecompressHuffmanSymbol until done
 EXPORT_WIN32 void DecompressHuffmanStart(HuffmanState_t * state, const uint8_t * source, int32_t sourceLength)
 {
-	InitializeBitstream(&state->bitstream, source);
+	InitializeBitstream(&state->bitstream, source, (uint32_t)sourceLength);
 	// size header
 	state->byteLength = DecodeUniversalLomont1(&state->bitstream, 6, 0); // number of bytes to decompress
+	if (state->byteLength == 0)
+	{
+		// no table is stored, or this is the mark of an interleaved stream,
+		// so leave an empty table with no codeword lengths
+		state->bitsPerSymbol = state->bitsPerCodelengthCount = 1;
+		state->minCodewordLength = 1;
+		state->maxCodewordLength = 0;
+#ifdef DECOMPRESSOR_USE_HUFFMAN_TABLE
+		state->lookupBits = 0;
+		state->lookupPairs = 0;
+#endif
+		state->tablePosition = 0;
+		return;
+	}
 	ReadHuffmanHeaderNoLength(state);
+	if (!BitstreamFits(sourceLength))
+		state->byteLength = 0;
+}
+
+// decode bytes from a started state, return bytes decoded
+static int32_t DecodeHuffmanBytes(HuffmanState_t * state, uint8_t * dest, int32_t destLength)
+{
+	if (destLength <= 0)
+		return 0;
+	return (int32_t)DecompressHuffmanBlock(state, dest, (uint32_t)destLength);
+}
+
+#ifdef DECOMPRESSOR_USE_HUFFMAN_TABLE
+// Build a lookup table for a state whose header is read, if the table is big enough
+static void UseHuffmanLookup(HuffmanState_t * state, uint32_t * table, uint32_t tableLength)
+{
+	// largest power of two table that fits, no wider than the longest codeword
+	uint32_t bits = tableLength == 0 ? 0 : FloorLog2(tableLength);
+	if (bits > state->maxCodewordLength)
+		bits = state->maxCodewordLength;
+	// symbol must fit in entry, and table must hold some codewords
+	if (state->bitsPerSymbol <= 27 && state->minCodewordLength <= bits)
+	{
+		state->lookupBits = (uint8_t)bits;
+		BuildHuffmanLookup(state, table);
+	}
+}
+
+// Partial call decompression using a lookup table for speed
+// Like DecompressHuffmanStart, but builds a lookup table in the caller supplied 
+// table of tableLength entries, which must live as long as the state. 
+EXPORT_WIN32 void DecompressHuffmanStartFast(HuffmanState_t * state, const uint8_t * source, int32_t sourceLength, uint32_t * table, uint32_t tableLength)
+{
+	DecompressHuffmanStart(state, source, sourceLength);
+	UseHuffmanLookup(state, table, tableLength);
+}
+
+// Return table entries letting DecompressHuffmanStartFast decode every codeword 
+// with one lookup, 2^(longest codeword length). Compress with maxCode to bound it.
+EXPORT_WIN32 uint32_t DecompressHuffmanTableLength(const uint8_t * source, int32_t sourceLength)
+{
+	HuffmanState_t state;
+	DecompressHuffmanStart(&state, source, sourceLength);
+	return 1U << state.maxCodewordLength;
+}
+
+// Like DecompressHuffmanStartFast, but also pairs table entries so
+// DecompressHuffmanBlock decodes two short codewords per lookup.
+// Pairs only for symbols of at most 8 bits, else same as DecompressHuffmanStartFast.
+EXPORT_WIN32 void DecompressHuffmanStartPairs(HuffmanState_t * state, const uint8_t * source, int32_t sourceLength, uint32_t * table, uint32_t tableLength)
+{
+	DecompressHuffmanStartFast(state, source, sourceLength, table, tableLength);
+	if (state->lookupBits != 0 && state->bitsPerSymbol <= 8)
+		PairHuffmanLookup(state, table);
 }
 
+// decompress using a lookup table, return bytes decoded
+EXPORT_WIN32 int32_t DecompressHuffmanFast(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, uint32_t * table, uint32_t tableLength)
+{
+	HuffmanState_t state;
+	DecompressHuffmanStartPairs(&state, source, sourceLength, table, tableLength);
+	return DecodeHuffmanBytes(&state, dest, destLength);
+}
+#endif
 
 // decompress, return bytes decoded
 EXPORT_WIN32 int32_t DecompressHuffman(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength)
 {
 	HuffmanState_t state;
 	DecompressHuffmanStart(&state, source, sourceLength);
+	return DecodeHuffmanBytes(&state, dest, destLength);
+}
 
-	// now decode bytes
-	uint32_t byteIndex = 0;
+#ifdef DECOMPRESSOR_USE_INTERLEAVED
+// decompress data compressed with streams=2-4, return bytes decoded
+EXPORT_WIN32 int32_t DecompressHuffmanInterleaved(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, uint32_t * table, uint32_t tableLength)
+{
+	// one state per stream, sharing the codeword table
+	HuffmanState_t states[DECOMPRESSOR_MAX_STREAMS];
+	uint32_t positions[DECOMPRESSOR_MAX_STREAMS], lengths[DECOMPRESSOR_MAX_STREAMS];
+	uint32_t streamCount, count, index = 0, stream;
+
+	InitializeBitstream(&states[0].bitstream, source, (uint32_t)sourceLength);
+	if (!ReadInterleavedMark(&states[0].bitstream))
+		return 0;
+	states[0].byteLength = DecodeUniversalLomont1(&states[0].bitstream, 6, 0);
+	streamCount = 1 + DecodeUniversalLomont1(&states[0].bitstream, 2, 0);
+	if (states[0].byteLength == 0 || streamCount > DECOMPRESSOR_MAX_STREAMS || destLength <= 0 || !BitstreamFits(sourceLength))
+		return 0;
+	ReadHuffmanHeaderNoLength(&states[0]);
+#ifdef DECOMPRESSOR_USE_HUFFMAN_TABLE
+	UseHuffmanLookup(&states[0], table, tableLength);
+#else
+	(void)table;
+	(void)tableLength;
+#endif
+	ReadInterleavedStreams(&states[0].bitstream, streamCount, positions, lengths);
+	for (stream = 0; stream < streamCount; ++stream)
+	{
+		states[stream] = states[0];
+		SetBitstreamPosition(&states[stream].bitstream, positions[stream]);
+	}
+
+	count = states[0].byteLength < (uint32_t)destLength ? states[0].byteLength : (uint32_t)destLength;
+	// symbol index goes to stream index % streamCount, unrolled so the compiler sees independent decodes
+	if (streamCount == 4)
+		for (; index + 4 <= count; index += 4)
+		{
+			dest[index] = (uint8_t)DecodeHuffmanCodeword(&states[0]);
+			dest[index + 1] = (uint8_t)DecodeHuffmanCodeword(&states[1]);
+			dest[index + 2] = (uint8_t)DecodeHuffmanCodeword(&states[2]);
+			dest[index + 3] = (uint8_t)DecodeHuffmanCodeword(&states[3]);
+		}
+	else if (streamCount == 2)
+		for (; index + 2 <= count; index += 2)
+		{
+			dest[index] = (uint8_t)DecodeHuffmanCodeword(&states[0]);
+			dest[index + 1] = (uint8_t)DecodeHuffmanCodeword(&states[1]);
+		}
+	for (; index + streamCount <= count; index += streamCount)
+		for (stream = 0; stream < streamCount; ++stream)
+			dest[index + stream] = (uint8_t)DecodeHuffmanCodeword(&states[stream]);
+	for (stream = 0; index < count; ++index, ++stream)
+		dest[index] = (uint8_t)DecodeHuffmanCodeword(&states[stream]);
+	return (int32_t)count;
+}
+#endif
 
-	while (state.byteLength != 0 && byteIndex < (uint32_t)destLength)
+// Call after starting decompression with DecompressHuffmanStart to send all remaining
+// symbols to sink in spans of up to chunk bytes. Returns number of bytes sent.
+EXPORT_WIN32 uint32_t DecompressHuffmanToSink(HuffmanState_t * state, DecompressSink_t sink, void * context, uint32_t chunk)
+{
+	uint8_t buffer[DECOMPRESSOR_SINK_BUFFER];
+	uint32_t index = 0, count;
+	if (chunk == 0 || chunk > DECOMPRESSOR_SINK_BUFFER)
+		chunk = DECOMPRESSOR_SINK_BUFFER;
+	while ((count = DecompressHuffmanBlock(state, buffer, chunk)) != 0)
 	{
-		uint32_t symbol = DecompressHuffmanSymbol(&state);
-		if (symbol == CL_COMPRESSOR_END_TOKEN)
-			break;
-		dest[byteIndex] = symbol;
-		++byteIndex;
+		sink(context, buffer, count, index);
+		index += count;
 	}
+	return index;
+}
 
-	return (int32_t)byteIndex;
+// Call after starting decompression with DecompressHuffmanStart to decode
+// up to maxBytes symbols into out. Returns number written, 0 when done.
+EXPORT_WIN32 uint32_t DecompressHuffmanPartial(HuffmanState_t * state, uint8_t * out, uint32_t maxBytes)
+{
+	return DecompressHuffmanBlock(state, out, maxBytes);
 }
 
 #endif // DECOMPRESSOR_USE_HUFFMAN
@@ -264,10 +870,11 @@ EXPORT_WIN32 int32_t DecompressHuffman(const uint8_t * source, int32_t sourceLen
 
 static uint32_t ReadArithmeticBistream(ArithmeticState_t * state, uint32_t bitCount)
 {
+	// stops counting at the end, so the count cannot wrap
+	if (state->bitsRead + 1U >= state->bitLength)
+		return 0;
 	state->bitsRead++;
-	if (state->bitsRead < state->bitLength)
-		return ReadBitstream(&state->bitstream, bitCount);
-	return 0;
+	return ReadBitstream(&state->bitstream, bitCount);
 }
 
 static void DecodeArithmeticTable(ArithmeticState_t * state)
@@ -282,17 +889,32 @@ static void DecodeArithmeticTable(ArithmeticState_t * state)
 	uint32_t symbolMax = DecodeUniversalLomont1(bs, 6, 0);
 	uint32_t tableBitLength = DecodeUniversalLomont1(bs, 6, 0);
 	state->tableStartBitPosition = bs->position;
-	bs->position += tableBitLength;
+	SkipBitstream(bs, tableBitLength);
 }
 
-// read from header, assumes state bitstream is set
-// return number of symbols
-static uint32_t ReadArithmeticHeaderNoLength(ArithmeticState_t * state)
+// Set the full coder range and fill the lookahead buffer with 31 bits
+static void StartArithmeticCoder(ArithmeticState_t * state)
 {
 	state->lowValue = 0; // lower bound, inclusive
 	state->highValue = range100Percent - 1; // upper bound, inclusive
 
+	state->buffer = 0;
+	uint32_t i;
+	for (i = 0; i < 31; ++i)
+		state->buffer = (state->buffer << 1) | ReadArithmeticBistream(state, 1);
+}
+
+// read from header, assumes state bitstream is set
+// return number of symbols
+static uint32_t ReadArithmeticHeaderNoLength(ArithmeticState_t * state)
+{
 	state->total = DecodeUniversalLomont1(&state->bitstream, 6, 0);
+	state->symbolsLeft = state->total;
+#ifdef DECOMPRESSOR_USE_ARITHMETIC_TABLE
+	state->cumCounts = 0; // no decoded table unless one is built
+#endif
+	if (state->total == 0)
+		return 0; // nothing stored, or the mark of an interleaved stream
 	state->bitLength = DecodeUniversalLomont1(&state->bitstream, 8, -1);
 	state->bitsRead = 0; // start tracking bits read to handle short decodable streams
 
@@ -300,12 +922,7 @@ static uint32_t ReadArithmeticHeaderNoLength(ArithmeticState_t * state)
 	DecodeArithmeticTable(state);
 	state->bitsRead = state->bitstream.position - tempPos;
 
-	// start buffer with 31 bits
-	state->buffer = 0;
-	uint32_t i;
-	for (i = 0; i < 31; ++i)
-		state->buffer = (state->buffer << 1) | ReadArithmeticBistream(state, 1);
-
+	StartArithmeticCoder(state);
 	return state->total;
 }
 
@@ -314,9 +931,40 @@ static uint32_t ReadArithmeticHeaderNoLength(ArithmeticState_t * state)
 EXPORT_WIN32 uint32_t DecompressArithmeticStart(ArithmeticState_t * state, const uint8_t * source, int32_t sourceLength)
 {
 	// init coder state
-	InitializeBitstream(&state->bitstream, source);
+	InitializeBitstream(&state->bitstream, source, (uint32_t)sourceLength);
+
+	ReadArithmeticHeaderNoLength(state);
+	if (!BitstreamFits(sourceLength))
+		state->total = state->symbolsLeft = 0;
+	return state->total;
+}
 
-	return ReadArithmeticHeaderNoLength(state);
+// decode next BASC encoded count from the table
+// bitLength is bits used by the previous count, updated for the next one
+static uint32_t DecodeArithmeticCount(Bitstream_t * table, uint32_t * bitLength)
+{
+	uint32_t xi, b1 = *bitLength;
+	uint32_t decision = ReadBitstream(table, 1);
+	if (decision == 0)
+	{
+		// bi is <= b(i-1), so enough bits
+		xi = ReadBitstream(table, b1);
+	}
+	else
+	{
+		// bi is bigger than b(i-1), must increase it
+		uint32_t delta = 0;
+		do
+		{
+			decision = ReadBitstream(table, 1);
+			delta++;
+		} while (decision != 0);
+		b1 += delta;
+		xi = ReadBitstream(table, b1 - 1); // xi has implied leading 1
+		xi |= 1U << (int)(b1 - 1);
+	}
+	*bitLength = BitsRequired(xi);
+	return xi;
 }
 
 // lookup symbol and probability range using table decoding
@@ -324,18 +972,19 @@ static uint32_t LookupArithmeticLowMemoryCount(ArithmeticState_t * state, uint32
 {
 	// BASC encoded, decode with same process
 
-	uint32_t tempPosition = state->bitstream.position; // save this
-	state->bitstream.position = state->tableStartBitPosition;
+	// walk the table with a copy of the stream to keep the data stream state
+	Bitstream_t table = state->bitstream;
+	SetBitstreamPosition(&table, state->tableStartBitPosition);
 
 	*lowCount = *highCount = 0;
 	uint32_t symbol = 0;
 
 	
-	uint32_t length = DecodeUniversalLomont1(&state->bitstream, 6, 0);
+	uint32_t length = DecodeUniversalLomont1(&table, 6, 0);
 	if (length != 0)
 	{
-		uint32_t b1 = DecodeUniversalLomont1(&state->bitstream, 6, 0);
-		uint32_t xi = ReadBitstream(&state->bitstream, b1);
+		uint32_t b1 = DecodeUniversalLomont1(&table, 6, 0);
+		uint32_t xi = ReadBitstream(&table, b1);
 
 		*lowCount = 0;
 		*highCount = xi;
@@ -344,26 +993,8 @@ static uint32_t LookupArithmeticLowMemoryCount(ArithmeticState_t * state, uint32
 
 		while (*highCount <= cumCount)
 		{
-			uint32_t decision = ReadBitstream(&state->bitstream, 1);
-			if (decision == 0)
-			{
-				// bi is <= b(i-1), so enough bits
-				xi = ReadBitstream(&state->bitstream, b1);
-			}
-			else
-			{
-				// bi is bigger than b(i-1), must increase it
-				uint32_t delta = 0;
-				do
-				{
-					decision = ReadBitstream(&state->bitstream, 1);
-					delta++;
-				} while (decision != 0);
-				b1 += delta;
-				xi = ReadBitstream(&state->bitstream, b1 - 1); // xi has implied leading 1
-				xi |= 1U << (int)(b1 - 1);
-			}
-			b1 = BitsRequired(xi);
+			DECOMPRESSOR_COUNT(arithmeticLookupSteps, 1);
+			xi = DecodeArithmeticCount(&table, &b1);
 
 			*lowCount = *highCount;
 			*highCount += xi;
@@ -372,23 +1003,108 @@ static uint32_t LookupArithmeticLowMemoryCount(ArithmeticState_t * state, uint32
 				symbol = i;
 		}
 	}
-
-	state->bitstream.position = tempPosition; // restore this
 	return symbol;
 }
 
 
-// Decompress a symbol in the compression algorithm
-EXPORT_WIN32 uint32_t DecompressArithmeticSymbol(ArithmeticState_t * state)
+#ifdef DECOMPRESSOR_USE_ARITHMETIC_TABLE
+// lookup symbol and probability range using the decoded table
+static uint32_t LookupArithmeticTableCount(ArithmeticState_t * state, uint32_t cumCount, uint32_t * lowCount, uint32_t * highCount)
 {
-	//	Trace.Assert(total < (1 << 29)); // todo - this sufficient when 8 bit symbols, but what when larger?
-	//	Trace.Assert(lowValue <= buffer && buffer <= highValue);
-
-	//split range into single steps
-	uint32_t step = (state->highValue - state->lowValue + 1) / state->total; // interval open at top gives +1
-
-	uint32_t lowCount, highCount;
-	uint32_t symbol = LookupArithmeticLowMemoryCount(state, (state->buffer - state->lowValue) / step, &lowCount, &highCount);
+	const uint32_t * cum = state->cumCounts;
+	uint32_t index;
+	DECOMPRESSOR_COUNT(arithmeticLookupSteps, 1);
+	if (state->countToIndex != 0)
+		index = state->countToIndex[cumCount];
+	else
+	{
+		// binary search for last index with cum[index] <= cumCount,
+		// which skips symbols with zero count
+		uint32_t low = 0, high = state->countLength; // cum[low] <= cumCount < cum[high]
+		while (high - low > 1)
+		{
+			DECOMPRESSOR_COUNT(arithmeticLookupSteps, 1);
+			uint32_t mid = (low + high) / 2;
+			if (cum[mid] <= cumCount)
+				low = mid;
+			else
+				high = mid;
+		}
+		index = low;
+	}
+	*lowCount = cum[index];
+	*highCount = cum[index + 1];
+	return state->symbolMin + index;
+}
+
+// Decode the count table into table, return 1 if it fit, else 0
+// Layout is countLength+1 cumulative counts, followed by a map from
+// cumulative count to symbol index when total counts also fit
+static uint32_t BuildArithmeticLookup(ArithmeticState_t * state, uint32_t * table, uint32_t tableLength)
+{
+	Bitstream_t bs = state->bitstream;
+	SetBitstreamPosition(&bs, state->tableStartBitPosition);
+
+	uint32_t length = DecodeUniversalLomont1(&bs, 6, 0) - 1; // stored as count + 1
+	if (length == 0 || length == 0xFFFFFFFF || tableLength < length + 1)
+		return 0;
+	uint32_t b1 = DecodeUniversalLomont1(&bs, 6, 0);
+	uint32_t i, j;
+	table[0] = 0;
+	table[1] = ReadBitstream(&bs, b1);
+	for (i = 1; i < length; ++i)
+		table[i + 1] = table[i] + DecodeArithmeticCount(&bs, &b1);
+	if (table[length] != state->total)
+		return 0; // malformed table, let low memory decoder handle it
+
+	state->countLength = length;
+	state->countToIndex = 0;
+	if (tableLength - (length + 1) >= state->total)
+	{
+		// small total, direct lookup
+		uint32_t * map = table + length + 1;
+		for (i = 0; i < length; ++i)
+			for (j = table[i]; j < table[i + 1]; ++j)
+				map[j] = i;
+		state->countToIndex = map;
+	}
+	state->cumCounts = table;
+	return 1;
+}
+
+// Partial call decompression using a decoded table for speed
+// Like DecompressArithmeticStart, but decodes the count table once into the
+// caller supplied table of tableLength entries, which must live as long as the state.
+EXPORT_WIN32 uint32_t DecompressArithmeticStartFast(ArithmeticState_t * state, const uint8_t * source, int32_t sourceLength, uint32_t * table, uint32_t tableLength)
+{
+	uint32_t symbolCount = DecompressArithmeticStart(state, source, sourceLength);
+	if (symbolCount != 0)
+		BuildArithmeticLookup(state, table, tableLength);
+	return symbolCount;
+}
+#endif
+
+// Decompress a symbol in the compression algorithm, or CL_COMPRESSOR_END_TOKEN when done
+EXPORT_WIN32 uint32_t DecompressArithmeticSymbol(ArithmeticState_t * state)
+{
+	if (state->symbolsLeft == 0)
+		return CL_COMPRESSOR_END_TOKEN;
+	if (state->symbolsLeft != 0xFFFFFFFF)
+		state->symbolsLeft--;
+
+	//	Trace.Assert(total < (1 << 29)); // todo - this sufficient when 8 bit symbols, but what when larger?
+	//	Trace.Assert(lowValue <= buffer && buffer <= highValue);
+
+	//split range into single steps
+	uint32_t step = (state->highValue - state->lowValue + 1) / state->total; // interval open at top gives +1
+
+	uint32_t lowCount, highCount, symbol;
+#ifdef DECOMPRESSOR_USE_ARITHMETIC_TABLE
+	if (state->cumCounts != 0)
+		symbol = LookupArithmeticTableCount(state, (state->buffer - state->lowValue) / step, &lowCount, &highCount);
+	else
+#endif
+	symbol = LookupArithmeticLowMemoryCount(state, (state->buffer - state->lowValue) / step, &lowCount, &highCount);
 
 	// upper bound
 	state->highValue = state->lowValue + step*highCount - 1; // interval open top gives -1
@@ -398,6 +1114,7 @@ EXPORT_WIN32 uint32_t DecompressArithmeticSymbol(ArithmeticState_t * state)
 	// e1/e2 scaling
 	while ((state->highValue < range50Percent) || (state->lowValue >= range50Percent))
 	{
+		DECOMPRESSOR_COUNT(arithmeticRenormalizations, 1);
 		if (state->highValue < range50Percent)
 		{
 			state->lowValue = 2 * state->lowValue;
@@ -417,6 +1134,7 @@ EXPORT_WIN32 uint32_t DecompressArithmeticSymbol(ArithmeticState_t * state)
 	// e3 scaling
 	while ((range25Percent <= state->lowValue) && (state->highValue < range75Percent))
 	{
+		DECOMPRESSOR_COUNT(arithmeticRenormalizations, 1);
 		state->lowValue = 2 * (state->lowValue - range25Percent);
 		state->highValue = 2 * (state->highValue - range25Percent) + 1;
 		//Trace.Assert(buffer >= range25Percent);
@@ -429,6 +1147,8 @@ EXPORT_WIN32 int32_t DecompressArithmetic(const uint8_t * source, int32_t source
 {
 	ArithmeticState_t state;
 	uint32_t symbolCount = DecompressArithmeticStart(&state, source, sourceLength);
+	if (symbolCount > (uint32_t)destLength)
+		symbolCount = (uint32_t)destLength;
 
 	uint32_t i;
 	for (i = 0; i < symbolCount; ++i)
@@ -436,6 +1156,124 @@ EXPORT_WIN32 int32_t DecompressArithmetic(const uint8_t * source, int32_t source
 	return symbolCount;
 }
 
+#ifdef DECOMPRESSOR_USE_ARITHMETIC_TABLE
+// decompress using a decoded table, return bytes decoded
+EXPORT_WIN32 int32_t DecompressArithmeticFast(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, uint32_t * table, uint32_t tableLength)
+{
+	ArithmeticState_t state;
+	uint32_t symbolCount = DecompressArithmeticStartFast(&state, source, sourceLength, table, tableLength);
+	if (symbolCount > (uint32_t)destLength)
+		symbolCount = (uint32_t)destLength;
+
+	uint32_t i;
+	for (i = 0; i < symbolCount; ++i)
+		dest[i] = DecompressArithmeticSymbol(&state);
+	return symbolCount;
+}
+#endif
+
+#ifdef DECOMPRESSOR_USE_INTERLEAVED
+// decompress data compressed with streams=2-4, return bytes decoded
+EXPORT_WIN32 int32_t DecompressArithmeticInterleaved(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, uint32_t * table, uint32_t tableLength)
+{
+	// one coder per stream, sharing the count table
+	ArithmeticState_t states[DECOMPRESSOR_MAX_STREAMS];
+	uint32_t positions[DECOMPRESSOR_MAX_STREAMS], lengths[DECOMPRESSOR_MAX_STREAMS];
+	uint32_t streamCount, count, index = 0, stream;
+
+	InitializeBitstream(&states[0].bitstream, source, (uint32_t)sourceLength);
+	if (!ReadInterleavedMark(&states[0].bitstream))
+		return 0;
+	states[0].total = DecodeUniversalLomont1(&states[0].bitstream, 6, 0);
+	streamCount = 1 + DecodeUniversalLomont1(&states[0].bitstream, 2, 0);
+	if (states[0].total == 0 || streamCount > DECOMPRESSOR_MAX_STREAMS || destLength <= 0 || !BitstreamFits(sourceLength))
+		return 0;
+	DecodeArithmeticTable(&states[0]);
+#ifdef DECOMPRESSOR_USE_ARITHMETIC_TABLE
+	states[0].cumCounts = 0;
+	BuildArithmeticLookup(&states[0], table, tableLength);
+#else
+	(void)table;
+	(void)tableLength;
+#endif
+	states[0].symbolsLeft = 0xFFFFFFFF; // count is kept here
+	ReadInterleavedStreams(&states[0].bitstream, streamCount, positions, lengths);
+	for (stream = 0; stream < streamCount; ++stream)
+	{
+		ArithmeticState_t * state = &states[stream];
+		*state = states[0];
+		SetBitstreamPosition(&state->bitstream, positions[stream]);
+		state->bitLength = lengths[stream];
+		state->bitsRead = 0;
+		StartArithmeticCoder(state);
+	}
+
+	count = states[0].total < (uint32_t)destLength ? states[0].total : (uint32_t)destLength;
+	// symbol index goes to stream index % streamCount, unrolled so the compiler sees independent decodes
+	if (streamCount == 4)
+		for (; index + 4 <= count; index += 4)
+		{
+			dest[index] = (uint8_t)DecompressArithmeticSymbol(&states[0]);
+			dest[index + 1] = (uint8_t)DecompressArithmeticSymbol(&states[1]);
+			dest[index + 2] = (uint8_t)DecompressArithmeticSymbol(&states[2]);
+			dest[index + 3] = (uint8_t)DecompressArithmeticSymbol(&states[3]);
+		}
+	else if (streamCount == 2)
+		for (; index + 2 <= count; index += 2)
+		{
+			dest[index] = (uint8_t)DecompressArithmeticSymbol(&states[0]);
+			dest[index + 1] = (uint8_t)DecompressArithmeticSymbol(&states[1]);
+		}
+	for (; index + streamCount <= count; index += streamCount)
+		for (stream = 0; stream < streamCount; ++stream)
+			dest[index + stream] = (uint8_t)DecompressArithmeticSymbol(&states[stream]);
+	for (stream = 0; index < count; ++index, ++stream)
+		dest[index] = (uint8_t)DecompressArithmeticSymbol(&states[stream]);
+	return (int32_t)count;
+}
+#endif
+
+// Call after starting decompression with DecompressArithmeticStart to send all remaining
+// symbols to sink in spans of up to chunk bytes. Returns number of bytes sent.
+EXPORT_WIN32 uint32_t DecompressArithmeticToSink(ArithmeticState_t * state, DecompressSink_t sink, void * context, uint32_t chunk)
+{
+	uint8_t buffer[DECOMPRESSOR_SINK_BUFFER];
+	uint32_t index = 0, count = 0;
+	if (chunk == 0 || chunk > DECOMPRESSOR_SINK_BUFFER)
+		chunk = DECOMPRESSOR_SINK_BUFFER;
+	while (1)
+	{
+		uint32_t symbol = DecompressArithmeticSymbol(state);
+		if (symbol == CL_COMPRESSOR_END_TOKEN)
+			break;
+		buffer[count++] = (uint8_t)symbol;
+		if (count == chunk)
+		{
+			sink(context, buffer, count, index);
+			index += count;
+			count = 0;
+		}
+	}
+	if (count != 0)
+		sink(context, buffer, count, index);
+	return index + count;
+}
+
+// Call after starting decompression with DecompressArithmeticStart to decode
+// up to maxBytes symbols into out. Returns number written, 0 when done.
+EXPORT_WIN32 uint32_t DecompressArithmeticPartial(ArithmeticState_t * state, uint8_t * out, uint32_t maxBytes)
+{
+	uint32_t count = 0;
+	while (count < maxBytes)
+	{
+		uint32_t symbol = DecompressArithmeticSymbol(state);
+		if (symbol == CL_COMPRESSOR_END_TOKEN)
+			break;
+		out[count++] = (uint8_t)symbol;
+	}
+	return count;
+}
+
 // cleanup
 #undef range25Percent 
 #undef range50Percent 
@@ -444,15 +1282,556 @@ EXPORT_WIN32 int32_t DecompressArithmetic(const uint8_t * source, int32_t source
 
 #endif // DECOMPRESSOR_USE_ARITHMETIC
 
+/************************* rANS coding implementation *************************/
+
+#ifdef DECOMPRESSOR_USE_RANS
+
+// coder state is kept in [ransStateLow, ransStateLow << 8) between symbols
+#define ransStateLow 0x00800000U
+
+// read from header, assumes state bitstream is set
+static void ReadRansHeaderNoLength(RansState_t * state)
+{
+	Bitstream_t * bs = &state->bitstream;
+	// Table format is
+	//   - scale bits, Lomont1 universal coded. Symbols have slots 0 to 2^scaleBits-1
+	//   - 1 bit, 1 if entries list values of present symbols, 0 if entries are all from symbol min
+	//   - symbol min, entry count - 1, Lomont1 universal coded
+	//   - bits per symbol value in sparse tables, Lomont1 universal coded
+	//   - entries 1 to count - 1, each (symbol - symbol min if sparse) then first slot.
+	//     Widths are fixed, so entries are binary searched in place.
+	state->scaleBits = (uint8_t)DecodeUniversalLomont1(bs, 4, 0);
+	state->sparse = (uint8_t)ReadBitstream(bs, 1);
+	state->symbolMin = DecodeUniversalLomont1(bs, 6, 0);
+	state->entries = DecodeUniversalLomont1(bs, 6, 0) + 1;
+	state->symbolBits = state->sparse ? (uint8_t)DecodeUniversalLomont1(bs, 3, 0) : 0;
+	state->tablePosition = bs->position;
+	SkipBitstream(bs, (state->entries - 1) * (state->symbolBits + state->scaleBits));
+#ifdef DECOMPRESSOR_USE_RANS_TABLE
+	state->slots = 0; // no decoded table unless one is built
+#endif
+
+	// coder state follows the table
+	state->x = ReadBitstream(bs, 32);
+}
+
+// Read the header for the compression algorithm
+// Return number of symbols in stream
+EXPORT_WIN32 uint32_t DecompressRansStart(RansState_t * state, const uint8_t * source, int32_t sourceLength)
+{
+	InitializeBitstream(&state->bitstream, source, (uint32_t)sourceLength);
+	state->symbolsLeft = DecodeUniversalLomont1(&state->bitstream, 6, 0); // number of bytes to decompress
+	ReadRansHeaderNoLength(state);
+	if (!BitstreamFits(sourceLength))
+		state->symbolsLeft = 0;
+	return state->symbolsLeft;
+}
+
+// lookup symbol and slot range by binary search of the stream table
+static uint32_t LookupRansLowMemory(RansState_t * state, uint32_t slot, uint32_t * lowSlot, uint32_t * highSlot)
+{
+	uint32_t entryBits = state->symbolBits + state->scaleBits;
+	uint32_t low = 0, high = state->entries; // slot of low <= slot < slot of high
+	uint32_t position;
+	*lowSlot = 0;
+	*highSlot = 1U << state->scaleBits;
+	while (high - low > 1)
+	{
+		// last entry with first slot <= slot, which skips symbols with no slots
+		DECOMPRESSOR_COUNT(ransLookupSteps, 1);
+		uint32_t mid = (low + high) / 2;
+		position = state->tablePosition + (mid - 1) * entryBits + state->symbolBits;
+		uint32_t midSlot = ReadFromBitstreamPosition(&state->bitstream, &position, state->scaleBits);
+		if (midSlot <= slot)
+		{
+			low = mid;
+			*lowSlot = midSlot;
+		}
+		else
+		{
+			high = mid;
+			*highSlot = midSlot;
+		}
+	}
+	if (state->sparse == 0 || low == 0)
+		return state->symbolMin + low;
+	position = state->tablePosition + (low - 1) * entryBits;
+	return state->symbolMin + ReadFromBitstreamPosition(&state->bitstream, &position, state->symbolBits);
+}
+
+#ifdef DECOMPRESSOR_USE_RANS_TABLE
+// lookup symbol and slot range using the decoded table
+static uint32_t LookupRansTable(RansState_t * state, uint32_t slot, uint32_t * lowSlot, uint32_t * highSlot)
+{
+	const uint32_t * slots = state->slots;
+	uint32_t index;
+	DECOMPRESSOR_COUNT(ransLookupSteps, 1);
+	if (state->slotToIndex != 0)
+		index = state->slotToIndex[slot];
+	else
+	{
+		// binary search for last index with slots[index] <= slot
+		uint32_t low = 0, high = state->entries; // slots[low] <= slot < slots[high]
+		while (high - low > 1)
+		{
+			DECOMPRESSOR_COUNT(ransLookupSteps, 1);
+			uint32_t mid = (low + high) / 2;
+			if (slots[mid] <= slot)
+				low = mid;
+			else
+				high = mid;
+		}
+		index = low;
+	}
+	*lowSlot = slots[index];
+	*highSlot = slots[index + 1];
+	return state->symbols[index];
+}
+
+// Decode the stream table into table, return 1 if it fit, else 0
+// Layout is entries+1 first slots, entries symbols, then a map from
+// slot to entry index when all 2^scaleBits slots also fit
+static uint32_t BuildRansLookup(RansState_t * state, uint32_t * table, uint32_t tableLength)
+{
+	uint32_t entries = state->entries, slotCount = 1U << state->scaleBits;
+	uint32_t i, j;
+	if (tableLength < 2 * entries + 1)
+		return 0;
+	Bitstream_t bs = state->bitstream;
+	SetBitstreamPosition(&bs, state->tablePosition);
+
+	uint32_t * slots = table;
+	uint32_t * symbols = table + entries + 1;
+	slots[0] = 0;
+	symbols[0] = state->symbolMin;
+	for (i = 1; i < entries; ++i)
+	{
+		symbols[i] = state->symbolMin + (state->sparse ? ReadBitstream(&bs, state->symbolBits) : i);
+		slots[i] = ReadBitstream(&bs, state->scaleBits);
+	}
+	slots[entries] = slotCount;
+
+	state->slotToIndex = 0;
+	if (tableLength - (2 * entries + 1) >= slotCount)
+	{
+		uint32_t * map = symbols + entries;
+		for (i = 0; i < entries; ++i)
+			for (j = slots[i]; j < slots[i + 1] && j < slotCount; ++j)
+				map[j] = i;
+		state->slotToIndex = map;
+	}
+	state->slots = slots;
+	state->symbols = symbols;
+	return 1;
+}
+
+// Partial call decompression using a decoded table for speed
+// Like DecompressRansStart, but decodes the table once into the
+// caller supplied table of tableLength entries, which must live as long as the state.
+EXPORT_WIN32 uint32_t DecompressRansStartFast(RansState_t * state, const uint8_t * source, int32_t sourceLength, uint32_t * table, uint32_t tableLength)
+{
+	uint32_t symbolCount = DecompressRansStart(state, source, sourceLength);
+	BuildRansLookup(state, table, tableLength);
+	return symbolCount;
+}
+#endif
+
+// Decode a symbol, the caller tracks how many are left
+static uint32_t DecodeRansSymbol(RansState_t * state)
+{
+	uint32_t slot = state->x & ((1U << state->scaleBits) - 1);
+	uint32_t lowSlot, highSlot, symbol;
+#ifdef DECOMPRESSOR_USE_RANS_TABLE
+	if (state->slots != 0)
+		symbol = LookupRansTable(state, slot, &lowSlot, &highSlot);
+	else
+#endif
+	symbol = LookupRansLowMemory(state, slot, &lowSlot, &highSlot);
+
+	// no divide, and renormalize a byte at a time
+	state->x = (highSlot - lowSlot) * (state->x >> state->scaleBits) + slot - lowSlot;
+	while (state->x < ransStateLow)
+	{
+		DECOMPRESSOR_COUNT(ransRenormalizations, 1);
+		state->x = (state->x << 8) | ReadBitstream(&state->bitstream, 8);
+	}
+	return symbol;
+}
+
+// Decompress a symbol in the compression algorithm, or CL_COMPRESSOR_END_TOKEN when done
+EXPORT_WIN32 uint32_t DecompressRansSymbol(RansState_t * state)
+{
+	if (state->symbolsLeft == 0)
+		return CL_COMPRESSOR_END_TOKEN;
+	if (state->symbolsLeft != 0xFFFFFFFF)
+		state->symbolsLeft--;
+	return DecodeRansSymbol(state);
+}
+
+// decode bytes from a started state, return bytes decoded
+static int32_t DecodeRansBytes(RansState_t * state, uint8_t * dest, int32_t destLength)
+{
+	uint32_t i, symbolCount = state->symbolsLeft;
+	if (destLength <= 0)
+		return 0;
+	if (symbolCount > (uint32_t)destLength)
+		symbolCount = (uint32_t)destLength;
+	for (i = 0; i < symbolCount; ++i)
+		dest[i] = (uint8_t)DecodeRansSymbol(state);
+	state->symbolsLeft -= symbolCount;
+	return (int32_t)symbolCount;
+}
+
+// decompress, return bytes decoded
+EXPORT_WIN32 int32_t DecompressRans(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength)
+{
+	RansState_t state;
+	DecompressRansStart(&state, source, sourceLength);
+	return DecodeRansBytes(&state, dest, destLength);
+}
+
+#ifdef DECOMPRESSOR_USE_RANS_TABLE
+// decompress using a decoded table, return bytes decoded
+EXPORT_WIN32 int32_t DecompressRansFast(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, uint32_t * table, uint32_t tableLength)
+{
+	RansState_t state;
+	DecompressRansStartFast(&state, source, sourceLength, table, tableLength);
+	return DecodeRansBytes(&state, dest, destLength);
+}
+#endif
+
+// Call after starting decompression with DecompressRansStart to send all remaining
+// symbols to sink in spans of up to chunk bytes. Returns number of bytes sent.
+EXPORT_WIN32 uint32_t DecompressRansToSink(RansState_t * state, DecompressSink_t sink, void * context, uint32_t chunk)
+{
+	uint8_t buffer[DECOMPRESSOR_SINK_BUFFER];
+	uint32_t index = 0, count;
+	if (chunk == 0 || chunk > DECOMPRESSOR_SINK_BUFFER)
+		chunk = DECOMPRESSOR_SINK_BUFFER;
+	while ((count = (uint32_t)DecodeRansBytes(state, buffer, (int32_t)chunk)) != 0)
+	{
+		sink(context, buffer, count, index);
+		index += count;
+	}
+	return index;
+}
+
+// Call after starting decompression with DecompressRansStart to decode
+// up to maxBytes symbols into out. Returns number written, 0 when done.
+EXPORT_WIN32 uint32_t DecompressRansPartial(RansState_t * state, uint8_t * out, uint32_t maxBytes)
+{
+	if (maxBytes > 0x7FFFFFFF)
+		maxBytes = 0x7FFFFFFF;
+	return (uint32_t)DecodeRansBytes(state, out, (int32_t)maxBytes);
+}
+
+// cleanup
+#undef ransStateLow
+
+#endif // DECOMPRESSOR_USE_RANS
+
 /************************* LZ77 coding implementation *************************/
 #ifdef DECOMPRESSOR_USE_LZ77
 
+// Header values, constants when specialized by DECOMPRESSOR_SPECIALIZE
+#ifdef DECOMPRESSOR_LZ77_BITS_PER_SYMBOL
+#define LZ77_BITS_PER_SYMBOL(state) (DECOMPRESSOR_LZ77_BITS_PER_SYMBOL)
+#else
+#define LZ77_BITS_PER_SYMBOL(state) ((state)->actualBitsPerSymbol)
+#endif
+#ifdef DECOMPRESSOR_LZ77_BITS_PER_TOKEN
+#define LZ77_BITS_PER_TOKEN(state) (DECOMPRESSOR_LZ77_BITS_PER_TOKEN)
+#else
+#define LZ77_BITS_PER_TOKEN(state) ((state)->actualBitsPerToken)
+#endif
+#ifdef DECOMPRESSOR_LZ77_MIN_LENGTH
+#define LZ77_MIN_LENGTH(state) (DECOMPRESSOR_LZ77_MIN_LENGTH)
+#else
+#define LZ77_MIN_LENGTH(state) ((state)->actualMinLength)
+#endif
+#ifdef DECOMPRESSOR_LZ77_MAX_DISTANCE
+#define LZ77_MAX_DISTANCE(state) (DECOMPRESSOR_LZ77_MAX_DISTANCE)
+#else
+#define LZ77_MAX_DISTANCE(state) ((state)->actualMaxDistance)
+#endif
+
+// Preset dictionary arguments of a LZ77 or LZCL state, none if not built in
+#ifdef DECOMPRESSOR_USE_DICTIONARY
+#define LZ_DICTIONARY(state) (state)->dictionary, (state)->dictionaryLength
+#else
+#define LZ_DICTIONARY(state) 0, 0
+#endif
+
+// Mask for power of two buffer lengths, else 0 to use modulus
+static uint32_t RingMask(uint32_t length)
+{
+	return (length & (length - 1)) == 0 ? length - 1 : 0;
+}
+
+// Shift splitting tokens when maxDistance+1 is a power of two, else 0 to use division
+static uint8_t TokenShift(uint32_t maxDistance)
+{
+	uint8_t shift = 0;
+	if (maxDistance == 0 || (maxDistance & (maxDistance + 1)) != 0)
+		return 0;
+	while ((maxDistance >> shift) != 0)
+		++shift;
+	return shift;
+}
+
+// Position of index in a cyclic buffer
+static uint32_t RingPosition(uint32_t index, uint32_t length, uint32_t mask)
+{
+	return mask != 0 ? index & mask : index % length;
+}
+
+#if defined(LZ_SIMD_SSSE3) || defined(LZ_SIMD_NEON)
+
+#ifdef LZ_SIMD_SSSE3
+// SSSE3 is not in every x86 cpu, so the kernel is built for it and used when present
+#if defined(__GNUC__) && !defined(__SSSE3__)
+#define LZ_SIMD_TARGET __attribute__((target("ssse3")))
+#else
+#define LZ_SIMD_TARGET
+#endif
+#define LZ_VECTOR __m128i
+#define LZ_LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define LZ_STORE(p, v) _mm_storeu_si128((__m128i *)(p), v)
+#define LZ_SHUFFLE(v, mask) _mm_shuffle_epi8(v, mask)
+
+// 1 if the cpu has SSSE3, else 0. The result is cached, and racing threads store the same value.
+static int LZSimdSupported(void)
+{
+#ifdef __SSSE3__
+	return 1; // built for it
+#else
+	static int supported = -1;
+	if (supported < 0)
+	{
+#if defined(__GNUC__)
+		supported = __builtin_cpu_supports("ssse3") ? 1 : 0;
+#else
+		int info[4];
+		__cpuid(info, 1);
+		supported = (info[2] >> 9) & 1; // ECX bit 9 is SSSE3
+#endif
+	}
+	return supported;
+#endif
+}
+#else
+#define LZ_SIMD_TARGET
+#define LZ_VECTOR uint8x16_t
+#define LZ_LOAD(p) vld1q_u8(p)
+#define LZ_STORE(p, v) vst1q_u8(p, v)
+#define LZ_SHUFFLE(v, mask) vqtbl1q_u8(v, mask)
+#define LZSimdSupported() 1 // always present on 64 bit ARM
+#endif
+
+// row offset is byte indices i % offset, repeating the first offset bytes
+static const uint8_t lzPatternMasks[16][16] = {
+	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},
+	{0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0},
+	{0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1},
+	{0,1,2,0,1,2,0,1,2,0,1,2,0,1,2,0},
+	{0,1,2,3,0,1,2,3,0,1,2,3,0,1,2,3},
+	{0,1,2,3,4,0,1,2,3,4,0,1,2,3,4,0},
+	{0,1,2,3,4,5,0,1,2,3,4,5,0,1,2,3},
+	{0,1,2,3,4,5,6,0,1,2,3,4,5,6,0,1},
+	{0,1,2,3,4,5,6,7,0,1,2,3,4,5,6,7},
+	{0,1,2,3,4,5,6,7,8,0,1,2,3,4,5,6},
+	{0,1,2,3,4,5,6,7,8,9,0,1,2,3,4,5},
+	{0,1,2,3,4,5,6,7,8,9,10,0,1,2,3,4},
+	{0,1,2,3,4,5,6,7,8,9,10,11,0,1,2,3},
+	{0,1,2,3,4,5,6,7,8,9,10,11,12,0,1,2},
+	{0,1,2,3,4,5,6,7,8,9,10,11,12,13,0,1},
+	{0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,0}
+};
+
+// Copy n >= 16 bytes from 2 to 15 before dest, same result as copying a byte at a 
+// time. One shuffle repeats the source bytes across a vector, which is valid at 
+// every multiple of offset, so stores step by the largest multiple fitting in 16.
+LZ_SIMD_TARGET static void RepeatLZPattern(uint8_t * dest, const uint8_t * source, uint32_t offset, uint32_t n)
+{
+	uint8_t pattern[16];
+	uint32_t i, step = 16 - 16 % offset;
+	// 16 bytes from source end by dest + 16, so are readable
+	LZ_VECTOR v = LZ_SHUFFLE(LZ_LOAD(source), LZ_LOAD(lzPatternMasks[offset]));
+	for (i = 0; i + 16 <= n; i += step)
+		LZ_STORE(dest + i, v);
+	LZ_STORE(pattern, v);
+	memcpy(dest + i, pattern, n - i);
+}
+
+#undef LZ_VECTOR
+#undef LZ_LOAD
+#undef LZ_STORE
+#undef LZ_SHUFFLE
+#undef LZ_SIMD_TARGET
+
+// Copy 4 <= n < 16 bytes with source at least n before dest, as two overlapping moves
+static void CopyLZShort(uint8_t * dest, const uint8_t * source, uint32_t n)
+{
+	if (n >= 8)
+	{
+		uint64_t first, last;
+		memcpy(&first, source, 8);
+		memcpy(&last, source + n - 8, 8);
+		memcpy(dest, &first, 8);
+		memcpy(dest + n - 8, &last, 8);
+	}
+	else
+	{
+		uint32_t first, last;
+		memcpy(&first, source, 4);
+		memcpy(&last, source + n - 4, 4);
+		memcpy(dest, &first, 4);
+		memcpy(dest + n - 4, &last, 4);
+	}
+}
+#endif // LZ_SIMD_SSSE3 || LZ_SIMD_NEON
+
+// Copy n bytes from source to dest, same result as copying a byte at a time
+// Source and dest may overlap
+static void CopyLZSpan(uint8_t * dest, const uint8_t * source, uint32_t n)
+{
+#if defined(LZ_SIMD_SSSE3) || defined(LZ_SIMD_NEON)
+	// host paths, other spans do well with the library copies below
+	uint32_t offset = (uint32_t)(dest - source);
+	if (source < dest && n < 16 && n >= 4 && offset >= n)
+	{
+		CopyLZShort(dest, source, n);
+		return;
+	}
+	if (source < dest && n >= 16 && offset >= 2 && offset < 16 && LZSimdSupported())
+	{
+		RepeatLZPattern(dest, source, offset, n);
+		return;
+	}
+#endif
+	if (n <= 8)
+	{
+		// short, a byte at a time is fastest and safe for any overlap
+		uint32_t i;
+		for (i = 0; i < n; ++i)
+			dest[i] = source[i];
+	}
+	else if (source + n <= dest || dest + n <= source)
+		memcpy(dest, source, n); // no overlap
+	else if (source < dest)
+	{
+		// short distance, source repeats with period dest - source
+		// copy the repeated span, which doubles each pass
+		uint32_t i = 0;
+		if (dest - source == 1)
+			memset(dest, source[0], n);
+		else while (i < n)
+		{
+			uint32_t c = (uint32_t)(dest + i - source);
+			if (c > n - i)
+				c = n - i;
+			memcpy(dest + i, source, c);
+			i += c;
+		}
+	}
+	else
+		memmove(dest, source, n); // source ahead of dest, byte order safe
+}
+
+// Copy the part of a run before the first output byte from the preset dictionary,
+// which sits logically before it. The run starts back bytes before the first byte.
+// Returns bytes copied, at most length and back, 0 if the run starts before the dictionary
+static uint32_t CopyLZDictionary(const uint8_t * dictionary, uint32_t dictionaryLength, uint8_t * out, uint32_t back, uint32_t length)
+{
+	if (back > dictionaryLength)
+		return 0;
+	if (length > back)
+		length = back;
+	memcpy(out, dictionary + dictionaryLength - back, length);
+	return length;
+}
+
+// Copy a run of length bytes from distance+1 back in the cyclic buffer dest
+// Same result as copying a byte at a time, but done in chunks that do not wrap
+// A run starting before byte 0 starts in the dictionary, and is dropped if there is none
+static void CopyLZRun(const uint8_t * dictionary, uint32_t dictionaryLength, uint8_t * dest, uint32_t destLength, uint32_t destMask, uint32_t byteIndex, uint32_t distance, uint32_t length)
+{
+	uint32_t offset = distance + 1;
+	uint32_t d = RingPosition(byteIndex, destLength, destMask);
+	uint32_t s;
+	while (offset > byteIndex && length > 0)
+	{
+		// dictionary part, in chunks where dest does not wrap
+		uint32_t n = length;
+		if (n > destLength - d)
+			n = destLength - d;
+		n = CopyLZDictionary(dictionary, dictionaryLength, dest + d, offset - byteIndex, n);
+		if (n == 0)
+			return; // corrupt, no such data
+		byteIndex += n;
+		length -= n;
+		d = RingPosition(d + n, destLength, destMask);
+	}
+	s = RingPosition(byteIndex + destLength - offset, destLength, destMask);
+	while (length > 0)
+	{
+		// largest chunk where neither source nor dest wraps
+		uint32_t n = length;
+		if (n > destLength - d)
+			n = destLength - d;
+		if (n > destLength - s)
+			n = destLength - s;
+
+		CopyLZSpan(dest + d, dest + s, n);
+
+		length -= n;
+		d = RingPosition(d + n, destLength, destMask);
+		s = RingPosition(s + n, destLength, destMask);
+	}
+}
+
+// Return 1 if header values match those fixed by DECOMPRESSOR_SPECIALIZE, else 0
+static uint32_t LZ77Specialized(const LZ77State_t * state)
+{
+	uint32_t match = 1;
+#ifdef DECOMPRESSOR_LZ77_BITS_PER_SYMBOL
+	match &= state->actualBitsPerSymbol == DECOMPRESSOR_LZ77_BITS_PER_SYMBOL;
+#endif
+#ifdef DECOMPRESSOR_LZ77_BITS_PER_TOKEN
+	match &= state->actualBitsPerToken == DECOMPRESSOR_LZ77_BITS_PER_TOKEN;
+#endif
+#ifdef DECOMPRESSOR_LZ77_MIN_LENGTH
+	match &= state->actualMinLength == DECOMPRESSOR_LZ77_MIN_LENGTH;
+#endif
+#ifdef DECOMPRESSOR_LZ77_MAX_DISTANCE
+	match &= state->actualMaxDistance == DECOMPRESSOR_LZ77_MAX_DISTANCE;
+#endif
+	(void)state;
+	return match;
+}
+
+// Split a token into run distance and length
+static void SplitLZ77Token(const LZ77State_t * state, uint32_t token, uint32_t * distance, uint32_t * length)
+{
+#ifndef DECOMPRESSOR_LZ77_MAX_DISTANCE // a constant divisor is already cheap
+	if (state->distanceShift != 0)
+	{
+		*length = (token >> state->distanceShift) + LZ77_MIN_LENGTH(state);
+		*distance = token & state->actualMaxDistance;
+		return;
+	}
+#endif
+	*length = token / (LZ77_MAX_DISTANCE(state) + 1) + LZ77_MIN_LENGTH(state);
+	*distance = token % (LZ77_MAX_DISTANCE(state) + 1);
+	(void)state;
+}
+
 // Partial call decompression
 // start decompression, follow up with DecompressLZ77Block until done
 // requires buffer dest of length enough to handle the max look-back used when compressing the block
 EXPORT_WIN32 void DecompressLZ77Start(LZ77State_t * state, const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength)
 {
-	InitializeBitstream(&state->bitstream, source);
+	InitializeBitstream(&state->bitstream, source, (uint32_t)sourceLength);
 
 	// header values
 	state->byteLength = DecodeUniversalLomont1(&state->bitstream, 6, 0);
@@ -461,48 +1840,128 @@ EXPORT_WIN32 void DecompressLZ77Start(LZ77State_t * state, const uint8_t * sourc
 	state->actualMinLength = DecodeUniversalLomont1(&state->bitstream, 2, 0);          // usually 2
 	state->actualMaxToken = DecodeUniversalLomont1(&state->bitstream, 25, -10);        // 
 	state->actualMaxDistance = DecodeUniversalLomont1(&state->bitstream, 14, -7);      // 
+	state->distanceShift = TokenShift(state->actualMaxDistance);
 	state->byteIndex = 0;
+	if (!LZ77Specialized(state) || !BitstreamFits(sourceLength))
+		state->byteLength = 0; // decoder not built for this stream
 	state->dest = dest;
 	state->destLength = destLength;
+	state->destMask = RingMask(destLength);
+	state->matchLeft = 0;
+#ifdef DECOMPRESSOR_USE_DICTIONARY
+	state->dictionary = 0;
+	state->dictionaryLength = 0;
+#endif
 }
 
+#ifdef DECOMPRESSOR_USE_DICTIONARY
+// Same as DecompressLZ77Start, for data compressed with a preset dictionary. The
+// dictionary is read in place, and must live as long as the state.
+EXPORT_WIN32 void DecompressLZ77StartDictionary(LZ77State_t * state, const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, const uint8_t * dictionary, int32_t dictionaryLength)
+{
+	DecompressLZ77Start(state, source, sourceLength, dest, destLength);
+	state->dictionary = dictionary;
+	state->dictionaryLength = (uint32_t)dictionaryLength;
+}
+#endif
+
 // Call after starting decompression with DecompressLZ77Start to get block of symbols
 // symbols are written into the dest buffer passed in, they are written in a cyclical manner
 // returns number of items decompressed, or CL_COMPRESSOR_END_TOKEN when no more.
 EXPORT_WIN32 uint32_t DecompressLZ77Block(LZ77State_t * state)
 {
 
+	if (state->matchLeft != 0)
+	{
+		// finish run left by DecompressLZ77Partial
+		uint32_t length = state->matchLeft;
+		CopyLZRun(LZ_DICTIONARY(state), state->dest, state->destLength, state->destMask, state->byteIndex, state->matchDistance, length);
+		state->byteIndex += length;
+		state->matchLeft = 0;
+		return length;
+	}
+
 	if (state->byteIndex >= state->byteLength)
 		return CL_COMPRESSOR_END_TOKEN;
 
 	if (ReadBitstream(&state->bitstream, 1) == 0)
 	{
 		// literal
-		uint32_t lit = ReadBitstream(&state->bitstream, state->actualBitsPerSymbol);
-		state->dest[state->byteIndex % state->destLength] = (uint8_t)lit;
+		uint32_t lit = ReadBitstream(&state->bitstream, LZ77_BITS_PER_SYMBOL(state));
+		DECOMPRESSOR_COUNT(literals, 1);
+		state->dest[RingPosition(state->byteIndex, state->destLength, state->destMask)] = (uint8_t)lit;
 		state->byteIndex++;
 		return 1;
 	}
 	else
 	{
 		// run
-		uint32_t token = ReadBitstream(&state->bitstream, state->actualBitsPerToken);
-		// decode token
-		uint32_t length = token / (state->actualMaxDistance + 1) + state->actualMinLength;
-		uint32_t distance = token % (state->actualMaxDistance + 1);
+		uint32_t distance, length;
+		uint32_t token = ReadBitstream(&state->bitstream, LZ77_BITS_PER_TOKEN(state));
+		SplitLZ77Token(state, token, &distance, &length);
+		DECOMPRESSOR_COUNT_MATCH(distance, length);
 
 		// copy run
-		uint32_t i;
-		// positive delta that looks back when taken mod destLength
-		uint32_t delta = state->destLength - distance - 1;
-		for (i = 0; i < length; ++i)
+		CopyLZRun(LZ_DICTIONARY(state), state->dest, state->destLength, state->destMask, state->byteIndex, distance, length);
+		state->byteIndex += length;
+		return length;
+	}
+}
+
+// Decode the whole stream straight into dest, which must hold byteLength bytes
+// Runs reaching before the start or past the end are clipped
+static void DecompressLZ77Linear(LZ77State_t * state)
+{
+	uint8_t * dest = state->dest;
+	uint8_t * end = dest + state->byteLength;
+	uint8_t * out = dest;
+	while (out < end)
+	{
+		if (ReadBitstream(&state->bitstream, 1) == 0)
 		{
-			state->dest[state->byteIndex % state->destLength] =
-				state->dest[(state->byteIndex + delta) % state->destLength];
-			state->byteIndex++;
+			// literal
+			*out++ = (uint8_t)ReadBitstream(&state->bitstream, LZ77_BITS_PER_SYMBOL(state));
+			DECOMPRESSOR_COUNT(literals, 1);
+		}
+		else
+		{
+			// run
+			uint32_t distance, length;
+			uint32_t token = ReadBitstream(&state->bitstream, LZ77_BITS_PER_TOKEN(state));
+			SplitLZ77Token(state, token, &distance, &length);
+			DECOMPRESSOR_COUNT_MATCH(distance, length);
+			if (length > (uint32_t)(end - out))
+				length = (uint32_t)(end - out);
+			if (distance >= (uint32_t)(out - dest))
+			{
+				// starts in the preset dictionary
+				uint32_t n = CopyLZDictionary(LZ_DICTIONARY(state), out, distance + 1 - (uint32_t)(out - dest), length);
+				if (n == 0)
+					break; // corrupt, no such data
+				out += n;
+				length -= n;
+			}
+			CopyLZSpan(out, out - distance - 1, length);
+			out += length;
 		}
-		return length;
 	}
+	state->byteIndex = (uint32_t)(out - dest);
+}
+
+// decode a started state to the end, return bytes decoded
+static int32_t FinishLZ77(LZ77State_t * state)
+{
+	if (state->byteLength <= state->destLength)
+	{
+		// whole output fits, no need for cyclic buffer
+		DecompressLZ77Linear(state);
+		return (int32_t)state->byteIndex;
+	}
+	uint32_t symbolCount = 0;
+	while (symbolCount != CL_COMPRESSOR_END_TOKEN)
+		symbolCount = DecompressLZ77Block(state);
+
+	return (int32_t)state->byteIndex;
 }
 
 // decompress, return bytes decoded
@@ -510,11 +1969,112 @@ EXPORT_WIN32 int32_t DecompressLZ77(const uint8_t * source, int32_t sourceLength
 {
 	LZ77State_t state;
 	DecompressLZ77Start(&state, source, sourceLength, dest, destLength);
-	uint32_t symbolCount = 0;
-	while (symbolCount != CL_COMPRESSOR_END_TOKEN)
-		symbolCount = DecompressLZ77Block(&state);
+	return FinishLZ77(&state);
+}
+
+#ifdef DECOMPRESSOR_USE_DICTIONARY
+// decompress data compressed with a preset dictionary, return bytes decoded
+EXPORT_WIN32 int32_t DecompressLZ77Dictionary(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, const uint8_t * dictionary, int32_t dictionaryLength)
+{
+	LZ77State_t state;
+	DecompressLZ77StartDictionary(&state, source, sourceLength, dest, destLength, dictionary, dictionaryLength);
+	return FinishLZ77(&state);
+}
+#endif
+
+// Copy length bytes from index start in the cyclic buffer to out
+static void ReadLZRing(uint8_t * out, const uint8_t * dest, uint32_t destLength, uint32_t destMask, uint32_t start, uint32_t length)
+{
+	while (length > 0)
+	{
+		uint32_t position = RingPosition(start, destLength, destMask);
+		uint32_t n = length;
+		if (n > destLength - position)
+			n = destLength - position;
+		memcpy(out, dest + position, n);
+		out += n;
+		start += n;
+		length -= n;
+	}
+}
 
-	return (int32_t)state.byteIndex;
+// Call after starting decompression with DecompressLZ77Start to decode up to 
+// maxBytes bytes into out, stopping mid run if needed. The dest buffer is still 
+// used for look-back. Returns number written, 0 when done.
+EXPORT_WIN32 uint32_t DecompressLZ77Partial(LZ77State_t * state, uint8_t * out, uint32_t maxBytes)
+{
+	uint32_t count = 0;
+	while (count < maxBytes)
+	{
+		if (state->matchLeft == 0)
+		{
+			if (state->byteIndex >= state->byteLength)
+				break;
+			if (ReadBitstream(&state->bitstream, 1) == 0)
+			{
+				// literal
+				uint8_t lit = (uint8_t)ReadBitstream(&state->bitstream, LZ77_BITS_PER_SYMBOL(state));
+				DECOMPRESSOR_COUNT(literals, 1);
+				state->dest[RingPosition(state->byteIndex, state->destLength, state->destMask)] = lit;
+				state->byteIndex++;
+				out[count++] = lit;
+				continue;
+			}
+			// run, copied below
+			uint32_t token = ReadBitstream(&state->bitstream, LZ77_BITS_PER_TOKEN(state));
+			SplitLZ77Token(state, token, &state->matchDistance, &state->matchLeft);
+			DECOMPRESSOR_COUNT_MATCH(state->matchDistance, state->matchLeft);
+		}
+
+		// as much of the run as fits
+		uint32_t length = state->matchLeft;
+		if (length > maxBytes - count)
+			length = maxBytes - count;
+		CopyLZRun(LZ_DICTIONARY(state), state->dest, state->destLength, state->destMask, state->byteIndex, state->matchDistance, length);
+		ReadLZRing(out + count, state->dest, state->destLength, state->destMask, state->byteIndex, length);
+		state->byteIndex += length;
+		state->matchLeft -= length;
+		count += length;
+	}
+	return count;
+}
+
+// Send bytes from index start up to end in the cyclic buffer to the sink,
+// as one span, or two where the buffer wraps
+static void SendLZRing(DecompressSink_t sink, void * context, const uint8_t * dest, uint32_t destLength, uint32_t destMask, uint32_t start, uint32_t end)
+{
+	while (start != end)
+	{
+		uint32_t position = RingPosition(start, destLength, destMask);
+		uint32_t length = end - start;
+		if (length > destLength - position)
+			length = destLength - position;
+		sink(context, dest + position, length, start);
+		start += length;
+	}
+}
+
+// Call after starting decompression with DecompressLZ77Start to send all remaining
+// bytes to sink, straight from the dest buffer, in spans of at least chunk bytes.
+// chunk is lowered if needed so unsent bytes are never overwritten. Returns bytes sent.
+EXPORT_WIN32 uint32_t DecompressLZ77ToSink(LZ77State_t * state, DecompressSink_t sink, void * context, uint32_t chunk)
+{
+	uint32_t start = state->byteIndex, sent = state->byteIndex;
+	// unsent bytes plus the longest run must fit in the buffer
+	uint32_t maxRun = state->actualMaxToken / (LZ77_MAX_DISTANCE(state) + 1) + LZ77_MIN_LENGTH(state);
+	uint32_t limit = state->destLength > maxRun ? state->destLength - maxRun : 1;
+	if (chunk > limit)
+		chunk = limit;
+	while (DecompressLZ77Block(state) != CL_COMPRESSOR_END_TOKEN)
+	{
+		if (state->byteIndex - sent >= chunk)
+		{
+			SendLZRing(sink, context, state->dest, state->destLength, state->destMask, sent, state->byteIndex);
+			sent = state->byteIndex;
+		}
+	}
+	SendLZRing(sink, context, state->dest, state->destLength, state->destMask, sent, state->byteIndex);
+	return state->byteIndex - start;
 }
 #endif // DECOMPRESSOR_USE_LZ77
 
@@ -573,193 +2133,918 @@ static uint32_t DecompressGolombSymbol(GolombState_t * state)
 
 /************************* LZCL coding implementation *************************/
 
-static uint32_t DecodeLZCLSymbol(LZCLSubCodec_t * codec)
+// Header values, constants when specialized by DECOMPRESSOR_SPECIALIZE
+#ifdef DECOMPRESSOR_LZCL_MIN_LENGTH
+#define LZCL_MIN_LENGTH(state) (DECOMPRESSOR_LZCL_MIN_LENGTH)
+#else
+#define LZCL_MIN_LENGTH(state) ((state)->actualMinLength)
+#endif
+#ifdef DECOMPRESSOR_LZCL_MAX_DISTANCE
+#define LZCL_MAX_DISTANCE(state) (DECOMPRESSOR_LZCL_MAX_DISTANCE)
+#else
+#define LZCL_MAX_DISTANCE(state) ((state)->actualMaxDistance)
+#endif
+#ifdef DECOMPRESSOR_LZCL_DECISION_RUNS
+#define LZCL_DECISION_RUNS(state) (DECOMPRESSOR_LZCL_DECISION_RUNS)
+#else
+#define LZCL_DECISION_RUNS(state) ((state)->useDecisionRuns)
+#endif
+#ifdef DECOMPRESSOR_LZCL_USE_TOKENS
+#define LZCL_USE_TOKENS(state) (DECOMPRESSOR_LZCL_USE_TOKENS)
+#else
+#define LZCL_USE_TOKENS(state) ((state)->useTokens)
+#endif
+// sub-codec at the given offset in the state
+#define LZCL_SUBCODEC(state, offset) ((LZCLSubCodec_t *)((uint8_t *)(state) + (state)->offset))
+
+// sub-codec types, the decision codec also covers decision runs
+#ifdef DECOMPRESSOR_LZCL_DECISION_CODEC
+#define LZCL_DECISION_CODEC(state) (DECOMPRESSOR_LZCL_DECISION_CODEC)
+#else
+#define LZCL_DECISION_CODEC(state) (LZCL_SUBCODEC(state, decisionOffset)->codecType)
+#endif
+#ifdef DECOMPRESSOR_LZCL_LITERAL_CODEC
+#define LZCL_LITERAL_CODEC(state) (DECOMPRESSOR_LZCL_LITERAL_CODEC)
+#else
+#define LZCL_LITERAL_CODEC(state) (LZCL_SUBCODEC(state, literalOffset)->codecType)
+#endif
+#ifdef DECOMPRESSOR_LZCL_TOKEN_CODEC
+#define LZCL_TOKEN_CODEC(state) (DECOMPRESSOR_LZCL_TOKEN_CODEC)
+#else
+#define LZCL_TOKEN_CODEC(state) (LZCL_SUBCODEC(state, tokenOffset)->codecType)
+#endif
+#ifdef DECOMPRESSOR_LZCL_DISTANCE_CODEC
+#define LZCL_DISTANCE_CODEC(state) (DECOMPRESSOR_LZCL_DISTANCE_CODEC)
+#else
+#define LZCL_DISTANCE_CODEC(state) (LZCL_SUBCODEC(state, tokenOffset)->codecType)
+#endif
+#ifdef DECOMPRESSOR_LZCL_LENGTH_CODEC
+#define LZCL_LENGTH_CODEC(state) (DECOMPRESSOR_LZCL_LENGTH_CODEC)
+#else
+#define LZCL_LENGTH_CODEC(state) (LZCL_SUBCODEC(state, lengthOffset)->codecType)
+#endif
+
+// Decode a symbol with the sub-codec of the given type
+// When codecType is a constant the branches fold away
+static uint32_t DecodeLZCLSymbol(LZCLSubCodec_t * codec, uint32_t codecType)
 {
-	if (codec->codecType == 0)
+	if (codecType == 0)
 		return DecompressFixedSymbol(&codec->fixedState);
-	else if (codec->codecType == 1)
+	else if (codecType == 1)
 		return DecompressArithmeticSymbol(&codec->arithmeticState);
-	else if (codec->codecType == 2)
+	else if (codecType == 2)
 		return DecompressHuffmanSymbol(&codec->huffmanState);
-	else if (codec->codecType == 3)
+	else if (codecType == 3)
 		return DecompressGolombSymbol(&codec->golombState);
+	else if (codecType == 4)
+		return DecodeRansSymbol(&codec->ransState);
 	return 0xBADC0DE;
 }
 
+// Alignment of sub-codecs in the state
+typedef struct
+{
+	uint8_t pad;
+	LZCLSubCodec_t codec;
+} LZCLSubCodecAlign_t;
+#define LZCL_SUBCODEC_ALIGN (offsetof(LZCLSubCodecAlign_t, codec))
+
+// Bytes a sub-codec of the given type takes in the state, Golomb for
+// unknown types, which only read the Golomb header
+static uint32_t LZCLSubCodecSize(uint32_t codecType)
+{
+	uint32_t size = offsetof(LZCLSubCodec_t, fixedState);
+	if (codecType == 0)
+		size += sizeof(FixedState_t);
+	else if (codecType == 1)
+		size += sizeof(ArithmeticState_t);
+	else if (codecType == 2)
+		size += sizeof(HuffmanState_t);
+	else if (codecType == 4)
+		size += sizeof(RansState_t);
+	else
+		size += sizeof(GolombState_t);
+	return (size + LZCL_SUBCODEC_ALIGN - 1) / LZCL_SUBCODEC_ALIGN * LZCL_SUBCODEC_ALIGN;
+}
+
 // Get codec type, a bitstream for it, read the header, advance the bitstream
-// the codec, the bit length, and the bitstream
-static void ReadLZCLItem(LZCLSubCodec_t * decoder, Bitstream_t * bitstream)
+// past the codec. Return the bytes the sub-codec takes in the state
+static uint32_t ReadLZCLItem(LZCLSubCodec_t * decoder, Bitstream_t * bitstream)
 {
-	// get type
-	decoder->codecType = ReadBitstream(bitstream, 2);
+	// get type, clear only the bytes the type uses
+	uint32_t codecType = ReadBitstream(bitstream, 2);
+	memset(decoder, 0, LZCLSubCodecSize(codecType));
+	decoder->codecType = (uint8_t)codecType;
 	
 	// get encoded bit length
-	decoder->bitLength = DecodeUniversalLomont1(bitstream, 6, 0);
+	uint32_t bitLength = DecodeUniversalLomont1(bitstream, 6, 0);
 
 	// prepare a bitstream for the codec, parse header
 	if (decoder->codecType == 0)
 	{
-		decoder->fixedState.bitstream.data = bitstream->data;
-		decoder->fixedState.bitstream.position = bitstream->position;
+		decoder->fixedState.bitstream = *bitstream;
 		ReadFixedHeaderNoLength(&decoder->fixedState);
 	}
 	else if (decoder->codecType == 1)
 	{
-		decoder->arithmeticState.bitstream.data = bitstream->data;
-		decoder->arithmeticState.bitstream.position = bitstream->position;
+		decoder->arithmeticState.bitstream = *bitstream;
 		ReadArithmeticHeaderNoLength(&decoder->arithmeticState);
+		decoder->arithmeticState.symbolsLeft = 0xFFFFFFFF; // mark continual run
 	}
 	else if (decoder->codecType == 2)
 	{
-		decoder->huffmanState.bitstream.data = bitstream->data;
-		decoder->huffmanState.bitstream.position = bitstream->position;
+		decoder->huffmanState.bitstream = *bitstream;
 		ReadHuffmanHeaderNoLength(&decoder->huffmanState);
 		decoder->huffmanState.byteLength = 0xFFFFFFFF; // mark continual run
 	}
 	else if (decoder->codecType == 3)
 	{
-		decoder->golombState.bitstream.data = bitstream->data;
-		decoder->golombState.bitstream.position = bitstream->position;
+		decoder->golombState.bitstream = *bitstream;
 		ReadGolombHeaderNoLength(&decoder->golombState);
+		if (decoder->golombState.parameter == 0)
+		{
+			// Golomb never uses parameter 0, which escapes to types 4 and up
+			Bitstream_t bs = decoder->golombState.bitstream;
+			decoder->codecType = (uint8_t)(4 + DecodeUniversalLomont1(&bs, 2, 0));
+			if (decoder->codecType == 4)
+			{
+				memset(&decoder->ransState, 0, sizeof(RansState_t));
+				decoder->ransState.bitstream = bs;
+				ReadRansHeaderNoLength(&decoder->ransState);
+				decoder->ransState.symbolsLeft = 0xFFFFFFFF; // mark continual run
+			}
+		}
 	}
 	//else // todo - error?
 	//	throw new NotImplementedException("Unknown compressor type");
 
 	// skip general bitstream ahead
-	bitstream->position += decoder->bitLength;
+	SkipBitstream(bitstream, bitLength);
+	return LZCLSubCodecSize(decoder->codecType);
+}
+
+// Skip a sub-codec in the header, return the bytes it takes in the state
+static uint32_t SkipLZCLItem(Bitstream_t * bitstream)
+{
+	uint32_t codecType = ReadBitstream(bitstream, 2);
+	uint32_t bitLength = DecodeUniversalLomont1(bitstream, 6, 0);
+	Bitstream_t bs = *bitstream;
+	if (codecType == 3 && DecodeUniversalLomont1(&bs, 6, 0) == 0)
+		codecType = 4 + DecodeUniversalLomont1(&bs, 2, 0); // escaped type, as in ReadLZCLItem
+	SkipBitstream(bitstream, bitLength);
+	return LZCLSubCodecSize(codecType);
 }
 
 static uint32_t GetLZCLDecision(LZCLState_t * state)
 {
-	if (state->useDecisionRuns == 0)
-		return DecodeLZCLSymbol(&state->decisionCodec);
+	if (LZCL_DECISION_RUNS(state) == 0)
+		return DecodeLZCLSymbol(LZCL_SUBCODEC(state, decisionOffset), LZCL_DECISION_CODEC(state));
 	if (state->curRun == -1)
 	{
-		state->curRun = (int)state->initialValue;
-		state->runsLeft = DecodeLZCLSymbol(&state->decisionRunCodec);
+		state->curRun = (int8_t)state->initialValue;
+		state->runsLeft = DecodeLZCLSymbol(LZCL_SUBCODEC(state, decisionOffset), LZCL_DECISION_CODEC(state));
 	}
 	if (state->runsLeft == 0)
 	{
 		state->curRun ^= 1; // toggle direction
-		state->runsLeft = DecodeLZCLSymbol(&state->decisionRunCodec);
+		state->runsLeft = DecodeLZCLSymbol(LZCL_SUBCODEC(state, decisionOffset), LZCL_DECISION_CODEC(state));
 	}
 	--state->runsLeft;
 	return (uint32_t)state->curRun;
 }
 
+// Call when GetLZCLDecision returns a literal. Return how many more literals
+// follow in its decision run, up to max, and take them from the run
+static uint32_t TakeLZCLLiteralRun(LZCLState_t * state, uint32_t max)
+{
+	uint32_t count;
+	if (LZCL_DECISION_RUNS(state) == 0)
+		return 0; // each decision is coded separately
+	count = state->runsLeft < max ? state->runsLeft : max;
+	state->runsLeft -= count;
+	return count;
+}
+
+// Decode count literals into out. The literal codec is chosen once per
+// call, then each type decodes in its own loop
+static void DecodeLZCLLiterals(LZCLState_t * state, uint8_t * out, uint32_t count)
+{
+	LZCLSubCodec_t * codec = LZCL_SUBCODEC(state, literalOffset);
+	uint32_t i;
+	switch (LZCL_LITERAL_CODEC(state))
+	{
+	case 0:
+		for (i = 0; i < count; ++i)
+			out[i] = (uint8_t)DecompressFixedSymbol(&codec->fixedState);
+		break;
+	case 1:
+		for (i = 0; i < count; ++i)
+			out[i] = (uint8_t)DecompressArithmeticSymbol(&codec->arithmeticState);
+		break;
+	case 2:
+		DecompressHuffmanBlock(&codec->huffmanState, out, count);
+		break;
+	case 3:
+		for (i = 0; i < count; ++i)
+			out[i] = (uint8_t)DecompressGolombSymbol(&codec->golombState);
+		break;
+	case 4:
+		for (i = 0; i < count; ++i)
+			out[i] = (uint8_t)DecodeRansSymbol(&codec->ransState);
+		break;
+	default:
+		memset(out, (uint8_t)0xBADC0DE, count);
+		break;
+	}
+}
+
+// Decode a literal just decided and up to maxCount - 1 more from its run into
+// the cyclic buffer, in spans that do not wrap. Return the number decoded
+static uint32_t DecodeLZCLLiteralRun(LZCLState_t * state, uint32_t maxCount)
+{
+	uint32_t count = 1 + TakeLZCLLiteralRun(state, maxCount - 1), left = count;
+	DECOMPRESSOR_COUNT(literals, count);
+	while (left > 0)
+	{
+		uint32_t d = RingPosition(state->byteIndex, state->destLength, state->destMask);
+		uint32_t n = left;
+		if (n > state->destLength - d)
+			n = state->destLength - d;
+		DecodeLZCLLiterals(state, state->dest + d, n);
+		state->byteIndex += n;
+		left -= n;
+	}
+	return count;
+}
+
+// Most literals to decode into the cyclic buffer at once, keeping the
+// look-back window of max distance + 1 bytes, and at least 1
+static uint32_t LZCLLiteralLimit(const LZCLState_t * state)
+{
+	uint32_t window = LZCL_MAX_DISTANCE(state) + 1;
+	uint32_t limit = state->destLength > window ? state->destLength - window : 1;
+	uint32_t left = state->byteLength - state->byteIndex;
+	return limit < left ? limit : left;
+}
+
 static void GetLZCLDecodedToken(LZCLState_t * state, uint32_t * distance1, uint32_t * length1)
 {
-	if (state->useTokens == 0)
+	if (LZCL_USE_TOKENS(state) == 0)
 	{
-		*distance1 = DecodeLZCLSymbol(&state->distanceCodec);
-		*length1 = DecodeLZCLSymbol(&state->lengthCodec) + state->actualMinLength;
+		*distance1 = DecodeLZCLSymbol(LZCL_SUBCODEC(state, tokenOffset), LZCL_DISTANCE_CODEC(state));
+		*length1 = DecodeLZCLSymbol(LZCL_SUBCODEC(state, lengthOffset), LZCL_LENGTH_CODEC(state)) + LZCL_MIN_LENGTH(state);
 	}
 	else
 	{
-		uint32_t token = DecodeLZCLSymbol(&state->tokenCodec);
-		*length1 = token / (state->actualMaxDistance + 1) + state->actualMinLength;
-		*distance1 = token % (state->actualMaxDistance + 1);
+		uint32_t token = DecodeLZCLSymbol(LZCL_SUBCODEC(state, tokenOffset), LZCL_TOKEN_CODEC(state));
+#ifndef DECOMPRESSOR_LZCL_MAX_DISTANCE // a constant divisor is already cheap
+		if (state->distanceShift != 0)
+		{
+			*length1 = (token >> state->distanceShift) + LZCL_MIN_LENGTH(state);
+			*distance1 = token & state->actualMaxDistance;
+			return;
+		}
+#endif
+		*length1 = token / (LZCL_MAX_DISTANCE(state) + 1) + LZCL_MIN_LENGTH(state);
+		*distance1 = token % (LZCL_MAX_DISTANCE(state) + 1);
 	}
 }
 
 
+// Return 1 if header values match those fixed by DECOMPRESSOR_SPECIALIZE, else 0
+static uint32_t LZCLSpecialized(const LZCLState_t * state)
+{
+	uint32_t match = 1;
+#ifdef DECOMPRESSOR_LZCL_MIN_LENGTH
+	match &= state->actualMinLength == DECOMPRESSOR_LZCL_MIN_LENGTH;
+#endif
+#ifdef DECOMPRESSOR_LZCL_MAX_DISTANCE
+	match &= state->actualMaxDistance == DECOMPRESSOR_LZCL_MAX_DISTANCE;
+#endif
+#ifdef DECOMPRESSOR_LZCL_DECISION_RUNS
+	match &= state->useDecisionRuns == DECOMPRESSOR_LZCL_DECISION_RUNS;
+#endif
+#ifdef DECOMPRESSOR_LZCL_USE_TOKENS
+	match &= state->useTokens == DECOMPRESSOR_LZCL_USE_TOKENS;
+#endif
+#ifdef DECOMPRESSOR_LZCL_DECISION_CODEC
+	match &= LZCL_SUBCODEC(state, decisionOffset)->codecType == DECOMPRESSOR_LZCL_DECISION_CODEC;
+#endif
+#ifdef DECOMPRESSOR_LZCL_LITERAL_CODEC
+	match &= LZCL_SUBCODEC(state, literalOffset)->codecType == DECOMPRESSOR_LZCL_LITERAL_CODEC;
+#endif
+#ifdef DECOMPRESSOR_LZCL_TOKEN_CODEC
+	match &= state->useTokens == 1 && LZCL_SUBCODEC(state, tokenOffset)->codecType == DECOMPRESSOR_LZCL_TOKEN_CODEC;
+#endif
+#ifdef DECOMPRESSOR_LZCL_DISTANCE_CODEC
+	match &= state->useTokens == 0 && LZCL_SUBCODEC(state, tokenOffset)->codecType == DECOMPRESSOR_LZCL_DISTANCE_CODEC;
+#endif
+#ifdef DECOMPRESSOR_LZCL_LENGTH_CODEC
+	match &= state->useTokens == 0 && LZCL_SUBCODEC(state, lengthOffset)->codecType == DECOMPRESSOR_LZCL_LENGTH_CODEC;
+#endif
+	(void)state;
+	return match;
+}
+
 // Read the header for the compression algorithm
 // Return number of symbols in stream if known, else 0 if not present
 EXPORT_WIN32 uint32_t DecompressLZCLStart(LZCLState_t * state, const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength)
 {
-	// initalize state
-	memset(state, 0, sizeof(LZCLState_t));
+	// initalize state, the sub-codecs are filled in as read
+	memset(state, 0, offsetof(LZCLState_t, codecs));
 	state->curRun = -1;
 
 	// save info about buffer we can write into
 	state->dest = dest;
 	state->destLength = destLength;
+	state->destMask = RingMask(destLength);
+
+	if (!BitstreamFits(sourceLength))
+		return 0; // positions do not fit, decoder not built for this stream
 
 	// prepare bitstream
-	InitializeBitstream(&state->bitstream, source);
+	InitializeBitstream(&state->bitstream, source, (uint32_t)sourceLength);
 
 	// read header values
 	state->byteLength = DecodeUniversalLomont1(&state->bitstream, 6, 0);  // number of bytes to decompress
 	state->actualMaxDistance = DecodeUniversalLomont1(&state->bitstream, 10, 0); // max distance occurring
+	state->distanceShift = TokenShift(state->actualMaxDistance);
 	state->actualMinLength = DecodeUniversalLomont1(&state->bitstream, 2, 0);  // min length occurring
 
+	// sub-codecs are packed one after another, each taking only the size of its type
+	uint32_t offset = offsetof(LZCLState_t, codecs);
+
 	// see if decisions or decision runs
 	if (ReadBitstream(&state->bitstream, 1) == 0)
-	{
 		state->useDecisionRuns = 0;
-		ReadLZCLItem(&state->decisionCodec, &state->bitstream);
-	}
 	else
 	{
 		state->useDecisionRuns = 1;
 		// read initial value
-		state->initialValue = ReadBitstream(&state->bitstream, 1);
-		// read item
-		ReadLZCLItem(&state->decisionRunCodec, &state->bitstream);
+		state->initialValue = (uint8_t)ReadBitstream(&state->bitstream, 1);
 	}
+	state->decisionOffset = (uint16_t)offset;
+	offset += ReadLZCLItem(LZCL_SUBCODEC(state, decisionOffset), &state->bitstream);
 
 	// literals
-	ReadLZCLItem(&state->literalCodec, &state->bitstream);
+	state->literalOffset = (uint16_t)offset;
+	offset += ReadLZCLItem(LZCL_SUBCODEC(state, literalOffset), &state->bitstream);
+
+	// tokens or separate distance, length pairs, distances share the token slot
+	state->useTokens = ReadBitstream(&state->bitstream, 1) == 0 ? 1 : 0;
+	state->tokenOffset = (uint16_t)offset;
+	offset += ReadLZCLItem(LZCL_SUBCODEC(state, tokenOffset), &state->bitstream);
+	if (!state->useTokens)
+	{
+		state->lengthOffset = (uint16_t)offset;
+		ReadLZCLItem(LZCL_SUBCODEC(state, lengthOffset), &state->bitstream);
+	}
+	else
+		state->lengthOffset = state->tokenOffset; // unused
 
-	// tokens or separate distance, length pairs
-	if (ReadBitstream(&state->bitstream, 1) == 0)
-		 ReadLZCLItem(&state->tokenCodec, &state->bitstream);
+	if (!LZCLSpecialized(state))
+		state->byteLength = 0; // decoder not built for this stream
+	return state->byteLength;
+}
+
+// Bytes of LZCLState_t the given stream needs. The sub-codecs at the end of the
+// state take only the size of their type, so a state allocated with this many
+// bytes may be smaller than sizeof(LZCLState_t), and never larger.
+EXPORT_WIN32 uint32_t DecompressLZCLStateSize(const uint8_t * source, int32_t sourceLength)
+{
+	uint32_t size = offsetof(LZCLState_t, codecs);
+	if (!BitstreamFits(sourceLength))
+		return size; // Start decodes nothing, needs no sub-codecs
+
+	Bitstream_t bitstream;
+	InitializeBitstream(&bitstream, source, (uint32_t)sourceLength);
+
+	// same header walk as DecompressLZCLStart
+	DecodeUniversalLomont1(&bitstream, 6, 0);  // number of bytes to decompress
+	DecodeUniversalLomont1(&bitstream, 10, 0); // max distance occurring
+	DecodeUniversalLomont1(&bitstream, 2, 0);  // min length occurring
+	if (ReadBitstream(&bitstream, 1) != 0)
+		ReadBitstream(&bitstream, 1); // decision runs initial value
+	size += SkipLZCLItem(&bitstream); // decisions or decision runs
+	size += SkipLZCLItem(&bitstream); // literals
+	if (ReadBitstream(&bitstream, 1) == 0)
+		size += SkipLZCLItem(&bitstream); // tokens
 	else
 	{
-		 ReadLZCLItem(&state->distanceCodec, &state->bitstream);
-		 ReadLZCLItem(&state->lengthCodec, &state->bitstream);
+		size += SkipLZCLItem(&bitstream); // distances
+		size += SkipLZCLItem(&bitstream); // lengths
 	}
+	return size;
+}
+
+#ifdef DECOMPRESSOR_USE_DICTIONARY
+// Same as DecompressLZCLStart, for data compressed with a preset dictionary. The
+// dictionary is read in place, and must live as long as the state.
+EXPORT_WIN32 uint32_t DecompressLZCLStartDictionary(LZCLState_t * state, const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, const uint8_t * dictionary, int32_t dictionaryLength)
+{
+	DecompressLZCLStart(state, source, sourceLength, dest, destLength);
+	state->dictionary = dictionary;
+	state->dictionaryLength = (uint32_t)dictionaryLength;
 	return state->byteLength;
 }
+#endif
+
+// Decode a run or literal run of at most maxLiterals, see DecompressLZCLBlock
+static uint32_t DecodeLZCLStep(LZCLState_t * state, uint32_t maxLiterals)
+{
+	if (state->matchLeft != 0)
+	{
+		// finish run left by DecompressLZCLPartial
+		uint32_t length = state->matchLeft;
+		CopyLZRun(LZ_DICTIONARY(state), state->dest, state->destLength, state->destMask, state->byteIndex, state->matchDistance, length);
+		state->byteIndex += length;
+		state->matchLeft = 0;
+		return length;
+	}
+
+	if (state->byteIndex >= state->byteLength)
+		return CL_COMPRESSOR_END_TOKEN;
+
+	if (GetLZCLDecision(state) == 0)
+	{
+		// literal, and the rest of its decision run that fits
+		uint32_t limit = LZCLLiteralLimit(state);
+		return DecodeLZCLLiteralRun(state, limit < maxLiterals ? limit : maxLiterals);
+	}
+	else
+	{
+		// token - either a single token or a token pair
+		uint32_t distance, length;
+		GetLZCLDecodedToken(state,&distance,&length);
+		DECOMPRESSOR_COUNT_MATCH(distance, length);
+
+		// copy run
+		CopyLZRun(LZ_DICTIONARY(state), state->dest, state->destLength, state->destMask, state->byteIndex, distance, length);
+		state->byteIndex += length;
+		return length;
+	}
+}
 
 // Call after starting decompression with DecompressLZCLStart to get block of symbols
 // symbols are written into the dest buffer passed in, they are written in a cyclical manner
 // returns number of items decompressed, or CL_COMPRESSOR_END_TOKEN when no more.
+// A literal run decodes in one call, as far as the look-back window allows.
 EXPORT_WIN32 uint32_t DecompressLZCLBlock(LZCLState_t * state)
 {
-	if (state->byteIndex >= state->byteLength)
-		return CL_COMPRESSOR_END_TOKEN;
+	return DecodeLZCLStep(state, 0xFFFFFFFF);
+}
 
+// Decode the whole stream straight into dest, which must hold byteLength bytes
+// Runs reaching before the start or past the end are clipped
+static void DecompressLZCLLinear(LZCLState_t * state)
+{
+	uint8_t * dest = state->dest;
+	uint8_t * end = dest + state->byteLength;
+	uint8_t * out = dest;
+	while (out < end)
+	{
 		if (GetLZCLDecision(state) == 0)
 		{
-			// literal
-			uint32_t symbol = DecodeLZCLSymbol(&state->literalCodec);
-			state->dest[state->byteIndex % state->destLength] = (uint8_t)symbol;
-			state->byteIndex++;
-			return 1;
+			// literal, and the rest of its decision run
+			uint32_t count = 1 + TakeLZCLLiteralRun(state, (uint32_t)(end - out) - 1);
+			DECOMPRESSOR_COUNT(literals, count);
+			DecodeLZCLLiterals(state, out, count);
+			out += count;
 		}
 		else
 		{
 			// token - either a single token or a token pair
 			uint32_t distance, length;
-			GetLZCLDecodedToken(state,&distance,&length);
-
-			// copy run
-			uint32_t i;
-			// positive delta that looks back when taken mod destLength
-			uint32_t delta = state->destLength - distance - 1;
-			for (i = 0; i < length; ++i)
+			GetLZCLDecodedToken(state, &distance, &length);
+			DECOMPRESSOR_COUNT_MATCH(distance, length);
+			if (length > (uint32_t)(end - out))
+				length = (uint32_t)(end - out);
+			if (distance >= (uint32_t)(out - dest))
 			{
-				state->dest[state->byteIndex % state->destLength] =
-					state->dest[(state->byteIndex + delta) % state->destLength];
-				state->byteIndex++;
+				// starts in the preset dictionary
+				uint32_t n = CopyLZDictionary(LZ_DICTIONARY(state), out, distance + 1 - (uint32_t)(out - dest), length);
+				if (n == 0)
+					break; // corrupt, no such data
+				out += n;
+				length -= n;
 			}
-			return length;
+			CopyLZSpan(out, out - distance - 1, length);
+			out += length;
 		}
+	}
+	state->byteIndex = (uint32_t)(out - dest);
 }
 
- // decompress, return bytes decoded
- EXPORT_WIN32 int32_t DecompressLZCL(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength)
- {
-	 LZCLState_t state;
-	 DecompressLZCLStart(&state, source, sourceLength, dest, destLength);
-	 uint32_t symbolCount = 0;
-	 while (symbolCount != CL_COMPRESSOR_END_TOKEN)
-		 symbolCount = DecompressLZCLBlock(&state);
+// decode a started state to the end, return bytes decoded
+static int32_t FinishLZCL(LZCLState_t * state)
+{
+	if (state->byteLength <= state->destLength)
+	{
+		// whole output fits, no need for cyclic buffer
+		DecompressLZCLLinear(state);
+		return (int32_t)state->byteIndex;
+	}
+	uint32_t symbolCount = 0;
+	while (symbolCount != CL_COMPRESSOR_END_TOKEN)
+		symbolCount = DecompressLZCLBlock(state);
 
-	 return (int32_t)state.byteIndex;
- }
+	return (int32_t)state->byteIndex;
+}
+
+// decompress, return bytes decoded
+EXPORT_WIN32 int32_t DecompressLZCL(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength)
+{
+	LZCLState_t state;
+	DecompressLZCLStart(&state, source, sourceLength, dest, destLength);
+	return FinishLZCL(&state);
+}
+
+#ifdef DECOMPRESSOR_USE_DICTIONARY
+// decompress data compressed with a preset dictionary, return bytes decoded
+EXPORT_WIN32 int32_t DecompressLZCLDictionary(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, const uint8_t * dictionary, int32_t dictionaryLength)
+{
+	LZCLState_t state;
+	DecompressLZCLStartDictionary(&state, source, sourceLength, dest, destLength, dictionary, dictionaryLength);
+	return FinishLZCL(&state);
+}
+#endif
+
+// Call after starting decompression with DecompressLZCLStart to decode up to 
+// maxBytes bytes into out, stopping mid run if needed. The dest buffer is still 
+// used for look-back. Returns number written, 0 when done.
+EXPORT_WIN32 uint32_t DecompressLZCLPartial(LZCLState_t * state, uint8_t * out, uint32_t maxBytes)
+{
+	uint32_t count = 0;
+	while (count < maxBytes)
+	{
+		if (state->matchLeft == 0)
+		{
+			if (state->byteIndex >= state->byteLength)
+				break;
+			if (GetLZCLDecision(state) == 0)
+			{
+				// literal, and the rest of its decision run that fits
+				uint32_t limit = LZCLLiteralLimit(state), start = state->byteIndex, n;
+				if (limit > maxBytes - count)
+					limit = maxBytes - count;
+				n = DecodeLZCLLiteralRun(state, limit);
+				ReadLZRing(out + count, state->dest, state->destLength, state->destMask, start, n);
+				count += n;
+				continue;
+			}
+			// token, copied below
+			GetLZCLDecodedToken(state, &state->matchDistance, &state->matchLeft);
+			DECOMPRESSOR_COUNT_MATCH(state->matchDistance, state->matchLeft);
+		}
+
+		// as much of the run as fits
+		uint32_t length = state->matchLeft;
+		if (length > maxBytes - count)
+			length = maxBytes - count;
+		CopyLZRun(LZ_DICTIONARY(state), state->dest, state->destLength, state->destMask, state->byteIndex, state->matchDistance, length);
+		ReadLZRing(out + count, state->dest, state->destLength, state->destMask, state->byteIndex, length);
+		state->byteIndex += length;
+		state->matchLeft -= length;
+		count += length;
+	}
+	return count;
+}
+
+// Call after starting decompression with DecompressLZCLStart to send all remaining
+// bytes to sink, straight from the dest buffer, in spans of at least chunk bytes.
+// chunk plus the longest run must fit in the dest buffer. Returns bytes sent.
+EXPORT_WIN32 uint32_t DecompressLZCLToSink(LZCLState_t * state, DecompressSink_t sink, void * context, uint32_t chunk)
+{
+	uint32_t start = state->byteIndex, sent = state->byteIndex;
+	// literal runs stop where unsent bytes would be overwritten
+	uint32_t maxLiterals = state->destLength > chunk ? state->destLength - chunk : 1;
+	while (DecodeLZCLStep(state, maxLiterals) != CL_COMPRESSOR_END_TOKEN)
+	{
+		if (state->byteIndex - sent >= chunk)
+		{
+			SendLZRing(sink, context, state->dest, state->destLength, state->destMask, sent, state->byteIndex);
+			sent = state->byteIndex;
+		}
+	}
+	SendLZRing(sink, context, state->dest, state->destLength, state->destMask, sent, state->byteIndex);
+	return state->byteIndex - start;
+}
 
 #endif // DECOMPRESSOR_USE_LZCL
 
+/************************* Block container implementation *********************/
+#ifdef DECOMPRESSOR_USE_BLOCKS
+
+// Read the container header, return total bytes in the container
+// buffer is the look-back buffer for LZ77 and LZCL blocks, sized as for
+// incremental decoding, and may be 0 for Huffman and Arithmetic
+EXPORT_WIN32 uint32_t DecompressBlocksStart(BlockState_t * state, const uint8_t * source, int32_t sourceLength, uint8_t * buffer, int32_t bufferLength)
+{
+	Bitstream_t bitstream;
+	InitializeBitstream(&bitstream, source, (uint32_t)sourceLength);
+
+	state->source = source;
+	state->sourceLength = (uint32_t)sourceLength;
+	state->buffer = buffer;
+	state->bufferLength = (uint32_t)bufferLength;
+
+	// header values
+	state->byteLength = DecodeUniversalLomont1(&bitstream, 6, 0);
+	state->blockSize = DecodeUniversalLomont1(&bitstream, 6, 0);
+	state->codecType = (uint8_t)ReadBitstream(&bitstream, 2);
+	state->bitsPerOffset = (uint8_t)DecodeUniversalLomont1(&bitstream, 3, 0);
+	if (state->blockSize == 0)
+		state->byteLength = 0; // corrupt, treat as empty
+	state->blockCount = state->byteLength == 0 ? 0 : (state->byteLength + state->blockSize - 1) / state->blockSize;
+	state->indexPosition = bitstream.position;
+	state->dataStart = (state->indexPosition + state->blockCount * state->bitsPerOffset + 7) / 8;
+
+	state->byteIndex = 0;
+	state->blockIndex = state->blockCount; // none started
+	return state->byteLength;
+}
+
+// Get the compressed bytes of a block
+static const uint8_t * GetBlockSource(const BlockState_t * state, uint32_t blockIndex, int32_t * sourceLength)
+{
+	Bitstream_t bitstream;
+	uint32_t start = 0, end, first;
+	uint32_t position = state->indexPosition + blockIndex * state->bitsPerOffset;
+	if (blockIndex > 0)
+		position -= state->bitsPerOffset; // block starts where the previous one ends
+	// read from the byte holding the offsets, so positions stay small
+	first = position / 8;
+	position -= 8 * first;
+	InitializeBitstream(&bitstream, state->source + first, state->sourceLength - first);
+	if (blockIndex > 0)
+		start = ReadFromBitstreamPosition(&bitstream, &position, state->bitsPerOffset);
+	end = ReadFromBitstreamPosition(&bitstream, &position, state->bitsPerOffset);
+	*sourceLength = (int32_t)(end - start);
+	return state->source + state->dataStart + start;
+}
+
+// Decompress block blockIndex into dest in one call, return bytes decoded
+// Does not change state, so blocks may be decoded in any order
+EXPORT_WIN32 int32_t DecompressBlock(const BlockState_t * state, uint32_t blockIndex, uint8_t * dest, int32_t destLength)
+{
+	int32_t sourceLength;
+	const uint8_t * source;
+	if (blockIndex >= state->blockCount)
+		return 0;
+	source = GetBlockSource(state, blockIndex, &sourceLength);
+	switch (state->codecType)
+	{
+#ifdef DECOMPRESSOR_USE_HUFFMAN
+	case 0:
+		return DecompressHuffman(source, sourceLength, dest, destLength);
+#endif
+#ifdef DECOMPRESSOR_USE_ARITHMETIC
+	case 1:
+		return DecompressArithmetic(source, sourceLength, dest, destLength);
+#endif
+#ifdef DECOMPRESSOR_USE_LZ77
+	case 2:
+		return DecompressLZ77(source, sourceLength, dest, destLength);
+#endif
+#ifdef DECOMPRESSOR_USE_LZCL
+	case 3:
+		return DecompressLZCL(source, sourceLength, dest, destLength);
+#endif
+	default:
+		return 0; // decoder not included
+	}
+}
+
+// Start incremental decoding of a block from a copy of its data at source
+static void StartBlockFrom(BlockState_t * state, uint32_t blockIndex, const uint8_t * source, int32_t sourceLength)
+{
+	state->blockIndex = blockIndex;
+	state->byteIndex = blockIndex * state->blockSize;
+	switch (state->codecType)
+	{
+#ifdef DECOMPRESSOR_USE_HUFFMAN
+	case 0:
+		DecompressHuffmanStart(&state->huffmanState, source, sourceLength);
+		break;
+#endif
+#ifdef DECOMPRESSOR_USE_ARITHMETIC
+	case 1:
+		DecompressArithmeticStart(&state->arithmeticState, source, sourceLength);
+		break;
+#endif
+#ifdef DECOMPRESSOR_USE_LZ77
+	case 2:
+		DecompressLZ77Start(&state->lz77State, source, sourceLength, state->buffer, (int32_t)state->bufferLength);
+		break;
+#endif
+#ifdef DECOMPRESSOR_USE_LZCL
+	case 3:
+		DecompressLZCLStart(&state->lzclState, source, sourceLength, state->buffer, (int32_t)state->bufferLength);
+		break;
+#endif
+	default:
+		state->blockIndex = state->blockCount; // decoder not included
+		break;
+	}
+}
+
+// Start incremental decoding of a block
+static void StartBlock(BlockState_t * state, uint32_t blockIndex)
+{
+	int32_t sourceLength;
+	const uint8_t * source = GetBlockSource(state, blockIndex, &sourceLength);
+	StartBlockFrom(state, blockIndex, source, sourceLength);
+}
+
+// Decode up to maxBytes from the current block, return number written
+static uint32_t ReadBlock(BlockState_t * state, uint8_t * out, uint32_t maxBytes)
+{
+	switch (state->codecType)
+	{
+#ifdef DECOMPRESSOR_USE_HUFFMAN
+	case 0:
+		return DecompressHuffmanPartial(&state->huffmanState, out, maxBytes);
+#endif
+#ifdef DECOMPRESSOR_USE_ARITHMETIC
+	case 1:
+		return DecompressArithmeticPartial(&state->arithmeticState, out, maxBytes);
+#endif
+#ifdef DECOMPRESSOR_USE_LZ77
+	case 2:
+		return DecompressLZ77Partial(&state->lz77State, out, maxBytes);
+#endif
+#ifdef DECOMPRESSOR_USE_LZCL
+	case 3:
+		return DecompressLZCLPartial(&state->lzclState, out, maxBytes);
+#endif
+	default:
+		return 0;
+	}
+}
+
+// Move the read position to offset, decoding only the block holding it
+// Return 1 on success, 0 if offset is past the end
+EXPORT_WIN32 uint32_t DecompressSeek(BlockState_t * state, uint32_t offset)
+{
+	uint8_t skip[DECOMPRESSOR_SINK_BUFFER];
+	if (offset >= state->byteLength)
+		return 0;
+
+	// restart unless moving forward in the current block
+	uint32_t blockIndex = offset / state->blockSize;
+	if (blockIndex != state->blockIndex || offset < state->byteIndex)
+		StartBlock(state, blockIndex);
+	if (state->blockIndex >= state->blockCount)
+		return 0; // decoder not included
+
+	// decode and drop bytes before offset
+	while (state->byteIndex < offset)
+	{
+		uint32_t length = offset - state->byteIndex;
+		if (length > sizeof(skip))
+			length = sizeof(skip);
+		length = ReadBlock(state, skip, length);
+		if (length == 0)
+			return 0; // corrupt block
+		state->byteIndex += length;
+	}
+	return 1;
+}
+
+// Decode up to maxBytes bytes from the read position into out, continuing
+// across blocks. Returns number written, 0 when done.
+EXPORT_WIN32 uint32_t DecompressBlocksPartial(BlockState_t * state, uint8_t * out, uint32_t maxBytes)
+{
+	uint32_t count = 0;
+	while (count < maxBytes && state->byteIndex < state->byteLength)
+	{
+		if (state->blockIndex >= state->blockCount)
+		{
+			StartBlock(state, state->byteIndex / state->blockSize);
+			if (state->blockIndex >= state->blockCount)
+				break; // decoder not included
+		}
+		uint32_t length = ReadBlock(state, out + count, maxBytes - count);
+		if (length == 0)
+		{
+			// block done, move to the next one
+			if (state->byteIndex != (state->blockIndex + 1) * state->blockSize)
+				break; // corrupt block
+			StartBlock(state, state->blockIndex + 1);
+			continue;
+		}
+		state->byteIndex += length;
+		count += length;
+	}
+	return count;
+}
+
+// Decompress bytes offset to offset+length-1 into dest, decoding only the
+// blocks needed. Return bytes decoded.
+EXPORT_WIN32 int32_t DecompressRange(BlockState_t * state, uint32_t offset, uint32_t length, uint8_t * dest)
+{
+	uint32_t count = 0;
+	if (DecompressSeek(state, offset) == 0)
+		return 0;
+	while (count < length)
+	{
+		uint32_t n = DecompressBlocksPartial(state, dest + count, length - count);
+		if (n == 0)
+			break;
+		count += n;
+	}
+	return (int32_t)count;
+}
+
+#ifdef DECOMPRESSOR_USE_PIPELINE
+// Start filling input with block blockIndex, return its length, or 0 if the
+// block is too large. Without a fill hook, point at the block in place.
+static uint32_t FillPipelineBlock(const BlockState_t * state, const DecompressPipeline_t * pipeline, uint32_t blockIndex, uint8_t * input, uint32_t inputLength, const uint8_t ** blockSource)
+{
+	int32_t sourceLength;
+	const uint8_t * source = GetBlockSource(state, blockIndex, &sourceLength);
+	if (pipeline->fill == 0)
+	{
+		*blockSource = source;
+		return (uint32_t)sourceLength;
+	}
+	if ((uint32_t)sourceLength > inputLength)
+		return 0;
+	pipeline->fill(pipeline->context, source, input, (uint32_t)sourceLength);
+	*blockSource = input;
+	return (uint32_t)sourceLength;
+}
+
+// Start draining length bytes of output, after the previous drain is done
+static void DrainPipeline(const DecompressPipeline_t * pipeline, const uint8_t * output, uint32_t length, uint32_t * draining)
+{
+	if (*draining && pipeline->drainWait != 0)
+		pipeline->drainWait(pipeline->context);
+	pipeline->drain(pipeline->context, output, length);
+	*draining = 1;
+}
+
+EXPORT_WIN32 uint32_t DecompressPipelined(BlockState_t * state, const DecompressPipeline_t * pipeline, uint8_t * input, uint32_t inputLength, uint8_t * output, uint32_t outputLength)
+{
+	uint32_t blockIndex, total = 0, used = 0, half = 0, draining = 0, filling;
+	const uint8_t * source, * nextSource = 0;
+	uint32_t sourceLength, nextLength;
+	if (state->blockCount == 0 || outputLength == 0)
+		return 0;
+	nextLength = FillPipelineBlock(state, pipeline, 0, input, inputLength, &nextSource);
+	filling = pipeline->fill != 0 && nextLength != 0;
+
+	for (blockIndex = 0; blockIndex < state->blockCount && nextLength != 0; ++blockIndex)
+	{
+		// wait for this block, then start filling the next into the other half
+		if (filling && pipeline->fillWait != 0)
+			pipeline->fillWait(pipeline->context);
+		filling = 0;
+		source = nextSource;
+		sourceLength = nextLength;
+		if (blockIndex + 1 < state->blockCount)
+		{
+			nextLength = FillPipelineBlock(state, pipeline, blockIndex + 1, input + ((blockIndex + 1) & 1) * inputLength, inputLength, &nextSource);
+			filling = pipeline->fill != 0 && nextLength != 0;
+		}
+
+		StartBlockFrom(state, blockIndex, source, (int32_t)sourceLength);
+		if (state->blockIndex >= state->blockCount)
+			break; // decoder not included
+		while (1)
+		{
+			// decode into this output half, drain it when full and switch halves
+			uint32_t length = ReadBlock(state, output + half * outputLength + used, outputLength - used);
+			if (length == 0)
+				break;
+			used += length;
+			total += length;
+			if (used == outputLength)
+			{
+				DrainPipeline(pipeline, output + half * outputLength, used, &draining);
+				half ^= 1;
+				used = 0;
+			}
+		}
+		if (total != (blockIndex + 1) * state->blockSize && blockIndex + 1 < state->blockCount)
+			break; // corrupt block
+	}
+	if (filling && pipeline->fillWait != 0)
+		pipeline->fillWait(pipeline->context); // stopped early with a fill started
+
+	// drain what is left, and wait for the last transfer
+	if (used != 0)
+		DrainPipeline(pipeline, output + half * outputLength, used, &draining);
+	if (draining && pipeline->drainWait != 0)
+		pipeline->drainWait(pipeline->context);
+
+	// the block decoder points into input, so read blocks afresh after this
+	state->blockIndex = state->blockCount;
+	state->byteIndex = total;
+	return total;
+}
+#endif // DECOMPRESSOR_USE_PIPELINE
+
+#endif // DECOMPRESSOR_USE_BLOCKS
+
 /************************* END OF CODE ****************************************/
\ No newline at end of file
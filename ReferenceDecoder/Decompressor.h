@@ -31,7 +31,7 @@ extern "C" {
 
 /** TODO
 * DONE 1. Needs read header - generic gets decoded byte length = bits/symbol rounded up to byte * symbol count
-* 2. Needs callback versions that callback a function with a byte and an index
+* DONE 2. Needs callback versions that callback a function with a byte and an index
 */
 
 
@@ -45,9 +45,80 @@ extern "C" {
 // Define which of these to include    
 #define DECOMPRESSOR_USE_HUFFMAN
 #define DECOMPRESSOR_USE_ARITHMETIC
+#define DECOMPRESSOR_USE_RANS
 #define DECOMPRESSOR_USE_LZ77
 #define DECOMPRESSOR_USE_LZCL
 
+// Define to include random access into block containers, made with the -b option
+// of the compressor. Only the decoder used for the blocks is needed.
+#define DECOMPRESSOR_USE_BLOCKS
+
+// Define to decode block containers through double buffered input and output,
+// overlapping block reads and output transfers, such as DMA, with decoding, see
+// DecompressPipelined. Needs DECOMPRESSOR_USE_BLOCKS. Costs some code.
+#define DECOMPRESSOR_USE_PIPELINE
+
+// Define to allow Huffman decoding through a caller supplied lookup table,
+// see DecompressHuffmanStartFast. Costs some code, no RAM unless used.
+#define DECOMPRESSOR_USE_HUFFMAN_TABLE
+
+// Define to allow arithmetic decoding through a caller supplied table of counts,
+// see DecompressArithmeticStartFast. Costs some code, no RAM unless used.
+#define DECOMPRESSOR_USE_ARITHMETIC_TABLE
+
+// Define to allow rANS decoding through a caller supplied table of slots,
+// see DecompressRansStartFast. Costs some code, no RAM unless used.
+#define DECOMPRESSOR_USE_RANS_TABLE
+
+// Define to decode LZ77 and LZCL data compressed with a preset dictionary (-dict),
+// see DecompressLZ77StartDictionary. The dictionary is read in place, never copied.
+// Costs a little code, and a pointer and length per state.
+#define DECOMPRESSOR_USE_DICTIONARY
+
+// Define to read compressed data that is not memory mapped, such as assets in
+// external SPI flash, through a callback and a small cache of aligned lines, see
+// DecompressAddSource. Costs some code, a pointer per Bitstream_t, and a lookup
+// per byte read, even for data in memory.
+// #define DECOMPRESSOR_USE_SOURCE_READER
+
+// Define to decode Huffman and arithmetic data compressed with streams=2-4, see
+// DecompressHuffmanInterleaved. Costs some code, and stack for one state per stream.
+#define DECOMPRESSOR_USE_INTERLEAVED
+
+// Define to read bitstreams through a word sized accumulator instead of one
+// bit at a time. Faster, at the cost of a few bytes per Bitstream_t and a bit
+// more code. The accumulator is 64 bits on 64 bit hosts, else 32 bits.
+// #define DECOMPRESSOR_FAST_BITSTREAM
+
+// Define to shrink decoder states by keeping bit positions and lengths in 16 bits.
+// Then compressed streams must be at most DECOMPRESSOR_MAX_STREAM_BYTES, 8191,
+// and longer ones decode to 0 bytes. Block containers may be larger, as long as each block fits.
+// #define DECOMPRESSOR_COMPACT_STATE
+
+// Define to count decoder work in one global DecompressorStats_t: bits read,
+// literals and matches with their length and distance histograms, Huffman
+// table rows walked, and arithmetic and rANS renormalization and lookup steps.
+// Read it with DecompressGetStats. Costs an add at each counted step, so leave
+// it off for timing. Counts from several threads at once, as in
+// DecompressParallel, may be lost.
+// #define DECOMPRESSOR_STATS
+
+// Define to speed up LZ77 and LZCL run copies on x86 and 64 bit ARM hosts. Short
+// repeated patterns are expanded by SSSE3 or NEON shuffles, with SSSE3 checked at
+// runtime. Other targets, such as the PIC32, build the portable copy, so this is
+// safe to leave defined.
+#define DECOMPRESSOR_USE_SIMD
+
+// Define to a header written by the compressor -p option to build LZ77 and LZCL
+// decoders specialized for one class of streams. Header values are then fixed at
+// compile time: token splits divide by a constant, reads have fixed widths, and
+// LZCL calls its sub-decoders directly. Streams with other header values decode 
+// to 0 bytes.
+// #define DECOMPRESSOR_SPECIALIZE "asset_defines.h"
+#ifdef DECOMPRESSOR_SPECIALIZE
+#include DECOMPRESSOR_SPECIALIZE
+#endif
+
 
 // LZCL requires these decompressors
 #ifdef DECOMPRESSOR_USE_LZCL
@@ -57,6 +128,9 @@ extern "C" {
 #ifndef DECOMPRESSOR_USE_ARITHMETIC
 #define DECOMPRESSOR_USE_ARITHMETIC
 #endif
+#ifndef DECOMPRESSOR_USE_RANS
+#define DECOMPRESSOR_USE_RANS
+#endif
 #ifndef DECOMPRESSOR_USE_LZ77
 #define DECOMPRESSOR_USE_LZ77
 #endif
@@ -65,18 +139,140 @@ extern "C" {
     
 // some incremental decompressors return this when done    
 #define CL_COMPRESSOR_END_TOKEN 0xFFFFFFFF
+
+// Receives decompressed output from the Decompress*ToSink functions.
+// data holds length bytes, the first of which is at output position index.
+// data is only valid during the call.
+typedef void (*DecompressSink_t)(void * context, const uint8_t * data, uint32_t length, uint32_t index);
+
+// Stack buffer size used to send Huffman and Arithmetic output to a sink
+#ifndef DECOMPRESSOR_SINK_BUFFER
+#define DECOMPRESSOR_SINK_BUFFER 32
+#endif
     
+#ifdef DECOMPRESSOR_FAST_BITSTREAM
+#if UINTPTR_MAX > 0xFFFFFFFFU
+typedef uint64_t BitstreamCache_t;
+#else
+typedef uint32_t BitstreamCache_t;
+#endif
+#endif
+
+// bit positions and lengths within one compressed stream, and the longest
+// stream they reach. Decoders return 0 bytes for longer streams.
+#ifdef DECOMPRESSOR_COMPACT_STATE
+typedef uint16_t BitstreamPosition_t;
+#define DECOMPRESSOR_MAX_STREAM_BYTES 8191U
+#else
+typedef uint32_t BitstreamPosition_t;
+#define DECOMPRESSOR_MAX_STREAM_BYTES 0xFFFFFFFFU
+#endif
+
+#ifdef DECOMPRESSOR_USE_SOURCE_READER
+// Lines cached per source, a power of two. Streams read at once, such as the
+// LZCL sub-streams, each keep a line, so have at least four.
+#ifndef DECOMPRESSOR_SOURCE_LINES
+#define DECOMPRESSOR_SOURCE_LINES 4
+#endif
+
+// Reads length bytes at address into buffer. address is as passed to the decoder,
+// and need not point to readable memory, for example an address in external flash.
+typedef void (*DecompressRead_t)(void * context, const uint8_t * address, uint8_t * buffer, uint32_t length);
+
+// Compressed data from base to base+length-1 read through a callback. Reads are of
+// whole lines of lineSize bytes aligned to lineSize, cut at the ends of the data,
+// and kept in DECOMPRESSOR_SOURCE_LINES lines of the caller supplied buffer.
+typedef struct DecompressSource_s
+{
+	const uint8_t * base;
+	uint32_t length;
+	DecompressRead_t read;
+	void * context;
+	uint8_t * lines;   // DECOMPRESSOR_SOURCE_LINES * lineSize bytes
+	uint32_t lineSize; // power of two
+	uintptr_t tags[DECOMPRESSOR_SOURCE_LINES]; // address of each cached line
+	uint32_t last;     // line hit last, checked first
+	uint32_t next;     // line to replace next
+	struct DecompressSource_s * nextSource;
+} DecompressSource_t;
+
+// Read data from base to base+length-1 through read, in lines of lineSize bytes
+// cached in lines, which holds DECOMPRESSOR_SOURCE_LINES * lineSize bytes. Decoders
+// started on data in that range afterwards read through the source. The source and
+// lines must live until DecompressRemoveSource, and all decoders reading the source
+// must run on one thread, so not with DecompressParallel. Preset dictionaries are
+// read directly, so must be in memory. Return 1, or 0 if lineSize is not a power of two.
+EXPORT_WIN32 uint32_t DecompressAddSource(DecompressSource_t * source, const uint8_t * base, uint32_t length, DecompressRead_t read, void * context, uint8_t * lines, uint32_t lineSize);
+
+// Stop decoders started later from reading through the source.
+// Decoders already reading through it still use it.
+EXPORT_WIN32 void DecompressRemoveSource(DecompressSource_t * source);
+#endif
+
 typedef struct
 {
 	// bit position for next read or write
-	uint32_t position;
+	BitstreamPosition_t position;
+	// byte length of data, peeks past this return 0 bits
+	BitstreamPosition_t byteLength;
 	// base of data
 	const void * data;
+#ifdef DECOMPRESSOR_USE_SOURCE_READER
+	// source data is read through, 0 to read memory at data
+	DecompressSource_t * source;
+#endif
+#ifdef DECOMPRESSOR_FAST_BITSTREAM
+	// bits starting at position, MSB first, left justified
+	BitstreamCache_t cache;
+	// number of valid bits in cache
+	uint32_t cacheBits;
+#endif
 } Bitstream_t;
 
 // get size of a decompressed stream
 EXPORT_WIN32 uint32_t GetDecompressedSize(const uint8_t * source);
 
+#ifdef DECOMPRESSOR_USE_INTERLEAVED
+// get size of a decompressed interleaved Huffman or Arithmetic stream, 0 if not interleaved
+EXPORT_WIN32 uint32_t GetInterleavedDecompressedSize(const uint8_t * source);
+#endif
+
+// Decoder work counted when built with DECOMPRESSOR_STATS
+// Histogram bucket k counts values v with 2^k <= v < 2^(k+1), and 0 in bucket 0
+typedef struct
+{
+	// bits taken from bitstreams, including table walks
+	uint64_t bitsRead;
+	// LZ77 and LZCL output
+	uint64_t literals;
+	uint64_t matches;
+	uint64_t matchBytes;
+	uint64_t matchLengths[32];
+	// bytes back, distance + 1
+	uint64_t matchDistances[32];
+	// Huffman codewords from the lookup table, and rows walked in the stream table
+	uint64_t huffmanTableHits;
+	uint64_t huffmanRows;
+	// arithmetic range doublings, and count table steps to find a symbol
+	uint64_t arithmeticRenormalizations;
+	uint64_t arithmeticLookupSteps;
+	// rANS bytes read to renormalize, and slot table steps to find a symbol
+	uint64_t ransRenormalizations;
+	uint64_t ransLookupSteps;
+} DecompressorStats_t;
+
+#ifdef DECOMPRESSOR_STATS
+// the counts, shared by all states
+extern DecompressorStats_t decompressorStats;
+#endif
+
+// Copy the counts to stats, return 1 if built with DECOMPRESSOR_STATS,
+// else zero stats and return 0
+EXPORT_WIN32 uint32_t DecompressGetStats(DecompressorStats_t * stats);
+
+// Zero the counts
+EXPORT_WIN32 void DecompressResetStats(void);
+
 #ifdef DECOMPRESSOR_USE_HUFFMAN
 // State needed for Huffman decompression
 typedef struct
@@ -86,7 +282,7 @@ typedef struct
 	// Stream to decode from
 	Bitstream_t bitstream;
 	// bit stream position where codeword table is stored
-	uint32_t tablePosition;
+	BitstreamPosition_t tablePosition;
 	// Bytes left to decode (or 0xFFFFFFFF to mark unknown)
 	uint32_t byteLength;
 	// Bits per symbol in symbol table
@@ -97,6 +293,19 @@ typedef struct
 	uint8_t maxCodewordLength;
 	// Bits to store a count of codewords of the same length
 	uint8_t bitsPerCodelengthCount;
+#ifdef DECOMPRESSOR_USE_HUFFMAN_TABLE
+	// Bits indexing the lookup table, 0 when decoding from the stream table
+	uint8_t lookupBits;
+	// 1 when lookup entries also hold a second codeword, see DecompressHuffmanStartPairs
+	uint8_t lookupPairs;
+	// Optional lookup table, entry is (symbol << 5) | codeword length,
+	// or 0 when the codeword is longer than lookupBits
+	const uint32_t * lookup;
+	// stream codeword table position and first codeword for codewords of
+	// length lookupBits+1, where decoding resumes for long codewords
+	BitstreamPosition_t lookupTablePosition;
+	uint32_t lookupFirstCodeword;
+#endif
 } HuffmanState_t;
 
 // Single call decompression:
@@ -111,6 +320,51 @@ EXPORT_WIN32 void DecompressHuffmanStart(HuffmanState_t * state, const uint8_t *
 // decompress a symbol 0-255. Returns CL_COMPRESSOR_END_TOKEN when no more
 EXPORT_WIN32 uint32_t DecompressHuffmanSymbol(HuffmanState_t * state);
 
+// Call after starting decompression with DecompressHuffmanStart to send all remaining
+// symbols to sink in spans of up to chunk bytes (at most DECOMPRESSOR_SINK_BUFFER).
+// Returns number of bytes sent.
+EXPORT_WIN32 uint32_t DecompressHuffmanToSink(HuffmanState_t * state, DecompressSink_t sink, void * context, uint32_t chunk);
+
+// Call after starting decompression with DecompressHuffmanStart to decode
+// up to maxBytes symbols into out. Returns number written, 0 when done.
+// Much faster per symbol than DecompressHuffmanSymbol, so decode in blocks when possible.
+EXPORT_WIN32 uint32_t DecompressHuffmanBlock(HuffmanState_t * state, uint8_t * out, uint32_t maxBytes);
+
+// Same as DecompressHuffmanBlock
+EXPORT_WIN32 uint32_t DecompressHuffmanPartial(HuffmanState_t * state, uint8_t * out, uint32_t maxBytes);
+
+#ifdef DECOMPRESSOR_USE_HUFFMAN_TABLE
+// Partial call decompression using a lookup table for speed
+// Like DecompressHuffmanStart, but builds a lookup table in the caller supplied 
+// table of tableLength entries, which must live as long as the state. 
+// 256 entries (1 KB) or 512 entries (2 KB) are good sizes, larger is faster.
+// Falls back to the low memory decoder if the table is too small.
+EXPORT_WIN32 void DecompressHuffmanStartFast(HuffmanState_t * state, const uint8_t * source, int32_t sourceLength, uint32_t * table, uint32_t tableLength);
+
+// Return table entries letting DecompressHuffmanStartFast decode every codeword 
+// with one lookup, 2^(longest codeword length). Codewords are limited to maxCode
+// bits when compressing with that Huffman parameter, so 11 needs at most 2048 entries.
+EXPORT_WIN32 uint32_t DecompressHuffmanTableLength(const uint8_t * source, int32_t sourceLength);
+
+// Like DecompressHuffmanStartFast, but entries also hold a following short codeword
+// when both fit, so DecompressHuffmanBlock decodes two symbols per lookup.
+// Uses the same table, at no further RAM. Symbols must be at most 8 bits to pair.
+EXPORT_WIN32 void DecompressHuffmanStartPairs(HuffmanState_t * state, const uint8_t * source, int32_t sourceLength, uint32_t * table, uint32_t tableLength);
+
+// Single call decompression using a lookup table for speed:
+// decompress, return bytes decoded
+EXPORT_WIN32 int32_t DecompressHuffmanFast(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, uint32_t * table, uint32_t tableLength);
+#endif
+
+#ifdef DECOMPRESSOR_USE_INTERLEAVED
+// Single call decompression of data compressed with streams=2-4, which starts with
+// a size of 0 so the other Huffman calls decode nothing. Symbols come from each
+// stream in turn, so the work of decoding them overlaps. The table is used as in
+// DecompressHuffmanStartFast, and may be 0 with tableLength 0. Returns bytes
+// decoded, 0 for data compressed with streams=1.
+EXPORT_WIN32 int32_t DecompressHuffmanInterleaved(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, uint32_t * table, uint32_t tableLength);
+#endif
+
 #endif // DECOMPRESSOR_USE_HUFFMAN
 
 #ifdef DECOMPRESSOR_USE_ARITHMETIC
@@ -121,18 +375,29 @@ typedef struct
 
 	// items for arithmetic part
 	uint32_t lowValue, highValue, total;
-	uint32_t scaling;
 
 	// items for table decoding
 	uint32_t symbolMin;
-	uint32_t tableStartBitPosition;
+	BitstreamPosition_t tableStartBitPosition;
 
 	// lookahead buffer
 	uint32_t buffer;
 
+	// symbols left to decode (or 0xFFFFFFFF to mark unknown)
+	uint32_t symbolsLeft;
+
 	// track bits read to end stream
-	uint32_t bitLength; // bits in compressed region
-	uint32_t bitsRead;  // bits read from compressed region
+	BitstreamPosition_t bitLength; // bits in compressed region
+	BitstreamPosition_t bitsRead;  // bits read from compressed region
+
+#ifdef DECOMPRESSOR_USE_ARITHMETIC_TABLE
+	// Optional decoded table, 0 when decoding from the stream table
+	// Symbol symbolMin+i has counts cumCounts[i] to cumCounts[i+1]
+	const uint32_t * cumCounts;
+	uint32_t countLength; // symbols in cumCounts
+	// Optional map from cumulative count to symbol index, or 0
+	const uint32_t * countToIndex;
+#endif
 
 } ArithmeticState_t;
 
@@ -147,8 +412,105 @@ EXPORT_WIN32 uint32_t DecompressArithmeticStart(ArithmeticState_t * state, const
 // Decompress a symbol in the compression algorithm, or CL_COMPRESSOR_END_TOKEN when done
 EXPORT_WIN32 uint32_t DecompressArithmeticSymbol(ArithmeticState_t * state);
 
+// Call after starting decompression with DecompressArithmeticStart to send all remaining
+// symbols to sink in spans of up to chunk bytes (at most DECOMPRESSOR_SINK_BUFFER).
+// Returns number of bytes sent.
+EXPORT_WIN32 uint32_t DecompressArithmeticToSink(ArithmeticState_t * state, DecompressSink_t sink, void * context, uint32_t chunk);
+
+// Call after starting decompression with DecompressArithmeticStart to decode
+// up to maxBytes symbols into out. Returns number written, 0 when done.
+EXPORT_WIN32 uint32_t DecompressArithmeticPartial(ArithmeticState_t * state, uint8_t * out, uint32_t maxBytes);
+
+#ifdef DECOMPRESSOR_USE_ARITHMETIC_TABLE
+// Partial call decompression using a decoded table for speed
+// Like DecompressArithmeticStart, but decodes the count table once into the
+// caller supplied table of tableLength entries, which must live as long as the state.
+// Needs (max symbol - min symbol + 2) entries, usually 257, else the low memory 
+// decoder is used. If another (total count) entries fit, symbols are found
+// directly instead of by binary search.
+EXPORT_WIN32 uint32_t DecompressArithmeticStartFast(ArithmeticState_t * state, const uint8_t * source, int32_t sourceLength, uint32_t * table, uint32_t tableLength);
+
+// decompress using a decoded table, return bytes decoded
+EXPORT_WIN32 int32_t DecompressArithmeticFast(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, uint32_t * table, uint32_t tableLength);
+#endif
+
+#ifdef DECOMPRESSOR_USE_INTERLEAVED
+// Single call decompression of data compressed with streams=2-4, which starts with
+// a size of 0 so the other arithmetic calls decode nothing. Each stream has its own
+// coder, and they decode symbols in turn so the work overlaps. The table is used as
+// in DecompressArithmeticStartFast, and may be 0 with tableLength 0. Returns bytes
+// decoded, 0 for data compressed with streams=1.
+EXPORT_WIN32 int32_t DecompressArithmeticInterleaved(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, uint32_t * table, uint32_t tableLength);
+#endif
+
 #endif // DECOMPRESSOR_USE_ARITHMETIC
 
+#ifdef DECOMPRESSOR_USE_RANS
+
+// State needed for rANS decompression
+typedef struct
+{
+	Bitstream_t bitstream;
+
+	// coder state
+	uint32_t x;
+
+	// symbols left to decode (or 0xFFFFFFFF to mark unknown)
+	uint32_t symbolsLeft;
+
+	// items for table decoding, entry i is a symbol and its first slot
+	uint32_t symbolMin;
+	uint32_t entries;
+	BitstreamPosition_t tablePosition; // bit position of entry 1, entry 0 is symbolMin at slot 0
+	uint8_t scaleBits;  // slots are 0 to 2^scaleBits - 1
+	uint8_t sparse;     // 1 when entries store symbol values, else entry i is symbolMin + i
+	uint8_t symbolBits; // bits per stored symbol value
+
+#ifdef DECOMPRESSOR_USE_RANS_TABLE
+	// Optional decoded table, 0 when decoding from the stream table
+	// Entry i is symbols[i] with slots slots[i] to slots[i+1]-1
+	const uint32_t * slots;
+	const uint32_t * symbols;
+	// Optional map from slot to entry index, or 0
+	const uint32_t * slotToIndex;
+#endif
+} RansState_t;
+
+// decompress, return bytes decoded
+EXPORT_WIN32 int32_t DecompressRans(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength);
+
+// Partial call decompression
+// start decompression, follow up with DecompressRansSymbol until done
+// Return number of symbols in stream
+EXPORT_WIN32 uint32_t DecompressRansStart(RansState_t * state, const uint8_t * source, int32_t sourceLength);
+
+// Decompress a symbol in the compression algorithm, or CL_COMPRESSOR_END_TOKEN when done
+EXPORT_WIN32 uint32_t DecompressRansSymbol(RansState_t * state);
+
+// Call after starting decompression with DecompressRansStart to send all remaining
+// symbols to sink in spans of up to chunk bytes (at most DECOMPRESSOR_SINK_BUFFER).
+// Returns number of bytes sent.
+EXPORT_WIN32 uint32_t DecompressRansToSink(RansState_t * state, DecompressSink_t sink, void * context, uint32_t chunk);
+
+// Call after starting decompression with DecompressRansStart to decode
+// up to maxBytes symbols into out. Returns number written, 0 when done.
+EXPORT_WIN32 uint32_t DecompressRansPartial(RansState_t * state, uint8_t * out, uint32_t maxBytes);
+
+#ifdef DECOMPRESSOR_USE_RANS_TABLE
+// Partial call decompression using a decoded table for speed
+// Like DecompressRansStart, but decodes the table once into the caller supplied
+// table of tableLength entries, which must live as long as the state.
+// Needs 2 * (symbol entries) + 1 entries, usually 513, else the low memory decoder 
+// is used. If another 2^scale entries fit, 4096 at the default scale, symbols 
+// are found directly instead of by binary search.
+EXPORT_WIN32 uint32_t DecompressRansStartFast(RansState_t * state, const uint8_t * source, int32_t sourceLength, uint32_t * table, uint32_t tableLength);
+
+// decompress using a decoded table, return bytes decoded
+EXPORT_WIN32 int32_t DecompressRansFast(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, uint32_t * table, uint32_t tableLength);
+#endif
+
+#endif // DECOMPRESSOR_USE_RANS
+
 #ifdef DECOMPRESSOR_USE_LZ77
 
 // State needed for LZ77 decompression
@@ -164,13 +526,25 @@ typedef struct
 	// destination buffer and size
 	uint8_t * dest;
 	uint32_t destLength;
+	// destLength - 1 when a power of two, else 0
+	uint32_t destMask;
 	// defines how tokens are stored
 	uint32_t actualMaxToken;
 	uint32_t actualMaxDistance;
+	// log2(actualMaxDistance+1) when a power of two, else 0
+	uint8_t  distanceShift;
 	uint8_t  actualMinLength;
 	// define the bit sizes of items
 	uint8_t  actualBitsPerSymbol;
 	uint8_t  actualBitsPerToken;
+	// run left to copy when a partial decode stopped mid run
+	uint32_t matchLeft;
+	uint32_t matchDistance;
+#ifdef DECOMPRESSOR_USE_DICTIONARY
+	// preset dictionary logically before the first byte, 0 if none
+	const uint8_t * dictionary;
+	uint32_t dictionaryLength;
+#endif
 } LZ77State_t;
 
 // decompress, return bytes decoded
@@ -182,11 +556,32 @@ EXPORT_WIN32 int32_t DecompressLZ77(const uint8_t * source, int32_t sourceLength
 // requires buffer dest of length enough to handle the max look-back plus the max length used when compressing the block
 EXPORT_WIN32 void DecompressLZ77Start(LZ77State_t * state, const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength);
 
+#ifdef DECOMPRESSOR_USE_DICTIONARY
+// decompress data compressed with the preset dictionary, return bytes decoded
+EXPORT_WIN32 int32_t DecompressLZ77Dictionary(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, const uint8_t * dictionary, int32_t dictionaryLength);
+
+// Same as DecompressLZ77Start, for data compressed with the preset dictionary.
+// Runs reaching before the first byte read the dictionary in place, so it is not 
+// copied into dest, and dest needs no more room. It must live as long as the state.
+EXPORT_WIN32 void DecompressLZ77StartDictionary(LZ77State_t * state, const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, const uint8_t * dictionary, int32_t dictionaryLength);
+#endif
+
 // Call after starting decompression with DecompressLZ77Start to get block of symbols
 // symbols are written into the dest buffer passed in, they are written in a cyclical manner
 // returns number of items decompressed, or CL_COMPRESSOR_END_TOKEN when no more.
 EXPORT_WIN32 uint32_t DecompressLZ77Block(LZ77State_t * state);
 
+// Call after starting decompression with DecompressLZ77Start to send all remaining
+// bytes to sink, straight from the dest buffer, in spans of at least chunk bytes.
+// chunk is lowered if needed so unsent bytes are never overwritten. 
+// Returns number of bytes sent.
+EXPORT_WIN32 uint32_t DecompressLZ77ToSink(LZ77State_t * state, DecompressSink_t sink, void * context, uint32_t chunk);
+
+// Call after starting decompression with DecompressLZ77Start to decode up to 
+// maxBytes bytes into out, stopping mid run if needed, so the work per call is bounded.
+// The dest buffer is still used for look-back. Returns number written, 0 when done.
+EXPORT_WIN32 uint32_t DecompressLZ77Partial(LZ77State_t * state, uint8_t * out, uint32_t maxBytes);
+
 #endif // DECOMPRESSOR_USE_LZ77
 
 #ifdef DECOMPRESSOR_USE_LZCL
@@ -203,46 +598,57 @@ typedef struct
 	uint32_t parameter;
 } GolombState_t;
 
+// A sub-codec takes only the bytes its codec type needs, so in an LZCL state
+// it may end partway through the union
 typedef struct
 {
+	uint8_t codecType; // codec type 0-4
 	union {
 		FixedState_t fixedState;
 		ArithmeticState_t arithmeticState;
 		HuffmanState_t huffmanState;
 		GolombState_t golombState;
+		RansState_t ransState;
 	};
-	uint8_t codecType; // codec type 0-3
-	uint32_t bitLength; // 
 }  LZCLSubCodec_t;
 
 typedef struct {
-	uint32_t actualMinLength;
 	uint32_t actualMaxDistance;
 	uint32_t byteLength, byteIndex;
 	Bitstream_t bitstream;
+	uint32_t actualMinLength;
+	uint8_t distanceShift; // log2(actualMaxDistance+1) when a power of two, else 0
 	uint8_t useDecisionRuns; // how to decode decisions
-	union {
-		LZCLSubCodec_t decisionCodec;
-		LZCLSubCodec_t decisionRunCodec;
-	};
-	LZCLSubCodec_t literalCodec;
 	uint8_t useTokens; // how to decode distance/length pairs
-	union {
-		struct {
-			LZCLSubCodec_t tokenCodec;
-		};
-		struct {
-			LZCLSubCodec_t distanceCodec;
-			LZCLSubCodec_t lengthCodec;
-		};
-	};
-	uint32_t initialValue;
+	uint8_t initialValue;
+	// byte offsets of the sub-codecs from the start of the state. The decision
+	// codec decodes decision runs when useDecisionRuns is 1, and the token codec
+	// decodes distances, followed by the length codec, when useTokens is 0
+	uint16_t decisionOffset;
+	uint16_t literalOffset;
+	uint16_t tokenOffset;
+	uint16_t lengthOffset;
 	uint8_t * dest;
 	uint32_t destLength;
+	uint32_t destMask; // destLength - 1 when a power of two, else 0
 
 	// stuff for decoding runs
-	int32_t curRun;    // 0 or 1, -1 if none decoded yet
+	int8_t curRun;     // 0 or 1, -1 if none decoded yet
 	uint32_t runsLeft; // runs of current type left
+
+	// run left to copy when a partial decode stopped mid run
+	uint32_t matchLeft;
+	uint32_t matchDistance;
+#ifdef DECOMPRESSOR_USE_DICTIONARY
+	// preset dictionary logically before the first byte, 0 if none
+	const uint8_t * dictionary;
+	uint32_t dictionaryLength;
+#endif
+
+	// sub-codecs, each sized for its codec type, at the offsets above. Room for
+	// the largest ones when the state is declared whole, but a state of
+	// DecompressLZCLStateSize bytes ends partway through
+	LZCLSubCodec_t codecs[4];
 } LZCLState_t;
 
 // decompress, return bytes decoded
@@ -250,16 +656,148 @@ EXPORT_WIN32 int32_t DecompressLZCL(const uint8_t * source, int32_t sourceLength
 
 // Read the header for the compression algorithm
 // Return number of symbols in stream if known, else 0 if not present
+// The state may be sizeof(LZCLState_t), or just DecompressLZCLStateSize bytes for this stream
 EXPORT_WIN32 uint32_t DecompressLZCLStart(LZCLState_t * state, const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength);
 
+// Return the bytes of state DecompressLZCLStart needs for this stream, at most
+// sizeof(LZCLState_t). Sub-codecs only take the room their codec type needs, so a
+// state allocated with this size, aligned as for a pointer, is often much smaller.
+EXPORT_WIN32 uint32_t DecompressLZCLStateSize(const uint8_t * source, int32_t sourceLength);
+
+#ifdef DECOMPRESSOR_USE_DICTIONARY
+// decompress data compressed with the preset dictionary, return bytes decoded
+EXPORT_WIN32 int32_t DecompressLZCLDictionary(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, const uint8_t * dictionary, int32_t dictionaryLength);
+
+// Same as DecompressLZCLStart, for data compressed with the preset dictionary.
+// Runs reaching before the first byte read the dictionary in place, so it is not 
+// copied into dest, and dest needs no more room. It must live as long as the state.
+EXPORT_WIN32 uint32_t DecompressLZCLStartDictionary(LZCLState_t * state, const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, const uint8_t * dictionary, int32_t dictionaryLength);
+#endif
+
 // Call after starting decompression with DecompressLZCLStart to get block of symbols
 // symbols are written into the dest buffer passed in, they are written in a cyclical manner
 // returns number of items decompressed, or CL_COMPRESSOR_END_TOKEN when no more.
+// A run of literals is decoded in one call, as far as the look-back window allows.
 EXPORT_WIN32 uint32_t DecompressLZCLBlock(LZCLState_t * state);
 
+// Call after starting decompression with DecompressLZCLStart to send all remaining
+// bytes to sink, straight from the dest buffer, in spans of at least chunk bytes.
+// chunk plus the longest run must fit in the dest buffer, 0 sends each run as decoded.
+// Returns number of bytes sent.
+EXPORT_WIN32 uint32_t DecompressLZCLToSink(LZCLState_t * state, DecompressSink_t sink, void * context, uint32_t chunk);
+
+// Call after starting decompression with DecompressLZCLStart to decode up to 
+// maxBytes bytes into out, stopping mid run if needed, so the work per call is bounded.
+// The dest buffer is still used for look-back. Returns number written, 0 when done.
+EXPORT_WIN32 uint32_t DecompressLZCLPartial(LZCLState_t * state, uint8_t * out, uint32_t maxBytes);
+
 
 #endif // DECOMPRESSOR_USE_LZCL
 
+#ifdef DECOMPRESSOR_USE_BLOCKS
+
+// State for random access into a block container
+typedef struct
+{
+	// container
+	const uint8_t * source;
+	uint32_t sourceLength;
+	// total bytes to decode
+	uint32_t byteLength;
+	// bytes per block, last may be shorter
+	uint32_t blockSize;
+	uint32_t blockCount;
+	// bit position of block end offset index
+	uint32_t indexPosition;
+	// byte position in source where block data starts
+	uint32_t dataStart;
+	// codec for blocks: 0 = Huffman, 1 = Arithmetic, 2 = LZ77, 3 = LZCL
+	uint8_t codecType;
+	uint8_t bitsPerOffset;
+
+	// look-back buffer for LZ77 and LZCL blocks
+	uint8_t * buffer;
+	uint32_t bufferLength;
+
+	// position of next byte to read
+	uint32_t byteIndex;
+	// block being read, blockCount if none
+	uint32_t blockIndex;
+	union {
+#ifdef DECOMPRESSOR_USE_HUFFMAN
+		HuffmanState_t huffmanState;
+#endif
+#ifdef DECOMPRESSOR_USE_ARITHMETIC
+		ArithmeticState_t arithmeticState;
+#endif
+#ifdef DECOMPRESSOR_USE_LZ77
+		LZ77State_t lz77State;
+#endif
+#ifdef DECOMPRESSOR_USE_LZCL
+		LZCLState_t lzclState;
+#endif
+	};
+} BlockState_t;
+
+// Read the container header, return total bytes in the container
+// buffer is the look-back buffer for LZ77 and LZCL blocks, sized as for
+// incremental decoding, and may be 0 for Huffman and Arithmetic
+EXPORT_WIN32 uint32_t DecompressBlocksStart(BlockState_t * state, const uint8_t * source, int32_t sourceLength, uint8_t * buffer, int32_t bufferLength);
+
+// Decompress block blockIndex into dest in one call, return bytes decoded
+// Bytes blockIndex*blockSize onwards of the output. Does not change state, 
+// so blocks may be decoded in any order, or at the same time from several threads.
+EXPORT_WIN32 int32_t DecompressBlock(const BlockState_t * state, uint32_t blockIndex, uint8_t * dest, int32_t destLength);
+
+// Move the read position to offset, decoding only the block holding it
+// Return 1 on success, 0 if offset is past the end
+EXPORT_WIN32 uint32_t DecompressSeek(BlockState_t * state, uint32_t offset);
+
+// Decode up to maxBytes bytes from the read position into out, continuing
+// across blocks. Returns number written, 0 when done.
+EXPORT_WIN32 uint32_t DecompressBlocksPartial(BlockState_t * state, uint8_t * out, uint32_t maxBytes);
+
+// Decompress bytes offset to offset+length-1 into dest, decoding only the
+// blocks needed. Return bytes decoded.
+EXPORT_WIN32 int32_t DecompressRange(BlockState_t * state, uint32_t offset, uint32_t length, uint8_t * dest);
+
+#ifdef DECOMPRESSOR_USE_PIPELINE
+// Start copying length bytes of compressed data at source into buffer, and
+// return at once, for example by starting a DMA transfer from external flash
+typedef void (*DecompressFill_t)(void * context, const uint8_t * source, uint8_t * buffer, uint32_t length);
+// Start sending length decompressed bytes from buffer, and return at once,
+// for example by starting a DMA transfer to a UART or display
+typedef void (*DecompressDrain_t)(void * context, const uint8_t * buffer, uint32_t length);
+// Return once the transfer last started by the matching hook is done
+typedef void (*DecompressWait_t)(void * context);
+
+// Transfer hooks for DecompressPipelined. Only one fill and one drain are
+// started at a time, each waited for before the next. Hooks that finish the
+// transfer before returning need no wait, which may be 0. fill may be 0 when
+// the container is readable, then blocks are decoded in place.
+typedef struct
+{
+	DecompressFill_t fill;
+	DecompressWait_t fillWait;
+	DecompressDrain_t drain;
+	DecompressWait_t drainWait;
+	void * context;
+} DecompressPipeline_t;
+
+// Decode a whole container started with DecompressBlocksStart, overlapping the
+// stages: the next block is filled into one half of input while the current
+// block decodes from the other, and output chunks are drained from one half of
+// output while the other is decoded into. input holds 2*inputLength bytes, and
+// inputLength must be at least the largest compressed block, or input may be 0
+// without fill. output holds 2*outputLength bytes. The header and block offsets
+// are still read from the container, so it must be readable, or read through a
+// source, see DecompressAddSource. Return total bytes drained, which stops short
+// at a block too large for inputLength.
+EXPORT_WIN32 uint32_t DecompressPipelined(BlockState_t * state, const DecompressPipeline_t * pipeline, uint8_t * input, uint32_t inputLength, uint8_t * output, uint32_t outputLength);
+#endif
+
+#endif // DECOMPRESSOR_USE_BLOCKS
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,245 @@
+/*
+MIT License
+
+Copyright (c) 2016 Chris Lomont
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include "ParallelDecompressor.h"
+
+#ifdef DECOMPRESSOR_USE_BLOCKS
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+/************************* Atomic and thread helpers **************************/
+
+// a share of blocks is packed as (end << 32) | begin so one compare and swap
+// can take blocks off either end
+#ifdef _MSC_VER
+typedef volatile LONGLONG Share_t;
+#define LOAD_SHARE(p) ((uint64_t)InterlockedCompareExchange64((p), 0, 0))
+#define STORE_SHARE(p,v) InterlockedExchange64((p), (LONGLONG)(v))
+#define SWAP_SHARE(p,old,v) (InterlockedCompareExchange64((p), (LONGLONG)(v), (LONGLONG)(old)) == (LONGLONG)(old))
+#define ADD_COUNT(p,v) InterlockedExchangeAdd((volatile LONG*)(p), (LONG)(v))
+#else
+typedef uint64_t Share_t;
+#define LOAD_SHARE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_SHARE(p,v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define SWAP_SHARE(p,old,v) ShareSwap((p), (old), (v))
+#define ADD_COUNT(p,v) __atomic_fetch_add((p), (v), __ATOMIC_RELAXED)
+static int ShareSwap(Share_t * share, uint64_t old, uint64_t value)
+{
+	return __atomic_compare_exchange_n(share, &old, value, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+#endif
+
+#define SHARE(begin,end) (((uint64_t)(end) << 32) | (uint32_t)(begin))
+#define SHARE_BEGIN(s) ((uint32_t)(s))
+#define SHARE_END(s) ((uint32_t)((s) >> 32))
+
+static uint32_t ProcessorCount(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count < 1 ? 1 : (uint32_t)count;
+#endif
+}
+
+/************************* Parallel block decoding ****************************/
+
+struct ParallelJob_t;
+
+// one per thread, padded to a cache line so shares do not false share
+typedef struct
+{
+	Share_t share;
+	struct ParallelJob_t * job;
+	uint8_t pad[64 - sizeof(Share_t) - sizeof(void*)];
+} Worker_t;
+
+typedef struct ParallelJob_t
+{
+	BlockState_t state;
+	uint8_t * dest;
+	uint32_t destLength;
+	uint32_t workerCount;
+	// bytes decoded by all threads
+	uint32_t total;
+	Worker_t workers[DECOMPRESSOR_MAX_THREADS];
+} ParallelJob_t;
+
+// Take the first block of our own share, return 0 if it is empty
+static int TakeBlock(Worker_t * worker, uint32_t * blockIndex)
+{
+	uint64_t share = LOAD_SHARE(&worker->share);
+	while (SHARE_BEGIN(share) < SHARE_END(share))
+	{
+		if (SWAP_SHARE(&worker->share, share, SHARE(SHARE_BEGIN(share) + 1, SHARE_END(share))))
+		{
+			*blockIndex = SHARE_BEGIN(share);
+			return 1;
+		}
+		share = LOAD_SHARE(&worker->share);
+	}
+	return 0;
+}
+
+// Move the back half of the largest other share into ours, return 0 when
+// no blocks are left anywhere
+static int StealBlocks(Worker_t * worker)
+{
+	ParallelJob_t * job = worker->job;
+	for (;;)
+	{
+		Worker_t * victim = 0;
+		uint64_t share = 0;
+		uint32_t i, most = 0, middle;
+		for (i = 0; i < job->workerCount; ++i)
+		{
+			uint64_t s = LOAD_SHARE(&job->workers[i].share);
+			if (SHARE_END(s) - SHARE_BEGIN(s) > most && SHARE_BEGIN(s) < SHARE_END(s))
+			{
+				most = SHARE_END(s) - SHARE_BEGIN(s);
+				victim = job->workers + i;
+				share = s;
+			}
+		}
+		if (victim == 0)
+			return 0;
+		middle = SHARE_BEGIN(share) + most / 2;
+		if (SWAP_SHARE(&victim->share, share, SHARE(SHARE_BEGIN(share), middle)))
+		{
+			STORE_SHARE(&worker->share, SHARE(middle, SHARE_END(share)));
+			return 1;
+		}
+		// lost a race with the owner or another thief, look again
+	}
+}
+
+static void RunWorker(Worker_t * worker)
+{
+	ParallelJob_t * job = worker->job;
+	uint32_t total = 0, blockIndex;
+	do
+	{
+		while (TakeBlock(worker, &blockIndex))
+		{
+			uint32_t offset = blockIndex * job->state.blockSize;
+			uint32_t length = job->state.byteLength - offset;
+			if (length > job->state.blockSize)
+				length = job->state.blockSize;
+			// LZ77 and LZCL treat a short dest as a cyclic buffer, which
+			// would overwrite neighboring blocks, so skip blocks that do not fit
+			if (offset + length <= job->destLength)
+				total += (uint32_t)DecompressBlock(&job->state, blockIndex, job->dest + offset, (int32_t)length);
+		}
+	} while (StealBlocks(worker));
+	ADD_COUNT(&job->total, total);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI WorkerThread(LPVOID parameter)
+{
+	RunWorker((Worker_t*)parameter);
+	return 0;
+}
+#else
+static void * WorkerThread(void * parameter)
+{
+	RunWorker((Worker_t*)parameter);
+	return 0;
+}
+#endif
+
+// Decompress a whole block container into dest using threadCount threads,
+// 0 for one per processor. Each block is decoded straight into its place in
+// dest. Blocks are split evenly between threads, and a thread that runs out
+// steals half of the largest remaining share of another. Returns bytes decoded,
+// less than the container size if dest is too short or a block is corrupt.
+EXPORT_WIN32 int32_t DecompressParallel(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, int32_t threadCount)
+{
+	ParallelJob_t job;
+	uint32_t i, started = 1, blockCount;
+#ifdef _WIN32
+	HANDLE threads[DECOMPRESSOR_MAX_THREADS];
+#else
+	pthread_t threads[DECOMPRESSOR_MAX_THREADS];
+#endif
+
+	DecompressBlocksStart(&job.state, source, sourceLength, 0, 0);
+	blockCount = job.state.blockCount;
+	job.dest = dest;
+	job.destLength = destLength < 0 ? 0 : (uint32_t)destLength;
+	job.total = 0;
+
+	job.workerCount = threadCount > 0 ? (uint32_t)threadCount : ProcessorCount();
+	if (job.workerCount > DECOMPRESSOR_MAX_THREADS)
+		job.workerCount = DECOMPRESSOR_MAX_THREADS;
+	if (job.workerCount > blockCount)
+		job.workerCount = blockCount;
+	if (job.workerCount == 0)
+		return 0;
+
+	// even contiguous shares, so each thread mostly walks forward through dest
+	for (i = 0; i < job.workerCount; ++i)
+	{
+		job.workers[i].job = &job;
+		job.workers[i].share = SHARE(
+			(uint64_t)blockCount * i / job.workerCount,
+			(uint64_t)blockCount * (i + 1) / job.workerCount);
+	}
+
+	// the calling thread is worker 0
+	for (; started < job.workerCount; ++started)
+	{
+#ifdef _WIN32
+		threads[started] = CreateThread(0, 0, WorkerThread, job.workers + started, 0, 0);
+		if (threads[started] == 0)
+			break;
+#else
+		if (pthread_create(threads + started, 0, WorkerThread, job.workers + started) != 0)
+			break;
+#endif
+	}
+	// shares of threads that failed to start are stolen by the others
+	RunWorker(job.workers);
+	for (i = 1; i < started; ++i)
+	{
+#ifdef _WIN32
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+#else
+		pthread_join(threads[i], 0);
+#endif
+	}
+	return (int32_t)job.total;
+}
+
+#endif // DECOMPRESSOR_USE_BLOCKS
+
+/************************* END OF CODE ****************************************/
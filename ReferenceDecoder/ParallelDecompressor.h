@@ -0,0 +1,56 @@
+/*
+MIT License
+
+Copyright (c) 2016 Chris Lomont
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _CL_PARALLEL_DECOMPRESSOR
+#define _CL_PARALLEL_DECOMPRESSOR
+#include "Decompressor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Multi-threaded decoding of block containers for host builds (the DLL).
+// Needs Windows threads or pthreads, so it is kept out of Decompressor.c,
+// which stays usable on its own on small devices.
+
+// most worker threads used by one call
+#ifndef DECOMPRESSOR_MAX_THREADS
+#define DECOMPRESSOR_MAX_THREADS 64
+#endif
+
+#ifdef DECOMPRESSOR_USE_BLOCKS
+
+// Decompress a whole block container into dest using threadCount threads,
+// 0 for one per processor. Each block is decoded straight into its place in
+// dest. Blocks are split evenly between threads, and a thread that runs out
+// steals half of the largest remaining share of another. Returns bytes decoded,
+// less than the container size if dest is too short or a block is corrupt.
+EXPORT_WIN32 int32_t DecompressParallel(const uint8_t * source, int32_t sourceLength, uint8_t * dest, int32_t destLength, int32_t threadCount);
+
+#endif // DECOMPRESSOR_USE_BLOCKS
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _CL_PARALLEL_DECOMPRESSOR